@@ -0,0 +1,160 @@
+/****************************************************************************
+ *  Copyright (C) 2019 RoboMaster.
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program. If not, see <http://www.gnu.org/licenses/>.
+ ***************************************************************************/
+
+#ifndef ROBORTS_COMMON_THREAD_POOL_H
+#define ROBORTS_COMMON_THREAD_POOL_H
+
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace roborts_common{
+
+/**
+ * @brief A small fork-join thread pool for data parallel loops in the perception and planning modules.
+ *        The calling thread takes part in every job, so a pool of N threads owns N - 1 workers.
+ */
+class ThreadPool {
+ public:
+  /**
+   * @brief Constructor, spawns the worker threads.
+   * @param thread_num Total number of threads taking part in a job, including the caller.
+   */
+  explicit ThreadPool(unsigned int thread_num) :
+      thread_num_(thread_num > 0 ? thread_num : 1),
+      generation_(0),
+      shutdown_(false),
+      task_num_(0),
+      busy_workers_(0),
+      next_task_(0) {
+    for (unsigned int i = 1; i < thread_num_; ++i) {
+      workers_.emplace_back(&ThreadPool::WorkerLoop, this, i);
+    }
+  }
+
+  ~ThreadPool() {
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      shutdown_ = true;
+    }
+    start_condition_.notify_all();
+    for (auto &worker : workers_) {
+      worker.join();
+    }
+  }
+
+  ThreadPool(const ThreadPool &) = delete;
+  ThreadPool &operator=(const ThreadPool &) = delete;
+
+  /**
+   * @brief Get the number of threads taking part in a job, including the caller.
+   * @return The thread number
+   */
+  unsigned int GetThreadNum() const {
+    return thread_num_;
+  }
+
+  /**
+   * @brief Run function(task_index, thread_index) for every task_index in [0, task_num) and block until all
+   *        tasks finished. Tasks are handed out dynamically, thread_index is in [0, GetThreadNum()) and is unique
+   *        among the threads running concurrently, so it can be used to address per-thread scratch memory.
+   * @param task_num Number of tasks
+   * @param function The task body
+   */
+  void ParallelFor(int task_num, const std::function<void(int, unsigned int)> &function) {
+    if (task_num <= 0) {
+      return;
+    }
+    if (workers_.empty() || task_num == 1) {
+      for (int i = 0; i < task_num; ++i) {
+        function(i, 0);
+      }
+      return;
+    }
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      function_ = &function;
+      task_num_ = task_num;
+      next_task_.store(0);
+      busy_workers_ = workers_.size();
+      ++generation_;
+    }
+    start_condition_.notify_all();
+
+    RunTasks(0);
+
+    std::unique_lock<std::mutex> lock(mutex_);
+    finish_condition_.wait(lock, [this] { return busy_workers_ == 0; });
+    function_ = nullptr;
+  }
+
+ private:
+  void RunTasks(unsigned int thread_index) {
+    int task_index;
+    while ((task_index = next_task_.fetch_add(1)) < task_num_) {
+      (*function_)(task_index, thread_index);
+    }
+  }
+
+  void WorkerLoop(unsigned int thread_index) {
+    unsigned long long seen_generation = 0;
+    while (true) {
+      {
+        std::unique_lock<std::mutex> lock(mutex_);
+        start_condition_.wait(lock, [this, seen_generation] {
+          return shutdown_ || generation_ != seen_generation;
+        });
+        if (shutdown_) {
+          return;
+        }
+        seen_generation = generation_;
+      }
+
+      RunTasks(thread_index);
+
+      {
+        std::lock_guard<std::mutex> lock(mutex_);
+        --busy_workers_;
+      }
+      finish_condition_.notify_one();
+    }
+  }
+
+  //! Total thread number including the caller
+  const unsigned int thread_num_;
+  //! Worker threads
+  std::vector<std::thread> workers_;
+  //! Protects the job description below
+  std::mutex mutex_;
+  std::condition_variable start_condition_;
+  std::condition_variable finish_condition_;
+  //! Job counter, bumped for every ParallelFor call
+  unsigned long long generation_;
+  bool shutdown_;
+  //! Current job
+  const std::function<void(int, unsigned int)> *function_ = nullptr;
+  int task_num_;
+  size_t busy_workers_;
+  std::atomic<int> next_task_;
+};
+
+} //namespace roborts_common
+
+#endif //ROBORTS_COMMON_THREAD_POOL_H
@@ -0,0 +1,166 @@
+/****************************************************************************
+ *  Copyright (C) 2019 RoboMaster.
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program. If not, see <http://www.gnu.org/licenses/>.
+ ***************************************************************************/
+
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <vector>
+
+#include "map_common.h"
+#include "costmap_2d.h"
+
+namespace {
+
+const unsigned int kMapSize = 400;
+const double kResolution = 0.05;
+const double kFootprintLength = 0.6;
+const double kFootprintWidth = 0.45;
+const int kAngleNum = 16;
+const int kIterationNum = 2000;
+
+/**
+ * @brief The robot footprint scaled by scale and rotated by yaw around (cx, cy).
+ */
+std::vector<geometry_msgs::Point> MakeFootprint(double cx, double cy, double yaw, double scale) {
+  const double corners[4][2] = {{1, 1}, {-1, 1}, {-1, -1}, {1, -1}};
+  std::vector<geometry_msgs::Point> footprint(4);
+  for (int i = 0; i < 4; ++i) {
+    double x = corners[i][0] * kFootprintLength * scale / 2, y = corners[i][1] * kFootprintWidth * scale / 2;
+    footprint[i].x = cx + x * std::cos(yaw) - y * std::sin(yaw);
+    footprint[i].y = cy + x * std::sin(yaw) + y * std::cos(yaw);
+  }
+  return footprint;
+}
+
+/**
+ * @brief SetConvexRegionCost() as it was before the scanline rasterizer: outline cells gathered by raytracing,
+ *        sorted by x and filled column by column.
+ */
+void LegacySetConvexRegionCost(roborts_costmap::Costmap2D &costmap,
+                               const std::vector<geometry_msgs::Point> &polygon, unsigned char cost_value) {
+  std::vector<roborts_costmap::MapLocation> map_polygon;
+  for (unsigned int i = 0; i < polygon.size(); ++i) {
+    roborts_costmap::MapLocation loc;
+    if (!costmap.World2Map(polygon[i].x, polygon[i].y, loc.x, loc.y)) {
+      return;
+    }
+    map_polygon.push_back(loc);
+  }
+  std::vector<roborts_costmap::MapLocation> cells;
+  costmap.GetConvexEdge(map_polygon, cells);
+  unsigned int i = 0;
+  while (i < cells.size() - 1) {
+    if (cells[i].x > cells[i + 1].x) {
+      std::swap(cells[i], cells[i + 1]);
+      if (i > 0)
+        --i;
+    } else
+      ++i;
+  }
+  i = 0;
+  roborts_costmap::MapLocation min_pt, max_pt;
+  unsigned int min_x = cells[0].x, max_x = cells[cells.size() - 1].x;
+  for (unsigned int x = min_x; x <= max_x; ++x) {
+    if (i >= cells.size() - 1)
+      break;
+    if (cells[i].y < cells[i + 1].y) {
+      min_pt = cells[i];
+      max_pt = cells[i + 1];
+    } else {
+      min_pt = cells[i + 1];
+      max_pt = cells[i];
+    }
+    i += 2;
+    while (i < cells.size() && cells[i].x == x) {
+      if (cells[i].y < min_pt.y)
+        min_pt = cells[i];
+      else if (cells[i].y > max_pt.y)
+        max_pt = cells[i];
+      ++i;
+    }
+    for (unsigned int y = min_pt.y; y < max_pt.y; ++y) {
+      cells.push_back({x, y});
+    }
+  }
+  for (unsigned int j = 0; j < cells.size(); ++j) {
+    costmap.SetCost(cells[j].x, cells[j].y, cost_value);
+  }
+}
+
+unsigned int CountCells(const roborts_costmap::Costmap2D &costmap, unsigned char cost_value) {
+  const unsigned char *map = costmap.GetCharMap();
+  unsigned int count = 0;
+  for (unsigned int i = 0; i < kMapSize * kMapSize; ++i) {
+    count += map[i] == cost_value;
+  }
+  return count;
+}
+
+} //namespace
+
+int main(int argc, char **argv) {
+  roborts_costmap::Costmap2D legacy_map(kMapSize, kMapSize, kResolution, 0, 0, roborts_costmap::LETHAL_OBSTACLE);
+  roborts_costmap::Costmap2D scanline_map(kMapSize, kMapSize, kResolution, 0, 0, roborts_costmap::LETHAL_OBSTACLE);
+  roborts_costmap::ConvexSpans spans;
+  const double center = kMapSize * kResolution / 2;
+  const double scales[] = {1, 2, 4, 8};
+  for (double scale : scales) {
+    std::vector<std::vector<geometry_msgs::Point>> footprints;
+    for (int i = 0; i < kAngleNum; ++i) {
+      footprints.push_back(MakeFootprint(center, center, M_PI * i / kAngleNum, scale));
+    }
+
+    double legacy_time = 0, scanline_time = 0;
+    unsigned int legacy_cells = 0, scanline_cells = 0, missed_cells = 0, extra_cells = 0;
+    for (const auto &footprint : footprints) {
+      legacy_map.ResetPartMap(0, 0, kMapSize, kMapSize);
+      scanline_map.ResetPartMap(0, 0, kMapSize, kMapSize);
+      auto start = std::chrono::steady_clock::now();
+      for (int i = 0; i < kIterationNum; ++i) {
+        LegacySetConvexRegionCost(legacy_map, footprint, roborts_costmap::FREE_SPACE);
+      }
+      auto middle = std::chrono::steady_clock::now();
+      for (int i = 0; i < kIterationNum; ++i) {
+        scanline_map.SetConvexRegionCost(footprint, roborts_costmap::FREE_SPACE, spans);
+      }
+      auto end = std::chrono::steady_clock::now();
+      legacy_time += std::chrono::duration<double, std::micro>(middle - start).count();
+      scanline_time += std::chrono::duration<double, std::micro>(end - middle).count();
+
+      legacy_cells += CountCells(legacy_map, roborts_costmap::FREE_SPACE);
+      scanline_cells += CountCells(scanline_map, roborts_costmap::FREE_SPACE);
+      for (unsigned int i = 0; i < kMapSize * kMapSize; ++i) {
+        bool legacy_filled = legacy_map.GetCharMap()[i] == roborts_costmap::FREE_SPACE;
+        bool scanline_filled = scanline_map.GetCharMap()[i] == roborts_costmap::FREE_SPACE;
+        missed_cells += legacy_filled && !scanline_filled;
+        extra_cells += scanline_filled && !legacy_filled;
+      }
+    }
+    const int call_num = kAngleNum * kIterationNum;
+    printf("scale: %.0f  legacy: %.2f us  scanline: %.2f us  speedup: %.1f  cells legacy/scanline: %u/%u  "
+           "missed: %u  extra: %u\n", scale, legacy_time / call_num, scanline_time / call_num,
+           legacy_time / scanline_time, legacy_cells / kAngleNum, scanline_cells / kAngleNum, missed_cells,
+           extra_cells);
+    if (missed_cells > 0 || extra_cells > 0) {
+      fprintf(stderr, "scale: %.0f  the scanline filler missed %u cells the legacy filler filled and filled %u cells "
+              "it left\n", scale, missed_cells, extra_cells);
+      return 1;
+    }
+  }
+  return 0;
+}
@@ -0,0 +1,483 @@
+/****************************************************************************
+ *  Copyright (C) 2019 RoboMaster.
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program. If not, see <http://www.gnu.org/licenses/>.
+ ***************************************************************************/
+
+/**
+ * Offline costmap benchmark. Builds the layered costmaps of the prototxt configs without ROS master and tf,
+ * gives them the icra maps directly and feeds laser scans along a trajectory, then reports the time of every
+ * layer's UpdateBounds and UpdateCosts, the full update cycle and the memory of every configuration.
+ *
+ * usage: costmap_benchmark [--cycles N] [--threads N] [--scans FILE]
+ *
+ * Without --scans the scans are cast against the static map along an ellipse around the map center. A scan
+ * file replays recorded scans instead, one per line:
+ *   x y yaw angle_min angle_increment range_num range_1 ... range_n
+ * with the pose of the laser in the map frame, e.g. dumped from a bag of the scan and the localization.
+ */
+
+#include <sys/resource.h>
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include <ros/package.h>
+#include "io/io.h"
+#include "costmap_parameter_setting.pb.h"
+#include "obstacle_layer_setting.pb.h"
+#include "footprint.h"
+#include "layered_costmap.h"
+#include "static_layer.h"
+#include "obstacle_layer.h"
+#include "voxel_layer.h"
+#include "inflation_layer.h"
+#include "map_loader.h"
+
+namespace roborts_costmap {
+
+/**
+ * @brief Layer wrapper timing the update steps of the layer it owns.
+ */
+class TimedLayer : public Layer {
+ public:
+  explicit TimedLayer(Layer *layer) : layer_(layer) {
+    is_current_ = true;
+  }
+  ~TimedLayer() {
+    delete layer_;
+  }
+  void UpdateBounds(double robot_x, double robot_y, double robot_yaw, double *min_x, double *min_y,
+                    double *max_x, double *max_y) override {
+    auto start = Clock::now();
+    layer_->UpdateBounds(robot_x, robot_y, robot_yaw, min_x, min_y, max_x, max_y);
+    bounds_time_ += Elapsed(start);
+  }
+  void UpdateCosts(Costmap2D &master_grid, int min_i, int min_j, int max_i, int max_j) override {
+    auto start = Clock::now();
+    layer_->UpdateCosts(master_grid, min_i, min_j, max_i, max_j);
+    costs_time_ += Elapsed(start);
+  }
+  bool IsTileParallel() const override {
+    return layer_->IsTileParallel();
+  }
+  void PrepareTiles(Costmap2D &master_grid, int min_i, int min_j, int max_i, int max_j,
+                    unsigned int thread_num) override {
+    auto start = Clock::now();
+    layer_->PrepareTiles(master_grid, min_i, min_j, max_i, max_j, thread_num);
+    costs_time_ += Elapsed(start);
+    tile_time_.resize(std::max<size_t>(tile_time_.size(), thread_num), 0);
+  }
+  void UpdateCostsTile(Costmap2D &master_grid, int min_i, int min_j, int max_i, int max_j,
+                       unsigned int thread_index) override {
+    auto start = Clock::now();
+    layer_->UpdateCostsTile(master_grid, min_i, min_j, max_i, max_j, thread_index);
+    tile_time_[thread_index] += Elapsed(start);
+  }
+  void MatchSize() override {
+    layer_->MatchSize();
+  }
+  void OnFootprintChanged() override {
+    layer_->OnFootprintChanged();
+  }
+  Layer *GetLayer() const {
+    return layer_;
+  }
+  /**
+   * @brief Time spent in UpdateBounds in us.
+   */
+  double GetBoundsTime() const {
+    return bounds_time_;
+  }
+  /**
+   * @brief Time spent in UpdateCosts in us, tile updates counted summed over all threads.
+   */
+  double GetCostsTime() const {
+    double time = costs_time_;
+    for (double tile_time : tile_time_) {
+      time += tile_time;
+    }
+    return time;
+  }
+  void ResetTimes() {
+    bounds_time_ = costs_time_ = 0;
+    std::fill(tile_time_.begin(), tile_time_.end(), 0);
+  }
+
+ private:
+  typedef std::chrono::steady_clock Clock;
+  static double Elapsed(Clock::time_point start) {
+    return std::chrono::duration<double, std::micro>(Clock::now() - start).count();
+  }
+  Layer *layer_;
+  double bounds_time_ = 0, costs_time_ = 0;
+  //! Tile update time of every thread, so threads never write the same counter
+  std::vector<double> tile_time_;
+};
+
+} //namespace roborts_costmap
+
+namespace {
+
+using roborts_costmap::TimedLayer;
+
+/**
+ * @brief A laser scan with the pose of the laser in the map frame.
+ */
+struct Scan {
+  double x, y, yaw;
+  double angle_min, angle_increment;
+  std::vector<float> ranges;
+};
+
+/**
+ * @brief A costmap configuration to benchmark.
+ */
+struct BenchmarkConfig {
+  std::string name;
+  //! Costmap prototxt in the config directory of roborts_costmap
+  std::string config_file;
+  //! Map yaml in the maps directory of roborts_bringup
+  std::string map_file;
+  //! Every map cell is split into upsample x upsample cells for the large map configurations
+  int upsample;
+  //! Run the voxel layer in place of the obstacle layer
+  bool voxel;
+};
+
+
+/**
+ * @brief Cast a scan of beam_num beams over field_of_view against the occupied cells of the map.
+ */
+Scan CastScan(const nav_msgs::OccupancyGrid &map, double x, double y, double yaw, int beam_num,
+              double field_of_view, double range_max) {
+  Scan scan;
+  scan.x = x;
+  scan.y = y;
+  scan.yaw = yaw;
+  scan.angle_min = -field_of_view / 2;
+  scan.angle_increment = field_of_view / (beam_num - 1);
+  const double step = map.info.resolution / 2;
+  for (int i = 0; i < beam_num; ++i) {
+    double angle = yaw + scan.angle_min + i * scan.angle_increment;
+    double dx = std::cos(angle) * step, dy = std::sin(angle) * step;
+    float range = range_max;
+    for (double r = 0, px = x, py = y; r < range_max; r += step, px += dx, py += dy) {
+      int cx = static_cast<int>((px - map.info.origin.position.x) / map.info.resolution);
+      int cy = static_cast<int>((py - map.info.origin.position.y) / map.info.resolution);
+      if (cx < 0 || cy < 0 || cx >= static_cast<int>(map.info.width) || cy >= static_cast<int>(map.info.height)
+          || map.data[cy * map.info.width + cx] == 100) {
+        range = r;
+        break;
+      }
+    }
+    scan.ranges.push_back(range);
+  }
+  return scan;
+}
+
+/**
+ * @brief Scans along an ellipse around the map center, looking ahead.
+ */
+std::vector<Scan> MakeSyntheticScans(const nav_msgs::OccupancyGrid &map, int scan_num, double range_max) {
+  const double center_x = map.info.origin.position.x + map.info.width * map.info.resolution / 2;
+  const double center_y = map.info.origin.position.y + map.info.height * map.info.resolution / 2;
+  const double radius_x = 0.35 * map.info.width * map.info.resolution;
+  const double radius_y = 0.35 * map.info.height * map.info.resolution;
+  std::vector<Scan> scans;
+  for (int i = 0; i < scan_num; ++i) {
+    double t = 2 * M_PI * i / scan_num;
+    double yaw = std::atan2(radius_y * std::cos(t), -radius_x * std::sin(t));
+    scans.push_back(CastScan(map, center_x + radius_x * std::cos(t), center_y + radius_y * std::sin(t), yaw,
+                             1080, 1.5 * M_PI, range_max));
+  }
+  return scans;
+}
+
+std::vector<Scan> LoadScans(const std::string &path) {
+  std::vector<Scan> scans;
+  std::ifstream file(path);
+  std::string line;
+  while (std::getline(file, line)) {
+    std::istringstream stream(line);
+    Scan scan;
+    size_t range_num = 0;
+    if (!(stream >> scan.x >> scan.y >> scan.yaw >> scan.angle_min >> scan.angle_increment >> range_num)) {
+      continue;
+    }
+    scan.ranges.resize(range_num);
+    for (size_t i = 0; i < range_num && stream >> scan.ranges[i]; ++i) {
+    }
+    scans.push_back(scan);
+  }
+  return scans;
+}
+
+/**
+ * @brief The points of a scan in the map frame at the given height, beams without a return are left out.
+ */
+void ScanToCloud(const Scan &scan, double range_max, double height, pcl::PointCloud<pcl::PointXYZ> &cloud) {
+  cloud.points.clear();
+  for (size_t i = 0; i < scan.ranges.size(); ++i) {
+    double range = scan.ranges[i];
+    if (!std::isfinite(range) || range >= range_max) {
+      continue;
+    }
+    double angle = scan.yaw + scan.angle_min + i * scan.angle_increment;
+    cloud.points.push_back(pcl::PointXYZ(scan.x + range * std::cos(angle), scan.y + range * std::sin(angle),
+                                         height));
+  }
+  cloud.width = cloud.points.size();
+  cloud.height = 1;
+}
+
+/**
+ * @brief Resident memory of the process in KB.
+ */
+long ResidentMemory() {
+  long pages = 0, resident = 0;
+  FILE *statm = fopen("/proc/self/statm", "r");
+  if (statm != nullptr) {
+    if (fscanf(statm, "%ld %ld", &pages, &resident) != 2) {
+      resident = 0;
+    }
+    fclose(statm);
+  }
+  return resident * (sysconf(_SC_PAGESIZE) / 1024);
+}
+
+double Percentile(std::vector<double> values, double percentile) {
+  if (values.empty()) {
+    return 0;
+  }
+  size_t index = std::min(values.size() - 1, static_cast<size_t>(percentile * values.size()));
+  std::nth_element(values.begin(), values.begin() + index, values.end());
+  return values[index];
+}
+
+std::vector<geometry_msgs::Point> LoadFootprint(const roborts_costmap::ParaCollection &para_collection) {
+  std::vector<geometry_msgs::Point> footprint;
+  for (const auto &point : para_collection.footprint().point()) {
+    geometry_msgs::Point footprint_point;
+    footprint_point.x = point.x();
+    footprint_point.y = point.y();
+    footprint.push_back(footprint_point);
+  }
+  roborts_costmap::PadFootprint(footprint, para_collection.para_costmap_interface().footprint_padding());
+  return footprint;
+}
+
+/**
+ * @brief Check GetStaticCostMap() against the master of a costmap holding only the static and inflation layers,
+ *        which is what the inflation layer makes of the static map.
+ * @return False if a cell differs
+ */
+bool CheckStaticCostMap(const roborts_costmap::ParaCollection &para_collection, const std::string &inflation_path,
+                        const nav_msgs::OccupancyGrid::Ptr &map, unsigned int thread_num) {
+  const roborts_costmap::ParaCostmapInterface &para = para_collection.para_costmap_interface();
+  roborts_costmap::CostmapLayers layered_costmap(para.global_frame(), false, para.is_tracking_unknown());
+  layered_costmap.SetFilePath(inflation_path);
+  layered_costmap.SetUpdateThreadNum(thread_num, para.update_tile_size());
+  auto *static_layer = new roborts_costmap::StaticLayer;
+  layered_costmap.AddPlugin(static_layer);
+  static_layer->Initialize(&layered_costmap, "static_layer", nullptr);
+  static_layer->SetMap(map);
+  auto *inflation_layer = new roborts_costmap::InflationLayer;
+  layered_costmap.AddPlugin(inflation_layer);
+  inflation_layer->Initialize(&layered_costmap, "inflation_layer", nullptr);
+  layered_costmap.SetFootprint(LoadFootprint(para_collection));
+  layered_costmap.UpdateMap(0, 0, 0);
+
+  roborts_costmap::Costmap2D static_costmap;
+  if (!layered_costmap.GetStaticCostMap(static_costmap)) {
+    fprintf(stderr, "No static cost map\n");
+    return false;
+  }
+  const roborts_costmap::Costmap2D *master = layered_costmap.GetCostMap();
+  const unsigned int size = master->GetSizeXCell() * master->GetSizeYCell();
+  unsigned int mismatches = 0;
+  for (unsigned int i = 0; i < size; ++i) {
+    mismatches += static_costmap.GetCharMap()[i] != master->GetCharMap()[i];
+  }
+  printf("  static cost map: %u of %u cells differ from the inflation layer\n", mismatches, size);
+  return mismatches == 0;
+}
+
+bool RunBenchmark(const BenchmarkConfig &config, const std::vector<Scan> &recorded_scans, int cycle_num,
+                  unsigned int thread_num) {
+  const std::string costmap_path = ros::package::getPath("roborts_costmap");
+  roborts_costmap::ParaCollection para_collection;
+  if (!roborts_common::ReadProtoFromTextFile(costmap_path + "/config/" + config.config_file, &para_collection)) {
+    return false;
+  }
+  const roborts_costmap::ParaCostmapInterface &para = para_collection.para_costmap_interface();
+  roborts_costmap::ParaObstacleLayer para_obstacle;
+  roborts_common::ReadProtoFromTextFile(costmap_path + "/config/obstacle_layer_config.prototxt", &para_obstacle);
+  nav_msgs::OccupancyGrid::Ptr map(new nav_msgs::OccupancyGrid());
+  if (!roborts_costmap::LoadMap(ros::package::getPath("roborts_bringup") + "/maps/" + config.map_file, config.upsample,
+                                *map)) {
+    return false;
+  }
+  map->header.frame_id = para.global_frame();
+
+  long memory_before = ResidentMemory();
+  // the layers as CostmapInterface builds them, without tf they neither subscribe nor wait for anything
+  roborts_costmap::CostmapLayers layered_costmap(para.global_frame(), para.is_rolling_window(),
+                                                 para.is_tracking_unknown());
+  layered_costmap.SetFilePath(costmap_path + para.inflation_file_path());
+  layered_costmap.SetUpdateThreadNum(thread_num, para.update_tile_size());
+  layered_costmap.SetMaxPyramidEnabled(para.has_max_pyramid());
+  if (para.is_rolling_window()) {
+    layered_costmap.ResizeMap(static_cast<unsigned int>(para.map_width() / para.map_resolution()),
+                              static_cast<unsigned int>(para.map_height() / para.map_resolution()),
+                              para.map_resolution(), para.map_origin_x(), para.map_origin_y());
+  }
+  std::vector<TimedLayer *> timed_layers;
+  auto add_layer = [&](roborts_costmap::Layer *layer, const std::string &name) {
+    TimedLayer *timed_layer = new TimedLayer(layer);
+    layered_costmap.AddPlugin(timed_layer);
+    layer->Initialize(&layered_costmap, name, nullptr);
+    timed_layer->Initialize(&layered_costmap, name, nullptr);
+    timed_layers.push_back(timed_layer);
+    return layer;
+  };
+  if (para.has_static_layer()) {
+    auto *static_layer = static_cast<roborts_costmap::StaticLayer *>(
+        add_layer(new roborts_costmap::StaticLayer, "static_layer"));
+    static_layer->SetMap(map);
+  }
+  roborts_costmap::ObstacleLayer *obstacle_layer = nullptr;
+  if (para.has_obstacle_layer()) {
+    if (config.voxel || para.has_voxel_layer()) {
+      obstacle_layer = static_cast<roborts_costmap::ObstacleLayer *>(
+          add_layer(new roborts_costmap::VoxelLayer, "voxel_layer"));
+    } else {
+      obstacle_layer = static_cast<roborts_costmap::ObstacleLayer *>(
+          add_layer(new roborts_costmap::ObstacleLayer, "obstacle_layer"));
+    }
+  }
+  add_layer(new roborts_costmap::InflationLayer, "inflation_layer");
+  layered_costmap.SetFootprint(LoadFootprint(para_collection));
+
+  const double range_max = para_obstacle.raytrace_range();
+  const double height = (para_obstacle.min_obstacle_height() + para_obstacle.max_obstacle_height()) / 2;
+  std::vector<Scan> scans = recorded_scans.empty() ? MakeSyntheticScans(*map, 200, range_max) : recorded_scans;
+
+  // the first cycles size the layers and inflate the whole map, they are not part of the steady state
+  pcl::PointCloud<pcl::PointXYZ> cloud;
+  std::vector<double> cycle_times;
+  const int warmup_num = 5;
+  for (int cycle = 0; cycle < warmup_num + cycle_num; ++cycle) {
+    if (cycle == warmup_num) {
+      for (TimedLayer *timed_layer : timed_layers) {
+        timed_layer->ResetTimes();
+      }
+    }
+    const Scan &scan = scans[cycle % scans.size()];
+    if (obstacle_layer != nullptr) {
+      geometry_msgs::Point origin;
+      origin.x = scan.x;
+      origin.y = scan.y;
+      origin.z = height;
+      ScanToCloud(scan, range_max, height, cloud);
+      cloud.header.stamp = ros::Time::now().toNSec() / 1000;
+      obstacle_layer->AddObservation(origin, cloud);
+    }
+    auto start = std::chrono::steady_clock::now();
+    layered_costmap.UpdateMap(scan.x, scan.y, scan.yaw);
+    if (cycle >= warmup_num) {
+      cycle_times.push_back(
+          std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count());
+    }
+  }
+  long memory_after = ResidentMemory();
+
+  const roborts_costmap::Costmap2D *master = layered_costmap.GetCostMap();
+  printf("%s: %s, %ux%u cells at %.4f m, %s, %u thread(s), %d cycles of %zu %s scans\n", config.name.c_str(),
+         config.config_file.c_str(), master->GetSizeXCell(), master->GetSizeYCell(), master->GetResolution(),
+         para.is_rolling_window() ? "rolling" : "static", thread_num, cycle_num, scans.size(),
+         recorded_scans.empty() ? "synthetic" : "recorded");
+  printf("  %-16s %14s %14s %10s\n", "layer", "bounds us", "costs us", "grid KB");
+  for (TimedLayer *timed_layer : timed_layers) {
+    auto *grid = dynamic_cast<const roborts_costmap::Costmap2D *>(timed_layer->GetLayer());
+    double grid_size = grid != nullptr ? grid->GetSizeXCell() * grid->GetSizeYCell() / 1024.0 : 0;
+    printf("  %-16s %14.1f %14.1f %10.0f\n", timed_layer->GetName().c_str(),
+           timed_layer->GetBoundsTime() / cycle_num, timed_layer->GetCostsTime() / cycle_num, grid_size);
+  }
+  double total = 0;
+  for (double time : cycle_times) {
+    total += time;
+  }
+  printf("  cycle: mean %.1f us, p50 %.1f us, p99 %.1f us, max %.1f us\n", total / cycle_times.size(),
+         Percentile(cycle_times, 0.5), Percentile(cycle_times, 0.99), Percentile(cycle_times, 1.0));
+  if (para.has_static_layer() && !para.is_rolling_window()
+      && !CheckStaticCostMap(para_collection, costmap_path + para.inflation_file_path(), map, thread_num)) {
+    return false;
+  }
+  printf("  memory: master %.0f KB, resident +%ld KB\n\n",
+         master->GetSizeXCell() * master->GetSizeYCell() / 1024.0, memory_after - memory_before);
+  return true;
+}
+
+} //namespace
+
+int main(int argc, char **argv) {
+  int cycle_num = 200;
+  unsigned int thread_num = 1;
+  std::string scan_file;
+  for (int i = 1; i + 1 < argc; i += 2) {
+    std::string option = argv[i];
+    if (option == "--cycles") {
+      cycle_num = std::max(1, atoi(argv[i + 1]));
+    } else if (option == "--threads") {
+      thread_num = std::max(1, atoi(argv[i + 1]));
+    } else if (option == "--scans") {
+      scan_file = argv[i + 1];
+    } else {
+      fprintf(stderr, "usage: %s [--cycles N] [--threads N] [--scans FILE]\n", argv[0]);
+      return 1;
+    }
+  }
+  // only wall time is needed, no master
+  ros::Time::init();
+  std::vector<Scan> recorded_scans;
+  if (!scan_file.empty()) {
+    recorded_scans = LoadScans(scan_file);
+    if (recorded_scans.empty()) {
+      fprintf(stderr, "No scan in %s\n", scan_file.c_str());
+      return 1;
+    }
+  }
+
+  const BenchmarkConfig configs[] = {
+      {"static icra2019", "costmap_parameter_config_for_global_plan.prototxt", "icra2019.yaml", 1, false},
+      {"static icra2018", "costmap_parameter_config_for_global_plan.prototxt", "icra2018.yaml", 1, false},
+      {"rolling icra2019", "costmap_parameter_config_for_local_plan.prototxt", "icra2019.yaml", 1, false},
+      {"large icra2019 x4", "costmap_parameter_config_for_global_plan.prototxt", "icra2019.yaml", 4, false},
+      {"static icra2019 voxel", "costmap_parameter_config_for_global_plan.prototxt", "icra2019.yaml", 1, true},
+      {"rolling icra2019 voxel", "costmap_parameter_config_for_local_plan.prototxt", "icra2019.yaml", 1, true},
+  };
+  for (const BenchmarkConfig &config : configs) {
+    if (!RunBenchmark(config, recorded_scans, cycle_num, thread_num)) {
+      return 1;
+    }
+  }
+  return 0;
+}
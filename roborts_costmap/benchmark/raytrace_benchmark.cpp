@@ -0,0 +1,109 @@
+/****************************************************************************
+ *  Copyright (C) 2019 RoboMaster.
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program. If not, see <http://www.gnu.org/licenses/>.
+ ***************************************************************************/
+
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <random>
+#include <vector>
+
+#include "obstacle_layer.h"
+
+namespace roborts_costmap {
+
+/**
+ * @brief Obstacle layer exposing the raytracing step, so it can be timed without ROS and tf.
+ */
+class RaytraceBenchmarkLayer : public ObstacleLayer {
+ public:
+  void Raytrace(const Observation &observation) {
+    double min_x = std::numeric_limits<double>::max(), min_y = min_x;
+    double max_x = -std::numeric_limits<double>::max(), max_y = max_x;
+    RaytraceFreespace(observation, &min_x, &min_y, &max_x, &max_y);
+  }
+  void Fill(unsigned char cost) {
+    memset(costmap_, cost, size_x_ * size_y_);
+  }
+};
+
+} //namespace roborts_costmap
+
+namespace {
+
+const unsigned int kMapSize = 400;
+const double kResolution = 0.05;
+const int kBeamNum = 1080;
+const double kFieldOfView = 1.5 * M_PI;
+const double kRaytraceRange = 10.0;
+const int kIterationNum = 200;
+
+/**
+ * @brief A 270 degree scan of 1080 beams with random ranges, around the sensor at (ox, oy).
+ */
+roborts_costmap::Observation MakeScan(double ox, double oy) {
+  std::mt19937 generator(1080);
+  std::uniform_real_distribution<double> range(1.0, kRaytraceRange);
+  pcl::PointCloud<pcl::PointXYZ> cloud;
+  for (int i = 0; i < kBeamNum; ++i) {
+    double angle = -kFieldOfView / 2 + kFieldOfView * i / (kBeamNum - 1);
+    double r = range(generator);
+    cloud.points.push_back(pcl::PointXYZ(ox + r * std::cos(angle), oy + r * std::sin(angle), 0));
+  }
+  geometry_msgs::Point origin;
+  origin.x = ox;
+  origin.y = oy;
+  return roborts_costmap::Observation(origin, cloud, kRaytraceRange, kRaytraceRange);
+}
+
+} //namespace
+
+int main(int argc, char **argv) {
+  roborts_costmap::RaytraceBenchmarkLayer layer;
+  layer.ResizeMap(kMapSize, kMapSize, kResolution, 0, 0);
+  roborts_costmap::Observation scan = MakeScan(kMapSize * kResolution / 2, kMapSize * kResolution / 2);
+
+  std::vector<unsigned char> reference;
+  double serial_time = 0;
+  const unsigned int thread_nums[] = {1, 2, 4};
+  for (unsigned int thread_num : thread_nums) {
+    layer.SetRaytraceThreadNum(thread_num);
+    double total_time = 0;
+    for (int i = 0; i < kIterationNum; ++i) {
+      layer.Fill(roborts_costmap::LETHAL_OBSTACLE);
+      auto start = std::chrono::steady_clock::now();
+      layer.Raytrace(scan);
+      total_time += std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count();
+    }
+    double average_time = total_time / kIterationNum;
+
+    std::vector<unsigned char> result(layer.GetCharMap(), layer.GetCharMap() + kMapSize * kMapSize);
+    bool identical = true;
+    if (reference.empty()) {
+      reference = result;
+      serial_time = average_time;
+    } else {
+      identical = result == reference;
+    }
+    printf("threads: %u  beams: %d  average: %.1f us  speedup: %.2f  identical to serial: %s\n",
+           thread_num, kBeamNum, average_time, serial_time / average_time, identical ? "yes" : "NO");
+    if (!identical) {
+      return 1;
+    }
+  }
+  return 0;
+}
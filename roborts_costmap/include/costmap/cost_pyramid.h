@@ -0,0 +1,117 @@
+/****************************************************************************
+ *  Copyright (C) 2019 RoboMaster.
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program. If not, see <http://www.gnu.org/licenses/>.
+ ***************************************************************************/
+
+#ifndef ROBORTS_COSTMAP_COST_PYRAMID_H
+#define ROBORTS_COSTMAP_COST_PYRAMID_H
+
+#include <vector>
+
+namespace roborts_costmap {
+
+/**
+ * @brief Max reduction pyramid of a cost grid. Level l holds the maximum cost of every 2^l x 2^l block of the
+ *        base grid, so whether a region contains a cost can be answered coarse to fine instead of reading every
+ *        cell. The base grid itself is level 0 and is not copied, every query takes it as argument.
+ */
+class CostPyramid {
+ public:
+  CostPyramid();
+  /**
+   * @brief Allocate the levels for a base grid, the pyramid is stale until the next Update().
+   * @param size_x The x size of the base grid in cells
+   * @param size_y The y size of the base grid in cells
+   */
+  void Resize(unsigned int size_x, unsigned int size_y);
+  /**
+   * @brief Mark every level out of date, e.g. after the base grid was reset or shifted. The next Update()
+   *        rebuilds the whole pyramid and queries read the base grid until then.
+   */
+  void Invalidate() {
+    is_stale_ = true;
+  }
+  /**
+   * @brief Mark the levels above the cells [x0, xn) x [y0, yn) of the base grid out of date, e.g. after they were
+   *        reset. The next Update() recomputes them along with its own region and queries read the base grid
+   *        until then.
+   */
+  void Invalidate(unsigned int x0, unsigned int y0, unsigned int xn, unsigned int yn);
+  /**
+   * @brief Whether the levels reflect the base grid as of the last Update().
+   */
+  bool IsValid() const {
+    return !is_stale_ && !levels_.empty() && dirty_x0_ >= dirty_xn_;
+  }
+  /**
+   * @brief Recompute the levels above the cells [x0, xn) x [y0, yn) of the base grid and the cells invalidated
+   *        since the last update, or all levels if stale.
+   * @param base The base grid, size_x * size_y cells in row major order
+   */
+  void Update(const unsigned char *base, unsigned int x0, unsigned int y0, unsigned int xn, unsigned int yn);
+  /**
+   * @brief The maximum cost of the cells [x0, xn) x [y0, yn) of the base grid.
+   * @param base The base grid the pyramid was updated from
+   * @return The maximum cost, 0 for an empty region
+   */
+  unsigned char GetMaxCost(const unsigned char *base, unsigned int x0, unsigned int y0, unsigned int xn,
+                           unsigned int yn) const;
+  /**
+   * @brief Whether any cell of [x0, xn) x [y0, yn) has a cost of at least threshold. Blocks below the threshold
+   *        are skipped whole and the search stops at the first block inside the region that reaches it.
+   * @param base The base grid the pyramid was updated from
+   */
+  bool IsCostAtLeast(const unsigned char *base, unsigned int x0, unsigned int y0, unsigned int xn,
+                     unsigned int yn, unsigned char threshold) const;
+
+ private:
+  struct Level {
+    unsigned int size_x, size_y;
+    std::vector<unsigned char> cost;
+  };
+  /**
+   * @brief Max cost of cell (x, y) of level, level 0 being the base grid.
+   */
+  unsigned char Cost(const unsigned char *base, unsigned int level, unsigned int x, unsigned int y) const {
+    return level == 0 ? base[y * size_x_ + x] : levels_[level - 1].cost[y * levels_[level - 1].size_x + x];
+  }
+  /**
+   * @brief Recompute cells [x0, xn) x [y0, yn) of level from the level below.
+   */
+  void ReduceLevel(const unsigned char *base, unsigned int level, unsigned int x0, unsigned int y0,
+                   unsigned int xn, unsigned int yn);
+  /**
+   * @brief Descend into cell (x, y) of level, raising max_cost to the maximum of its part inside the region.
+   *        Returns true once max_cost reaches stop_cost.
+   */
+  bool Search(const unsigned char *base, unsigned int level, unsigned int x, unsigned int y,
+              unsigned int x0, unsigned int y0, unsigned int xn, unsigned int yn,
+              unsigned char stop_cost, unsigned char &max_cost) const;
+  /**
+   * @brief Visit the few cells of the coarsest level at which the region spans at most two cells per axis.
+   */
+  bool SearchRegion(const unsigned char *base, unsigned int x0, unsigned int y0, unsigned int xn,
+                    unsigned int yn, unsigned char stop_cost, unsigned char &max_cost) const;
+
+  unsigned int size_x_, size_y_;
+  //! Levels 1 to n, the last one has a single cell
+  std::vector<Level> levels_;
+  bool is_stale_;
+  //! Cells [dirty_x0_, dirty_xn_) x [dirty_y0_, dirty_yn_) of the base grid invalidated since the last update
+  unsigned int dirty_x0_, dirty_y0_, dirty_xn_, dirty_yn_;
+};
+
+} //namespace roborts_costmap
+#endif //ROBORTS_COSTMAP_COST_PYRAMID_H
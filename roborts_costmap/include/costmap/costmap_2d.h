@@ -56,6 +56,7 @@
 #include <queue>
 #include <mutex>
 #include <geometry_msgs/Point.h>
+#include "cost_pyramid.h"
 
 namespace roborts_costmap{
 
@@ -67,6 +68,19 @@ struct MapLocation {
   unsigned int y;
 };
 
+/**
+ * @brief Scratch memory of Costmap2D::RasterizeConvexPolygon(). Kept by the caller, so rasterizing stops
+ *        allocating once the vectors have grown to the largest polygon.
+ */
+struct ConvexSpans {
+  //! The polygon covers the rows [min_y, min_y + row_num)
+  unsigned int min_y = 0, row_num = 0;
+  //! First and last cell of the polygon in every covered row, indexed by y - min_y
+  std::vector<unsigned int> min_x, max_x;
+  //! Polygon vertices in map coordinates
+  std::vector<MapLocation> vertices;
+};
+
 /**
  * @class Costmap2D
  * @brief Map provides a mapping between the world and map cost
@@ -201,6 +215,43 @@ class Costmap2D {
    */
   unsigned char *GetCharMap() const;
 
+  /**
+   * @brief  Keep a max cost pyramid of the costmap for region queries. It is brought up to date by
+   *         UpdateMaxPyramid(), cost changes made after that are not seen by the queries.
+   * @param  enabled Whether to keep the pyramid
+   */
+  void SetMaxPyramidEnabled(bool enabled);
+
+  bool HasMaxPyramid() const {
+    return has_max_pyramid_;
+  }
+
+  /**
+   * @brief  Update the max cost pyramid after the costs of the cells [x0, xn) x [y0, yn) changed.
+   */
+  void UpdateMaxPyramid(unsigned int x0, unsigned int y0, unsigned int xn, unsigned int yn);
+
+  /**
+   * @brief  Get the maximum cost of the cells [x0, xn) x [y0, yn), coarse to fine if the pyramid is kept.
+   * @return The maximum cost, 0 for an empty region
+   */
+  unsigned char GetRegionMaxCost(unsigned int x0, unsigned int y0, unsigned int xn, unsigned int yn) const;
+
+  /**
+   * @brief  Whether any of the cells [x0, xn) x [y0, yn) has a cost of at least threshold, e.g. LETHAL_OBSTACLE
+   *         for a collision test. With the pyramid, blocks below the threshold are skipped whole.
+   */
+  bool IsRegionCostAtLeast(unsigned int x0, unsigned int y0, unsigned int xn, unsigned int yn,
+                           unsigned char threshold) const;
+
+  /**
+   * @brief  Get the maximum cost inside the bounding box of a footprint, an upper bound of the footprint cost.
+   * @param  footprint The footprint in world coordinates
+   * @param  cost Receives the maximum cost
+   * @return False if the bounding box leaves the map
+   */
+  bool GetFootprintMaxCost(const std::vector<geometry_msgs::Point> &footprint, unsigned char &cost) const;
+
   /**
    * @brief  Accessor for the x size of the costmap in cells
    * @return The x size of the costmap in cells
@@ -265,6 +316,25 @@ class Costmap2D {
    */
   bool SetConvexRegionCost(const std::vector<geometry_msgs::Point> &polygon_edge_world, unsigned char value);
 
+  /**
+   * @brief  Sets the cost of a convex polygon to a desired value, with caller provided scratch memory
+   * @param  polygon The polygon to perform the operation on
+   * @param  cost_value The value to set costs to
+   * @param  spans Scratch memory, reused between calls
+   * @return True if the polygon was filled, false if it could not be filled
+   */
+  bool SetConvexRegionCost(const std::vector<geometry_msgs::Point> &polygon_edge_world, unsigned char value,
+                           ConvexSpans &spans);
+
+  /**
+   * @brief  Rasterize a convex polygon into the first and last cell of every row it covers. The edges are
+   *         walked once and write the row spans directly, nothing is sorted or allocated beyond the scratch.
+   * @param  polygon The polygon vertices in map coordinates
+   * @param  num Number of vertices
+   * @param  spans Receives the row spans
+   */
+  void RasterizeConvexPolygon(const MapLocation *polygon, size_t num, ConvexSpans &spans) const;
+
   /**polygonOutlineCells
    * @brief  Get the map cells that make up the outline of a polygon
    * @param convex_region_cells The polygon in map coordinates to rasterize
@@ -445,6 +515,11 @@ class Costmap2D {
   double origin_y_;
   unsigned char *costmap_;
   unsigned char default_value_;
+  //! Scratch of SetConvexRegionCost() without caller provided scratch
+  ConvexSpans convex_spans_;
+  //! Max cost pyramid of costmap_, only kept if has_max_pyramid_
+  CostPyramid max_pyramid_;
+  bool has_max_pyramid_;
 
   class MarkCell {
    public:
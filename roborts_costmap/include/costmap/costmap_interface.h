@@ -54,10 +54,13 @@
 
 #include <Eigen/Core>
 #include <Eigen/StdVector>
+#include <atomic>
 #include <thread>
 
 #include <geometry_msgs/PolygonStamped.h>
 #include <geometry_msgs/PoseStamped.h>
+#include <map_msgs/OccupancyGridUpdate.h>
+#include <diagnostic_msgs/DiagnosticArray.h>
 #include "map_common.h"
 #include "footprint.h"
 #include "layer.h"
@@ -65,7 +68,9 @@
 #include "costmap_layer.h"
 #include "static_layer.h"
 #include "obstacle_layer.h"
+#include "voxel_layer.h"
 #include "inflation_layer.h"
+#include "shared_costmap.h"
 
 namespace roborts_costmap {
 
@@ -91,6 +96,17 @@ class CostmapInterface {
    * @param map_update_frequency The frequency to update costmap
    */
   CostmapInterface(std::string map_name, tf::TransformListener& tf, std::string config_file);
+  /**
+   * @brief Constructor of an offline costmap of a fixed map, built from the static and inflation layers of the
+   *        config without tf, ROS master, the update thread or publishers, for tools such as benchmarks. The map is
+   *        updated once on construction and there is no robot pose.
+   * @param map_name The costmap name
+   * @param config_file The costmap config, its obstacle layer is left out
+   * @param map The map of the static layer
+   * @param has_inflation_layer Whether to inflate the map
+   */
+  CostmapInterface(std::string map_name, std::string config_file, const nav_msgs::OccupancyGridConstPtr& map,
+                   bool has_inflation_layer = true);
   ~CostmapInterface();
   /**
    * @brief Start the costmap processing.
@@ -136,6 +152,40 @@ class CostmapInterface {
   Costmap2D* GetCostMap() const {
     return layered_costmap_->GetCostMap();
   }
+  /**
+   * @brief Get an immutable copy of the costmap as of its last update, which can be read without locking.
+   * @return The costmap snapshot, null until the costmap has been updated once.
+   */
+  std::shared_ptr<const Costmap2D> GetCostMapSnapshot() const {
+    return layered_costmap_->GetSnapshot();
+  }
+  /**
+   * @brief Get the latest costmap snapshot and the cells which changed since an older snapshot.
+   * @param since_sequence Sequence number of the snapshot the caller already has, 0 if none.
+   * @param changes Output sequence number of the returned snapshot and bounds of the changed cells.
+   * @return The costmap snapshot, null until the costmap has been updated once.
+   */
+  std::shared_ptr<const Costmap2D> GetCostMapSnapshot(uint64_t since_sequence, SnapshotChanges &changes) const {
+    return layered_costmap_->GetSnapshot(since_sequence, changes);
+  }
+  /**
+   * @brief Get the hash of the static map the costmap is built on, to check data derived from the static map.
+   * @return The hash, 0 if there is no static layer or it holds no map yet.
+   */
+  uint64_t GetStaticMapHash() const;
+  /**
+   * @brief Get the costs the static map alone gives the costmap: the static layer, inflated the way the inflation
+   *        layer inflates it, without the obstacles of the live layers. Data derived from these costs stays valid
+   *        as long as GetStaticCostMapHash() does not change.
+   * @param costmap Receives the costs, resized to the geometry of the static map
+   * @return False if there is no static layer holding a map of the geometry of the costmap, as in a rolling window
+   */
+  bool GetStaticCostMap(Costmap2D &costmap) const;
+  /**
+   * @brief Get the hash of the static map together with the inflation GetStaticCostMap() applies to it.
+   * @return The hash, 0 if there is no static layer or it holds no map yet.
+   */
+  uint64_t GetStaticCostMapHash() const;
   /**
    * @brief Get robot pose with time stamped.
    * @param global_pose
@@ -234,22 +284,54 @@ class CostmapInterface {
   std::vector<geometry_msgs::Point> footprint_points_;
   CostmapLayers* layered_costmap_;
   std::string name_, config_file_, config_file_inflation_;
-  tf::TransformListener& tf_;
+  //! Null for an offline costmap
+  tf::TransformListener* tf_;
   std::string global_frame_, robot_base_frame_;
   double transform_tolerance_, dist_behind_robot_threshold_to_care_obstacles_;
   nav_msgs::OccupancyGrid grid_;
+  map_msgs::OccupancyGridUpdate grid_update_;
   char* cost_translation_table_ = new char[256];
 
-  ros::Publisher costmap_pub_;
+  ros::Publisher costmap_pub_, costmap_update_pub_, diagnostics_pub_;
 
  private:
   void DetectMovement(const ros::TimerEvent &event);
   void MapUpdateLoop(double frequency);
+  /**
+   * @brief Publish the latest costmap snapshot, as a full map when a subscriber connected, the map geometry
+   *        changed or the keyframe period passed, otherwise as an update of the bounds changed by the last update.
+   */
+  void PublishMap();
+  /**
+   * @brief Request a full map for a newly connected costmap subscriber.
+   */
+  void OnMapSubscribe(const ros::SingleSubscriberPublisher &pub);
+  /**
+   * @brief Publish the layer timing and update bounds telemetry on /diagnostics, once per diagnostics period.
+   */
+  void PublishDiagnostics();
+  //! Period of the diagnostics, non positive for no diagnostics
+  double diagnostics_period_;
+  ros::Time last_diagnostics_;
+  diagnostic_msgs::DiagnosticArray diagnostics_;
+  //! Set when the next publish has to be a full map
+  std::atomic<bool> publish_full_map_;
+  //! Period of full map keyframes, non positive for no keyframes
+  double map_keyframe_period_;
+  ros::Time last_keyframe_;
+  //! Name of the shared memory region the costmap is served through or read from, empty for neither
+  std::string shared_costmap_name_;
+  //! Read the costmap from the server of shared_costmap_name_ instead of running the layers
+  bool is_shared_costmap_client_;
+  std::unique_ptr<SharedCostmapServer> shared_costmap_server_;
+  std::unique_ptr<SharedCostmapClient> shared_costmap_client_;
   std::vector<geometry_msgs::Point> unpadded_footprint_, padded_footprint_;
   float footprint_padding_;
   bool map_update_thread_shutdown_, stop_updates_, initialized_, stopped_, robot_stopped_, got_footprint_, is_debug_, \
-       is_track_unknown_, is_rolling_window_, has_static_layer_, has_obstacle_layer_;
+       is_track_unknown_, is_rolling_window_, has_static_layer_, has_obstacle_layer_, has_voxel_layer_, \
+       has_max_pyramid_;
   double map_update_frequency_, map_width_, map_height_, map_origin_x_, map_origin_y_, map_resolution_;
+  unsigned int update_thread_num_, update_tile_size_;
   std::thread* map_update_thread_;
   ros::Timer timer_;
   ros::Time last_publish_;
@@ -0,0 +1,80 @@
+/****************************************************************************
+ *  Copyright (C) 2019 RoboMaster.
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program. If not, see <http://www.gnu.org/licenses/>.
+ ***************************************************************************/
+
+#ifndef ROBORTS_COSTMAP_COSTMAP_SIMD_H
+#define ROBORTS_COSTMAP_COSTMAP_SIMD_H
+
+#include <cstddef>
+
+namespace roborts_costmap {
+
+/**
+ * @brief Row kernels combining a layer into the master grid or translating it. Every kernel processes num
+ *        cells of one row, the best instruction set (AVX2, SSE2, NEON or plain C++) is chosen once at runtime.
+ */
+namespace simd {
+
+/**
+ * @brief master = layer for every cell.
+ */
+void MergeRowByAll(unsigned char *master, const unsigned char *layer, size_t num);
+
+/**
+ * @brief master = layer for every cell the layer knows, NO_INFORMATION cells of the layer are skipped.
+ */
+void MergeRowByValid(unsigned char *master, const unsigned char *layer, size_t num);
+
+/**
+ * @brief master = max(master, layer), NO_INFORMATION in the master is always overwritten and
+ *        NO_INFORMATION in the layer never is.
+ */
+void MergeRowByMax(unsigned char *master, const unsigned char *layer, size_t num);
+
+/**
+ * @brief master = min(master + layer, INSCRIBED_INFLATED_OBSTACLE - 1), with the same unknown cell rule as
+ *        MergeRowByMax.
+ */
+void MergeRowByAdd(unsigned char *master, const unsigned char *layer, size_t num);
+
+/**
+ * @brief out = table[in] for every cell, used to translate costs into occupancy grid values.
+ * @param table Lookup table with 256 entries
+ */
+void TranslateRow(const unsigned char *table, const unsigned char *in, unsigned char *out, size_t num);
+
+//! DecayRow() result flags
+const unsigned int kDecayExpired = 1;
+const unsigned int kDecayAlive = 2;
+
+/**
+ * @brief Age a row of cells, ttl = max(ttl - ticks, 0), and set cost = cleared_cost for every cell whose ttl
+ *        reaches 0 in this call.
+ * @return kDecayExpired if a cell expired, or-ed with kDecayAlive if a cell is still alive
+ */
+unsigned int DecayRow(unsigned char *ttl, unsigned char *cost, size_t num, unsigned char ticks,
+                      unsigned char cleared_cost);
+
+/**
+ * @brief Get the name of the instruction set the kernels run on.
+ * @return "avx2", "sse2", "neon" or "scalar"
+ */
+const char *InstructionSet();
+
+} //namespace simd
+} //namespace roborts_costmap
+
+#endif //ROBORTS_COSTMAP_COSTMAP_SIMD_H
@@ -0,0 +1,134 @@
+/****************************************************************************
+ *  Copyright (C) 2019 RoboMaster.
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program. If not, see <http://www.gnu.org/licenses/>.
+ ***************************************************************************/
+
+#ifndef ROBORTS_COSTMAP_COSTMAP_TELEMETRY_H
+#define ROBORTS_COSTMAP_COSTMAP_TELEMETRY_H
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstdint>
+#include <numeric>
+#include <string>
+#include <vector>
+
+namespace roborts_costmap {
+
+/**
+ * @brief Histogram of the last samples of a series, with power of two bins: bin i counts the samples in
+ *        [2^(i-1), 2^i), bin 0 the ones below 1, and their mean. Adding a sample is amortized constant time.
+ */
+class RollingHistogram {
+ public:
+  static const int kBinNum = 32;
+
+  explicit RollingHistogram(size_t window_size = 256) :
+      window_(window_size), next_(0), sample_num_(0), sum_(0), bins_() {}
+
+  void Add(double value) {
+    if (sample_num_ == window_.size()) {
+      --bins_[Bin(window_[next_])];
+      sum_ -= window_[next_];
+    } else {
+      ++sample_num_;
+    }
+    window_[next_] = value;
+    ++bins_[Bin(value)];
+    sum_ += value;
+    next_ = (next_ + 1) % window_.size();
+    if (next_ == 0) {
+      // sum the window again once per round, so the rounding errors of the subtractions do not add up
+      sum_ = std::accumulate(window_.begin(), window_.end(), 0.0);
+    }
+  }
+
+  const std::array<uint32_t, kBinNum> &GetBins() const {
+    return bins_;
+  }
+
+  size_t GetSampleNum() const {
+    return sample_num_;
+  }
+
+  /**
+   * @brief Mean of the samples in the window, 0 if there is none.
+   */
+  double GetMean() const {
+    return sample_num_ > 0 ? sum_ / sample_num_ : 0;
+  }
+
+  /**
+   * @brief Upper bound of the given percentile of the samples in the window, the upper edge of its bin.
+   * @param percentile In [0, 1]
+   */
+  double GetPercentile(double percentile) const {
+    size_t rank = static_cast<size_t>(std::ceil(percentile * sample_num_)), count = 0;
+    for (int bin = 0; bin < kBinNum; ++bin) {
+      count += bins_[bin];
+      if (count >= rank && count > 0) {
+        return std::ldexp(1.0, bin);
+      }
+    }
+    return 0;
+  }
+
+ private:
+  static uint8_t Bin(double value) {
+    if (!(value >= 1)) {
+      return 0;
+    }
+    int exponent;
+    std::frexp(value, &exponent);
+    return static_cast<uint8_t>(std::min(exponent, kBinNum - 1));
+  }
+
+  //! Samples in the window, a ring ending before next_
+  std::vector<double> window_;
+  size_t next_, sample_num_;
+  //! Sum of the samples in the window
+  double sum_;
+  std::array<uint32_t, kBinNum> bins_;
+};
+
+/**
+ * @brief Timing of one layer in CostmapLayers::UpdateMap(), times in us.
+ */
+struct LayerTelemetry {
+  std::string name;
+  //! Times of the last update
+  double bounds_time = 0, costs_time = 0;
+  //! Times summed over all updates
+  double total_bounds_time = 0, total_costs_time = 0;
+  //! UpdateBounds plus UpdateCosts time of the last updates
+  RollingHistogram time_histogram;
+};
+
+/**
+ * @brief Timing and update bounds statistics of a layered costmap, times in us and areas in cells.
+ */
+struct CostmapTelemetry {
+  uint64_t update_num = 0;
+  //! Time of the last update and summed over all updates
+  double update_time = 0, total_update_time = 0;
+  //! Area of the combined update bounds of the last update and summed over all updates
+  uint64_t bounds_area = 0, total_bounds_area = 0;
+  RollingHistogram update_time_histogram, bounds_area_histogram;
+  std::vector<LayerTelemetry> layers;
+};
+
+} //namespace roborts_costmap
+#endif //ROBORTS_COSTMAP_COSTMAP_TELEMETRY_H
@@ -94,6 +94,13 @@ class InflationLayer : public Layer {
   virtual void UpdateBounds(double robot_x, double robot_y, double robot_yaw, double *min_x, double *min_y,
                             double *max_x, double *max_y);
   virtual void UpdateCosts(Costmap2D &master_grid, int min_i, int min_j, int max_i, int max_j);
+  virtual bool IsTileParallel() const {
+    return true;
+  }
+  virtual void PrepareTiles(Costmap2D &master_grid, int min_i, int min_j, int max_i, int max_j,
+                            unsigned int thread_num);
+  virtual void UpdateCostsTile(Costmap2D &master_grid, int min_i, int min_j, int max_i, int max_j,
+                               unsigned int thread_index);
   virtual bool IsDiscretized() {
     return true;
   }
@@ -119,6 +126,13 @@ class InflationLayer : public Layer {
     return cost;
   }
 
+  /**
+   * @brief Get the distance up to which obstacles are inflated, in cells.
+   */
+  unsigned int GetCellInflationRadius() const {
+    return cell_inflation_radius_;
+  }
+
   /**
    * @brief Change the values of the inflation radius parameters
    * @param inflation_radius The new inflation radius
@@ -126,6 +140,18 @@ class InflationLayer : public Layer {
    */
   void SetInflationParameters(double inflation_radius, double cost_scaling_factor);
 
+  /**
+   * @brief Inflate a whole costmap of the geometry of the master the way UpdateCosts() inflates the master.
+   * @param costmap The costmap to inflate in place
+   */
+  void InflateMap(Costmap2D &costmap);
+
+  /**
+   * @brief Hash the costs the inflation gives by distance, which cover its radii, scaling and unknown handling.
+   * @param hash Hash to continue
+   */
+  uint64_t HashCosts(uint64_t hash) const;
+
  protected:
   virtual void OnFootprintChanged();
   std::recursive_mutex *inflation_access_;
@@ -170,6 +196,16 @@ class InflationLayer : public Layer {
   inline void Enqueue(unsigned int index, unsigned int mx, unsigned int my,
                       unsigned int src_x, unsigned int src_y);
 
+  /**
+   * @brief Scratch memory of one thread inflating tiles, kept between updates
+   */
+  struct TileScratch {
+    //! Visited cells of the tile window
+    std::vector<unsigned char> seen;
+    //! Cells pending for inflation by distance, the bins are emptied but kept after every tile
+    std::map<double, std::vector<CellData> > inflation_cells;
+  };
+
   double inflation_radius_, inscribed_radius_, weight_;
   bool inflate_unknown_;
   unsigned int cell_inflation_radius_;
@@ -186,6 +222,14 @@ class InflationLayer : public Layer {
   double last_min_x_, last_min_y_, last_max_x_, last_max_y_;
 
   bool need_reinflation_;
+
+  //! Lethal cells of the current tiled update boundary grown by the inflation radius, in row major order
+  std::vector<CellData> tile_seeds_;
+  //! Index of the first seed of every row of the grown boundary, plus the end index
+  std::vector<unsigned int> tile_seed_rows_;
+  //! First row of the grown boundary
+  int tile_seed_y0_;
+  std::vector<TileScratch> tile_scratch_;
 };
 
 } //namespace roborts_costmap
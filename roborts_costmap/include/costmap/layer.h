@@ -73,7 +73,8 @@ class Layer {
  * @brief initialize
  * @param parent the layered costmap, ie master grid
  * @param name this layer name
- * @param tf a tf listener providing transforms
+ * @param tf a tf listener providing transforms, null to run offline: the layer then subscribes to nothing and
+ *        is fed through its own methods, e.g. StaticLayer::SetMap() and ObstacleLayer::AddObservation()
  */
   void Initialize(CostmapLayers *parent, std::string name, tf::TransformListener *tf);
 
@@ -103,6 +104,42 @@ class Layer {
  */
   virtual void UpdateCosts(Costmap2D &master_grid, int min_i, int min_j, int max_i, int max_j) {}
 
+/**
+ * @brief Whether this layer can update the master map on disjoint tiles of the update boundary at the same time.
+ *        A layer returning true implements PrepareTiles() and UpdateCostsTile(), which then replace UpdateCosts()
+ *        when the costmap is updated by several threads.
+ * @return True if the layer supports tile parallel updates.
+ */
+  virtual bool IsTileParallel() const {
+    return false;
+  }
+
+/**
+ * @brief Called once on the update thread before the tiles of an update are dispatched, to do the serial part
+ *        of the layer update.
+ * @param master_grid the master map
+ * @param min_i
+ * @param min_j
+ * @param max_i
+ * @param max_j the whole update boundary
+ * @param thread_num the number of threads that will call UpdateCostsTile()
+ */
+  virtual void PrepareTiles(Costmap2D &master_grid, int min_i, int min_j, int max_i, int max_j,
+                            unsigned int thread_num) {}
+
+/**
+ * @brief Update the master map inside one tile of the update boundary. Tiles run concurrently, so only the
+ *        cells inside the tile may be written.
+ * @param master_grid the master map
+ * @param min_i
+ * @param min_j
+ * @param max_i
+ * @param max_j the tile boundary
+ * @param thread_index index of the calling thread in [0, thread_num), for per-thread scratch memory
+ */
+  virtual void UpdateCostsTile(Costmap2D &master_grid, int min_i, int min_j, int max_i, int max_j,
+                               unsigned int thread_index) {}
+
   /**
    * @brief Stop.
    */
@@ -52,21 +52,47 @@
 #ifndef ROBORTS_COSTMAP_COSTMAPLAYERS_H
 #define ROBORTS_COSTMAP_COSTMAPLAYERS_H
 
+#include <chrono>
+#include <deque>
+#include <memory>
+#include <mutex>
 #include <geometry_msgs/Point.h>
+#include "thread_pool/thread_pool.h"
 #include "map_common.h"
 #include "layer.h"
 #include "costmap_2d.h"
+#include "shared_costmap.h"
+#include "costmap_telemetry.h"
 #include "footprint.h"
 
 namespace roborts_costmap {
 
 class Layer;
 
+/**
+ * @brief The cells which changed between a snapshot a reader already has and the latest one.
+ */
+struct SnapshotChanges {
+  //! Sequence number of the latest snapshot, counting every update from 1
+  uint64_t sequence = 0;
+  //! Whether every changed cell is inside the bounds, false if the map moved, was resized or was reset in between
+  //! or the older snapshot is no longer in the history
+  bool is_bounded = false;
+  //! Changed cells are in [x0, xn) x [y0, yn), an empty range if nothing changed
+  unsigned int x0 = 0, y0 = 0, xn = 0, yn = 0;
+};
+
 class CostmapLayers {
  public:
   CostmapLayers(std::string global_frame, bool rolling_window, bool track_unknown);
   ~CostmapLayers();
   void UpdateMap(double robot_x, double robot_y, double robot_yaw);
+  /**
+   * @brief Take the master map from a costmap server instead of computing it with the layers.
+   * @param client The client of the server's shared costmap
+   * @return True if a new map was read
+   */
+  bool UpdateMapFromShared(SharedCostmapClient &client);
 
   const std::vector<geometry_msgs::Point>& GetFootprint() {
     return footprint_;
@@ -95,6 +121,43 @@ class CostmapLayers {
     return &costmap_;
   }
 
+  /**
+   * @brief Get the master map as it was after the last update. The snapshot is immutable and stays valid as long
+   *        as the caller holds it, so it can be read without the costmap lock while the map keeps updating.
+   * @return The latest snapshot, null before the first update.
+   */
+  std::shared_ptr<const Costmap2D> GetSnapshot() const {
+    return std::atomic_load(&snapshot_);
+  }
+
+  /**
+   * @brief Get the latest snapshot together with the cells which changed since an older one, so that a reader
+   *        can repair its own state from the difference instead of processing the whole map again.
+   * @param since_sequence Sequence number of the snapshot the reader already has, 0 if none
+   * @param changes Output sequence number of the returned snapshot and the bounds of the changed cells
+   * @return The latest snapshot, null before the first update.
+   */
+  std::shared_ptr<const Costmap2D> GetSnapshot(uint64_t since_sequence, SnapshotChanges &changes) const;
+
+  /**
+   * @brief Get the hash of the static map the costmap is built on, to check data derived from the static map.
+   * @return The hash, 0 if there is no static layer or it holds no map yet.
+   */
+  uint64_t GetStaticMapHash() const;
+  /**
+   * @brief Get the costs the static map alone gives the costmap: the static layer, inflated by the inflation layer,
+   *        without the obstacles of the live layers. Data derived from these costs stays valid as long as
+   *        GetStaticCostMapHash() does not change.
+   * @param costmap Receives the costs, resized to the geometry of the static map
+   * @return False if there is no static layer holding a map of the geometry of the costmap, as in a rolling window
+   */
+  bool GetStaticCostMap(Costmap2D &costmap);
+  /**
+   * @brief Get the hash of the static map together with the inflation GetStaticCostMap() applies to it.
+   * @return The hash, 0 if there is no static layer or it holds no map yet.
+   */
+  uint64_t GetStaticCostMapHash() const;
+
   void GetUpdatedBounds(double& minx, double& miny, double& maxx, double& maxy) {
     minx = minx_;
     miny = miny_;
@@ -164,6 +227,37 @@ class CostmapLayers {
     return file_path_;
   }
 
+  /**
+   * @brief Set the number of threads running the UpdateCosts step of tile parallel layers.
+   * @param thread_num Thread number including the update thread, 1 means updating every layer serially.
+   * @param tile_size Edge length of the square tiles the update boundary is split into, in cells.
+   */
+  void SetUpdateThreadNum(unsigned int thread_num, unsigned int tile_size);
+
+  /**
+   * @brief Keep a max cost pyramid of the master map, updated over the bounds of every update and shared by
+   *        the snapshots, for region and footprint queries.
+   * @param enabled Whether to keep the pyramid
+   */
+  void SetMaxPyramidEnabled(bool enabled);
+
+  /**
+   * @brief Report the next snapshot as changed everywhere, after the master map was changed outside of the update
+   *        bounds, e.g. reset. Called with the costmap lock held.
+   */
+  void MarkMapReset() {
+    is_map_reset_ = true;
+  }
+
+  /**
+   * @brief Get the timing of every layer and the update bounds statistics of the updates so far.
+   * @return A copy of the telemetry, consistent as of the last finished update.
+   */
+  CostmapTelemetry GetTelemetry() const {
+    std::lock_guard<std::mutex> lock(telemetry_mutex_);
+    return telemetry_;
+  }
+
  private:
   std::string global_frame_id_, file_path_;
   std::vector<geometry_msgs::Point> footprint_;
@@ -172,6 +266,55 @@ class CostmapLayers {
   double  minx_, miny_, maxx_, maxy_, circumscribed_radius_, inscribed_radius_;
   unsigned int bx0_, bxn_, by0_, byn_;
   std::vector<Layer*> plugins_;
+  //! Threads updating the tiles of tile parallel layers, null when updating serially
+  std::unique_ptr<roborts_common::ThreadPool> update_pool_;
+  //! Tile edge length in cells
+  int tile_size_;
+  //! Tiles of the current update boundary, (min_i, min_j, max_i, max_j) for each tile
+  std::vector<int> tiles_;
+
+  /**
+   * @brief Copy the master map into a snapshot buffer and publish it, called with the costmap lock held.
+   */
+  void PublishSnapshot();
+  //! Latest published snapshot, only accessed through std::atomic_load and std::atomic_store
+  std::shared_ptr<const Costmap2D> snapshot_;
+  //! Buffer behind snapshot_ and the one published before it, reused once no reader holds it any more
+  std::shared_ptr<Costmap2D> published_buffer_, spare_buffer_;
+
+  /**
+   * @brief Update bounds and map geometry of a published snapshot.
+   */
+  struct SnapshotRecord {
+    uint64_t sequence;
+    unsigned int x0, y0, xn, yn;
+    unsigned int size_x, size_y;
+    double resolution, origin_x, origin_y;
+    //! Whether the master map was reset before the update, so that the bounds do not cover the changes
+    bool is_map_reset;
+  };
+  //! Number of snapshots GetSnapshot can report the changes since
+  static const size_t kSnapshotHistorySize = 32;
+  //! Records of the latest snapshots, oldest first
+  std::deque<SnapshotRecord> snapshot_history_;
+  //! Sequence number of snapshot_
+  uint64_t snapshot_sequence_;
+  //! Whether the master map was reset since the last snapshot, guarded by the costmap lock
+  bool is_map_reset_;
+  //! Keeps snapshot_, snapshot_sequence_ and snapshot_history_ consistent for GetSnapshot with changes
+  mutable std::mutex snapshot_mutex_;
+
+  typedef std::chrono::steady_clock TelemetryClock;
+  static double ElapsedMicroseconds(TelemetryClock::time_point start);
+  /**
+   * @brief Add the update that started at update_start and the layer times of layer_times_ to the telemetry.
+   */
+  void RecordTelemetry(TelemetryClock::time_point update_start, uint64_t bounds_area);
+  //! UpdateBounds and UpdateCosts time of every layer in the current update, in us
+  std::vector<double> layer_times_;
+  CostmapTelemetry telemetry_;
+  //! Guards telemetry_, which is read by other threads than the update thread
+  mutable std::mutex telemetry_mutex_;
 };
 
 } //namespace roborts_costmap
@@ -53,7 +53,13 @@
 #ifndef ROBORTS_COSTMAP_MAP_COMMON_H
 #define ROBORTS_COSTMAP_MAP_COMMON_H
 
+#include <unistd.h>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <initializer_list>
 #include <string>
+#include <utility>
 #include <iostream>
 #include <algorithm>
 #include <memory>
@@ -67,6 +73,52 @@ static const unsigned char NO_INFORMATION = 255;
 static const unsigned char LETHAL_OBSTACLE = 254;
 static const unsigned char INSCRIBED_INFLATED_OBSTACLE = 253;
 static const unsigned char FREE_SPACE = 0;
+
+/**
+ * @brief 64 bit FNV-1a hash, used to tell whether maps and map derived data on disk are still current.
+ * @param data Bytes to hash
+ * @param size Number of bytes
+ * @param hash Hash of the preceding data when hashing in several pieces
+ * @return The hash
+ */
+inline uint64_t HashBytes(const void *data, size_t size, uint64_t hash = 14695981039346656037ULL) {
+  const unsigned char *bytes = static_cast<const unsigned char *>(data);
+  for (size_t i = 0; i < size; ++i) {
+    hash = (hash ^ bytes[i]) * 1099511628211ULL;
+  }
+  return hash;
+}
+
+/**
+ * @brief Write a file from several pieces of memory through a temporary file which is renamed to the path, so that
+ *        readers of map derived data on disk never load a partly written file.
+ * @param path Path of the file
+ * @param pieces Start and number of bytes of every piece, written in order
+ * @return True if the file was written
+ */
+inline bool WriteFileAtomically(const std::string &path,
+                                std::initializer_list<std::pair<const void *, size_t>> pieces) {
+  std::string temp_path = path + ".XXXXXX";
+  int fd = mkstemp(&temp_path[0]);
+  if (fd < 0) {
+    return false;
+  }
+  FILE *file = fdopen(fd, "wb");
+  bool written = file != nullptr;
+  for (auto piece = pieces.begin(); written && piece != pieces.end(); ++piece) {
+    written = fwrite(piece->first, 1, piece->second, file) == piece->second;
+  }
+  if (file != nullptr) {
+    written = fclose(file) == 0 && written;
+  } else {
+    close(fd);
+  }
+  if (!written || rename(temp_path.c_str(), path.c_str()) != 0) {
+    unlink(temp_path.c_str());
+    return false;
+  }
+  return true;
+}
 } //namespace roborts_costmap
 
 #endif //ROBORTS_COSTMAP_MAP_COMMON_H
@@ -0,0 +1,115 @@
+/****************************************************************************
+ *  Copyright (C) 2019 RoboMaster.
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program. If not, see <http://www.gnu.org/licenses/>.
+ ***************************************************************************/
+
+#ifndef ROBORTS_COSTMAP_MAP_LOADER_H
+#define ROBORTS_COSTMAP_MAP_LOADER_H
+
+#include <algorithm>
+#include <cstdio>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include <nav_msgs/OccupancyGrid.h>
+
+namespace roborts_costmap {
+
+/**
+ * @brief Load a map_server map, a yaml file and its pgm image, the way map_server interprets it in trinary mode.
+ *        Used by the offline benchmarks, which run without map_server.
+ * @param yaml_path Path of the yaml file
+ * @param upsample Number of cells every image pixel is split into along each axis
+ * @param map Output occupancy grid
+ * @return True if the map was loaded
+ */
+inline bool LoadMap(const std::string &yaml_path, int upsample, nav_msgs::OccupancyGrid &map) {
+  std::ifstream yaml(yaml_path);
+  if (!yaml) {
+    fprintf(stderr, "Can not open the map %s\n", yaml_path.c_str());
+    return false;
+  }
+  std::string line, image;
+  double resolution = 0.05, origin_x = 0, origin_y = 0, occupied_thresh = 0.65, free_thresh = 0.196;
+  int negate = 0;
+  while (std::getline(yaml, line)) {
+    std::string key = line.substr(0, line.find(':'));
+    std::string value = line.find(':') == std::string::npos ? "" : line.substr(line.find(':') + 1);
+    std::replace(value.begin(), value.end(), '[', ' ');
+    std::replace(value.begin(), value.end(), ']', ' ');
+    std::replace(value.begin(), value.end(), ',', ' ');
+    std::istringstream stream(value);
+    if (key == "image") {
+      stream >> image;
+    } else if (key == "resolution") {
+      stream >> resolution;
+    } else if (key == "origin") {
+      stream >> origin_x >> origin_y;
+    } else if (key == "negate") {
+      stream >> negate;
+    } else if (key == "occupied_thresh") {
+      stream >> occupied_thresh;
+    } else if (key == "free_thresh") {
+      stream >> free_thresh;
+    }
+  }
+
+  std::string image_path = image[0] == '/' ? image : yaml_path.substr(0, yaml_path.rfind('/') + 1) + image;
+  std::ifstream pgm(image_path, std::ios::binary);
+  std::string magic;
+  int width = 0, height = 0, max_value = 0;
+  pgm >> magic;
+  // skip comments between the header fields
+  auto read_field = [&pgm](int &field) {
+    while (pgm >> std::ws && pgm.peek() == '#') {
+      pgm.ignore(4096, '\n');
+    }
+    pgm >> field;
+  };
+  read_field(width);
+  read_field(height);
+  read_field(max_value);
+  pgm.get();
+  if (magic != "P5" || width <= 0 || height <= 0 || max_value <= 0 || max_value > 255) {
+    fprintf(stderr, "Can not read the map image %s\n", image_path.c_str());
+    return false;
+  }
+  std::vector<unsigned char> pixels(width * height);
+  pgm.read(reinterpret_cast<char *>(pixels.data()), pixels.size());
+
+  map.header.frame_id = "map";
+  map.info.resolution = resolution / upsample;
+  map.info.width = width * upsample;
+  map.info.height = height * upsample;
+  map.info.origin.position.x = origin_x;
+  map.info.origin.position.y = origin_y;
+  map.info.origin.orientation.w = 1.0;
+  map.data.resize(map.info.width * map.info.height);
+  for (unsigned int j = 0; j < map.info.height; ++j) {
+    for (unsigned int i = 0; i < map.info.width; ++i) {
+      // the image starts with the top row of the map
+      double value = pixels[(height - 1 - j / upsample) * width + i / upsample];
+      double occupancy = negate ? value / max_value : (max_value - value) / max_value;
+      map.data[j * map.info.width + i] = occupancy > occupied_thresh ? 100 : occupancy < free_thresh ? 0 : -1;
+    }
+  }
+  return true;
+}
+
+} //namespace roborts_costmap
+
+#endif //ROBORTS_COSTMAP_MAP_LOADER_H
@@ -51,6 +51,7 @@
  *********************************************************************/
 #ifndef ROBORTS_COSTMAP_OBSERVATION_H
 #define ROBORTS_COSTMAP_OBSERVATION_H
+#include <memory>
 #include <geometry_msgs/Point.h>
 #include <pcl/point_types.h>
 #include <pcl/point_cloud.h>
@@ -58,7 +59,8 @@
 namespace roborts_costmap {
 
 /**
- * @brief Stores an observation in terms of a point cloud and the origin of the source
+ * @brief Stores an observation in terms of a point cloud and the origin of the source. Copies share the
+ *        cloud, which is never modified once the observation is buffered.
  *
  */
 class Observation
@@ -74,7 +76,6 @@ class Observation
 
   virtual ~Observation()
   {
-    delete cloud_;
   }
 
   /**
@@ -91,16 +92,6 @@ class Observation
   {
   }
 
-  /**
-   * @brief  Copy constructor
-   * @param  obs The observation to copy
-   */
-  Observation(const Observation& obs) :
-      origin_(obs.origin_), cloud_(new pcl::PointCloud<pcl::PointXYZ>(*(obs.cloud_))),
-      obstacle_range_(obs.obstacle_range_), raytrace_range_(obs.raytrace_range_)
-  {
-  }
-
   /**
    * @brief  Creates an observation from a point cloud
    * @param  cloud The point cloud of the observation
@@ -112,7 +103,7 @@ class Observation
   }
 
   geometry_msgs::Point origin_;
-  pcl::PointCloud<pcl::PointXYZ>* cloud_;
+  std::shared_ptr<const pcl::PointCloud<pcl::PointXYZ> > cloud_;
   double obstacle_range_, raytrace_range_;
 };
 
@@ -53,7 +53,6 @@
 #define ROBORTS_COSTMAP_OBSERVATION_BUFFER_H
 
 #include <vector>
-#include <list>
 #include <string>
 #include <mutex>
 #include <ros/time.h>
@@ -79,14 +78,14 @@ class ObservationBuffer {
    * @param  max_obstacle_height The minimum height of a hitpoint to be considered legal
    * @param  obstacle_range The range to which the sensor should be trusted for inserting obstacles
    * @param  raytrace_range The range to which the sensor should be trusted for raytracing to clear out space
-   * @param  tf A reference to a TransformListener
+   * @param  tf A TransformListener, null for a buffer that only takes clouds already in the global frame
    * @param  global_frame The frame to transform PointClouds into
    * @param  sensor_frame The frame of the origin of the sensor, can be left blank to be read from the messages
    * @param  tf_tolerance The amount of time to wait for a transform to be available when setting a new global frame
    */
   ObservationBuffer(std::string topic_name, double observation_keep_time, double expected_update_rate,
                     double min_obstacle_height, double max_obstacle_height, double obstacle_range,
-                    double raytrace_range, tf::TransformListener &tf, std::string global_frame,
+                    double raytrace_range, tf::TransformListener *tf, std::string global_frame,
                     std::string sensor_frame, double tf_tolerance);
 
   /**
@@ -110,14 +109,22 @@ class ObservationBuffer {
   void BufferCloud(const sensor_msgs::PointCloud2 &cloud);
 
   /**
-   * @brief  Transforms a PointCloud to the global frame and buffers it
-   * <b>Note: The burden is on the user to make sure the transform is available... ie they should use a MessageNotifier</b>
+   * @brief  Queues a PointCloud and buffers it as soon as its transform to the global frame is available.
+   *         Never waits for tf, clouds whose transform is still missing after tf_tolerance are dropped.
    * @param  cloud The cloud to be buffered
    */
   void BufferCloud(const pcl::PointCloud<pcl::PointXYZ> &cloud);
 
   /**
-   * @brief  Pushes copies of all current observations onto the end of the vector passed in
+   * @brief  Buffers a cloud that is already in the global frame, e.g. one replayed without tf.
+   * @param  origin The sensor origin in the global frame
+   * @param  global_cloud The cloud in the global frame
+   */
+  void BufferGlobalCloud(const geometry_msgs::Point &origin, const pcl::PointCloud<pcl::PointXYZ> &global_cloud);
+
+  /**
+   * @brief  Pushes all current observations onto the end of the vector passed in. The observations share their
+   *         clouds with the buffer, so no point is copied.
    * @param  observations The vector to be filled
    */
   void GetObservations(std::vector<Observation> &observations);
@@ -149,17 +156,44 @@ class ObservationBuffer {
 
  private:
   /**
-   * @brief  Removes any stale observations from the buffer list
+   * @brief  Removes any stale observations from the buffer ring
    */
   void PurgeStaleObservations();
 
-  tf::TransformListener &tf_;
+  /**
+   * @brief  Buffers the queued clouds, oldest first, until one whose transform is not available yet.
+   */
+  void TransformPendingClouds();
+
+  /**
+   * @brief  Transforms a cloud to the global frame and buffers it as the newest observation.
+   * @param  cloud The cloud in its sensor frame
+   * @return False if the transform is not available yet, true once the cloud is buffered or dropped
+   */
+  bool TransformCloud(const pcl::PointCloud<pcl::PointXYZ> &cloud);
+
+  /**
+   * @brief  Makes room for a new observation at the newest end of the ring.
+   * @return The slot of the new observation, whose cloud may be reused if no reader holds it
+   */
+  Observation &PushObservation();
+
+  tf::TransformListener *tf_;
   const ros::Duration observation_keep_time_;
   const ros::Duration expected_update_rate_;
   ros::Time last_updated_;
   std::string global_frame_;
   std::string sensor_frame_;
-  std::list<Observation> observation_list_;
+  //! Ring of observations, oldest first, starting at observation_begin_
+  std::vector<Observation> observations_;
+  size_t observation_begin_, observation_count_;
+  //! Ring of clouds waiting for their transform, oldest first, starting at pending_begin_
+  std::vector<pcl::PointCloud<pcl::PointXYZ> > pending_clouds_;
+  size_t pending_begin_, pending_count_;
+  //! Scratch cloud in the global frame before the height filter
+  pcl::PointCloud<pcl::PointXYZ> transformed_cloud_;
+  //! Number of clouds that can wait for their transform at the same time
+  static const size_t kPendingCapacity = 8;
   std::string topic_name_;
   double min_obstacle_height_, max_obstacle_height_;
   std::recursive_mutex lock_;
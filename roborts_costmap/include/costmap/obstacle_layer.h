@@ -62,6 +62,7 @@
 #include <sensor_msgs/point_cloud_conversion.h>
 #include <tf/message_filter.h>
 #include <message_filters/subscriber.h>
+#include "thread_pool/thread_pool.h"
 #include "footprint.h"
 #include "map_common.h"
 #include "costmap_layer.h"
@@ -83,12 +84,30 @@ class ObstacleLayer : public CostmapLayer {
   virtual void Deactivate();
   virtual void Reset();
   virtual void UpdateCosts(Costmap2D &master_grid, int min_i, int min_j, int max_i, int max_j);
+  virtual bool IsTileParallel() const {
+    return true;
+  }
+  virtual void PrepareTiles(Costmap2D &master_grid, int min_i, int min_j, int max_i, int max_j,
+                            unsigned int thread_num);
+  virtual void UpdateCostsTile(Costmap2D &master_grid, int min_i, int min_j, int max_i, int max_j,
+                               unsigned int thread_index);
   virtual void UpdateBounds(double robot_x, double robot_y, double robot_yaw, double *min_x, double *min_y,
                             double *max_x, double *max_y) override;
   void LaserScanCallback(const sensor_msgs::LaserScanConstPtr &message,
                          const std::shared_ptr<ObservationBuffer> &buffer);
   void LaserScanValidInfoCallback(const sensor_msgs::LaserScanConstPtr &message,
                                   const std::shared_ptr<ObservationBuffer> &buffer);
+  /**
+   * @brief Set the number of threads sharing the beams of a clearing observation.
+   * @param thread_num Thread number including the update thread, 1 means raytracing serially.
+   */
+  void SetRaytraceThreadNum(unsigned int thread_num);
+  /**
+   * @brief Add an observation that is already in the global frame, the way an offline layer is fed.
+   * @param origin The sensor origin in the global frame
+   * @param cloud The observed points in the global frame
+   */
+  void AddObservation(const geometry_msgs::Point &origin, const pcl::PointCloud<pcl::PointXYZ> &cloud);
 
  protected:
   bool GetMarkingObservations(std::vector<Observation> &marking_observations) const;
@@ -97,8 +116,24 @@ class ObstacleLayer : public CostmapLayer {
                                  double *max_x, double *max_y);
   void UpdateRaytraceBounds(double ox, double oy, double wx, double wy, double range, double *min_x, double *min_y,
                             double *max_x, double *max_y);
+  /**
+   * @brief Raytrace the beams [begin, end) of a clearing observation from the sensor cell (x0, y0), applying the
+   *        action to every cell along each beam.
+   */
+  template<typename ActionType>
+  void RaytraceBeams(const Observation &clearing_observation, size_t begin, size_t end, unsigned int x0,
+                     unsigned int y0, ActionType at, double *min_x, double *min_y, double *max_x, double *max_y);
   void UpdateFootprint(double robot_x, double robot_y, double robot_yaw, double *min_x, double *min_y,
                        double *max_x, double *max_y);
+  /**
+   * @brief Age the marked cells by the time since the last decay, cells not marked again within the decay time
+   *        are cleared and their area is added to the update bounds.
+   */
+  void DecayObstacles(double *min_x, double *min_y, double *max_x, double *max_y);
+  /**
+   * @brief Drop every decay counter, called whenever the layer is reset or resized.
+   */
+  void ResetDecay();
   bool footprint_clearing_enabled_, rolling_window_;
   int combination_method_;
   std::string global_frame_;
@@ -113,7 +148,44 @@ class ObstacleLayer : public CostmapLayer {
   std::vector<std::shared_ptr<ObservationBuffer> > clearing_buffers_;
 
   std::vector<Observation> static_clearing_observations_, static_marking_observations_;
+  //! Time of the last periodic reset, or of the last decay step in decay mode
   std::chrono::system_clock::time_point reset_time_;
+
+  //! Whether marked cells decay one by one instead of resetting the whole layer periodically
+  bool decay_enabled_ = false;
+  //! Duration of one decay counter step
+  std::chrono::system_clock::duration decay_step_;
+  //! Remaining decay steps of every cell, 0 for cells that are not marked
+  std::vector<unsigned char> decay_ttl_;
+  //! Cells which may have a non zero decay counter, (min_i, min_j, max_i, max_j), empty if max <= min
+  unsigned int decay_bounds_[4] = {0, 0, 0, 0};
+  //! Decay counter of a freshly marked cell
+  static const unsigned char kDecayTtl = 255;
+
+  //! Threads sharing the raytracing work, null when raytracing serially
+  std::unique_ptr<roborts_common::ThreadPool> raytrace_pool_;
+  //! Per-thread touched cells of the current raytrace window, merged into the layer once per observation
+  std::vector<std::vector<unsigned char> > raytrace_touched_;
+  //! Per-task raytrace bounds (min_x, min_y, max_x, max_y)
+  std::vector<double> raytrace_bounds_;
+  //! Beam blocks handed out per raytrace thread, more blocks than threads keeps the load balanced
+  static const int kRaytraceTaskPerThread = 4;
+
+ private:
+  /**
+   * @brief Action for raytracing into a touched buffer covering the rows [y0, yn) of the map
+   */
+  class TouchCell {
+   public:
+    TouchCell(unsigned char *touched, unsigned int base_offset) :
+        touched_(touched), base_offset_(base_offset) {}
+    inline void operator()(unsigned int offset) {
+      touched_[offset - base_offset_] = 1;
+    }
+   private:
+    unsigned char *touched_;
+    unsigned int base_offset_;
+  };
 };
 
 } //namespace roborts_costmap
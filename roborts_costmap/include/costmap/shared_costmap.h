@@ -0,0 +1,128 @@
+/****************************************************************************
+ *  Copyright (C) 2019 RoboMaster.
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program. If not, see <http://www.gnu.org/licenses/>.
+ ***************************************************************************/
+
+#ifndef ROBORTS_COSTMAP_SHARED_COSTMAP_H
+#define ROBORTS_COSTMAP_SHARED_COSTMAP_H
+
+#include <sys/types.h>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <string>
+
+#include "costmap_2d.h"
+
+namespace roborts_costmap {
+
+/**
+ * @brief Header at the start of a shared costmap region, followed by capacity cells of cost data. The writer
+ *        makes sequence odd while it writes and even again when done, a reader copies the map and retries if
+ *        the sequence was odd or changed meanwhile (a seqlock).
+ */
+struct SharedCostmapHeader {
+  char magic[8];
+  uint32_t version;
+  //! Set when the server closed or replaced the region, readers have to open it again
+  std::atomic<uint32_t> retired;
+  std::atomic<uint32_t> sequence;
+  uint32_t capacity;
+  uint32_t size_x, size_y;
+  uint32_t default_value;
+  double resolution, origin_x, origin_y;
+};
+
+/**
+ * @brief Writes the costmap of a costmap server into a POSIX shared memory region, so costmaps of other
+ *        processes with the same configuration can read it instead of computing it again.
+ */
+class SharedCostmapServer {
+ public:
+  /**
+   * @param name Name of the shared memory region, without the leading slash
+   */
+  explicit SharedCostmapServer(const std::string &name);
+  ~SharedCostmapServer();
+  /**
+   * @brief Publish a new version of the map, the region is replaced if the map outgrew it.
+   * @return False if the region could not be created
+   */
+  bool Publish(const Costmap2D &map);
+
+ private:
+  bool Create(size_t capacity);
+  void Close();
+
+  std::string name_;
+  SharedCostmapHeader *header_;
+  size_t region_size_;
+};
+
+/**
+ * @brief Reads the map of a SharedCostmapServer, possibly in another process.
+ */
+class SharedCostmapClient {
+ public:
+  explicit SharedCostmapClient(const std::string &name);
+  ~SharedCostmapClient();
+  /**
+   * @brief Copy the shared map into map if a version newer than the last one read has been published. Never
+   *        blocks on a server which stopped in the middle of a write, and opens the region again if a restarted
+   *        server replaced it.
+   * @param map Receives the map, resized to the geometry of the shared map
+   * @return True if map was updated, false if there is no new version, no server yet or the version being
+   *         written could not be read
+   */
+  bool Read(Costmap2D &map);
+
+ private:
+  bool Open();
+  void Close();
+  /**
+   * @brief Copy the latest version with a bounded number of seqlock retries.
+   */
+  bool CopyVersion(Costmap2D &map);
+  /**
+   * @brief Whether the name now refers to another region than the mapped one, which happens when a server
+   *        crashed without retiring its region and a new server created one.
+   */
+  bool IsRegionReplaced() const;
+
+  //! Seqlock retries of a read, a server which died while writing leaves the sequence odd for good
+  static const int kMaxReadAttempts = 100;
+  //! Failed reads between two checks whether the region was replaced
+  static const unsigned int kRegionCheckPeriod = 10;
+  //! Time without a new version after which the map is reported as stale, in s
+  static const double kStaleTimeout;
+
+  std::string name_;
+  const SharedCostmapHeader *header_;
+  size_t region_size_;
+  //! Device and inode of the mapped region
+  dev_t region_dev_;
+  ino_t region_ino_;
+  //! Sequence of the version last read
+  uint32_t sequence_;
+  //! Reads without a new version since the last version or region check
+  unsigned int failed_read_num_;
+  //! Time of the last version read, the epoch before the first one
+  std::chrono::steady_clock::time_point last_version_time_;
+  //! Set once the map was reported as stale, until a new version arrives
+  bool is_stale_;
+};
+
+} //namespace roborts_costmap
+#endif //ROBORTS_COSTMAP_SHARED_COSTMAP_H
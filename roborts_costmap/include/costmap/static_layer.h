@@ -69,14 +69,65 @@ class StaticLayer : public CostmapLayer {
   virtual void Deactivate();
   virtual void Reset();
   virtual void UpdateCosts(Costmap2D& master_grid, int min_i, int min_j, int max_i, int max_j);
+  virtual bool IsTileParallel() const {
+    return true;
+  }
+  virtual void PrepareTiles(Costmap2D& master_grid, int min_i, int min_j, int max_i, int max_j,
+                            unsigned int thread_num);
+  virtual void UpdateCostsTile(Costmap2D& master_grid, int min_i, int min_j, int max_i, int max_j,
+                               unsigned int thread_index);
   virtual void UpdateBounds(double robot_x, double robot_y, double robot_yaw, double* min_x, double* min_y,
                             double* max_x, double* max_y);
   virtual void MatchSize();
+  /**
+   * @brief Set the static map directly instead of receiving it on the map topic, the way an offline layer is fed.
+   * @param map The map
+   */
+  void SetMap(const nav_msgs::OccupancyGridConstPtr& map) {
+    InComingMap(map);
+  }
+  /**
+   * @brief Get the hash of the map the layer holds, which identifies the static map for data derived from it.
+   * @return The hash, 0 if no map is held
+   */
+  uint64_t GetMapHash() const {
+    return map_hash_;
+  }
+  /**
+   * @brief Hash a map message over its geometry, frame and data.
+   */
+  static uint64_t HashMap(const nav_msgs::OccupancyGrid &map);
 
  private:
   void InComingMap(const nav_msgs::OccupancyGridConstPtr& new_map);
 //  void IncomingUpdate(const map_msgs::OccupancyGridUpdateConstPtr& update);
+  /**
+   * @brief Resize the layer, and the master map if it is not rolling, to the geometry of the static map.
+   */
+  void MatchMapGeometry(unsigned int size_x, unsigned int size_y, double resolution, double origin_x,
+                        double origin_y);
   unsigned char InterpretValue(unsigned char value);
+  /**
+   * @brief Reproject the static map into reprojection_ over one tile of the master grid, in rolling window mode.
+   */
+  void ReprojectTile(const Costmap2D& master_grid, int min_i, int min_j, int max_i, int max_j);
+  /**
+   * @brief Get the cells [begin, end) of master row j within [min_i, max_i) reprojecting into the static map.
+   */
+  void GetInsideSpan(int j, int min_i, int max_i, int &begin, int &end) const;
+  /**
+   * @brief Fill the table translating every map value into a cost with InterpretValue().
+   */
+  void BuildInterpretTable();
+  /**
+   * @brief Load the interpreted static map from the cache file.
+   * @return True if the cache exists and was built with the current interpretation parameters.
+   */
+  bool LoadMapCache();
+  /**
+   * @brief Write the interpreted static map to the cache file.
+   */
+  void SaveMapCache();
   std::string global_frame_;
   std::string map_frame_;
   std::string map_topic_;
@@ -90,6 +141,27 @@ class StaticLayer : public CostmapLayer {
   bool first_map_only_;
   bool trinary_costmap_;
   ros::Subscriber map_sub_, map_update_sub_;
+  //! Transform from the global frame to the map frame for the current update, looked up once per update
+  tf::StampedTransform update_transform_;
+  //! Whether the current update can be applied
+  bool update_ready_ = false;
+  //! Static costs reprojected onto the master grid in rolling window mode, only set inside the static map
+  std::vector<unsigned char> reprojection_;
+  //! Master cells reprojection_ is valid for, (min_i, min_j, max_i, max_j)
+  int reprojection_bounds_[4] = {0, 0, 0, 0};
+  //! Static map coordinates of master cell (i, j): u = a0 + a1 * i + a2 * j, v = a3 + a4 * i + a5 * j
+  double reprojection_affine_[6];
+  //! Master size and static map hash reprojection_ was computed with, together with reprojection_affine_
+  unsigned int reprojection_size_x_ = 0, reprojection_size_y_ = 0;
+  uint64_t reprojection_map_hash_ = 0;
+  //! Whether the current update has to reproject the static map
+  bool reproject_ = false;
+  //! Cost of every map value, built from the interpretation parameters
+  unsigned char interpret_table_[256];
+  //! File caching the interpreted static map, empty if the cache is disabled
+  std::string map_cache_path_;
+  //! Hash of the map message the layer holds, 0 if no map is held
+  uint64_t map_hash_ = 0;
 };
 
 
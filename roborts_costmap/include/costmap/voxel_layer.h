@@ -0,0 +1,175 @@
+/****************************************************************************
+ *  Copyright (C) 2019 RoboMaster.
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program. If not, see <http://www.gnu.org/licenses/>.
+ ***************************************************************************/
+#ifndef ROBORTS_COSTMAP_VOXEL_LAYER_H
+#define ROBORTS_COSTMAP_VOXEL_LAYER_H
+
+#include <algorithm>
+#include <cstdint>
+#include "obstacle_layer.h"
+
+namespace roborts_costmap {
+
+/**
+ * @brief Obstacle layer keeping the height of the observations, every cell is a column of up to 32 voxels
+ *        stored as one bit each, in a 16 bit mask for up to 16 voxels and in a 32 bit mask otherwise.
+ *        Beams clear only the voxels they pass through, so a beam passing over a low obstacle or under an
+ *        overhang leaves it in place. A cell is lethal if at least mark_threshold voxels of its column are marked.
+ */
+class VoxelLayer : public ObstacleLayer {
+ public:
+  VoxelLayer() {}
+
+  virtual ~VoxelLayer() {}
+  virtual void OnInitialize();
+  virtual void UpdateBounds(double robot_x, double robot_y, double robot_yaw, double *min_x, double *min_y,
+                            double *max_x, double *max_y) override;
+  virtual void UpdateOrigin(double new_origin_x, double new_origin_y) override;
+  /**
+   * @brief Get the number of voxels of a column.
+   * @return The voxel number, at most 32
+   */
+  unsigned int GetZVoxels() const {
+    return z_voxels_;
+  }
+  /**
+   * @brief Get the voxel column of a cell, bit k is the voxel [origin_z + k * z_resolution, origin_z + (k + 1) *
+   *        z_resolution).
+   * @param mx The x coordinate of the cell
+   * @param my The y coordinate of the cell
+   * @return The occupancy mask of the column
+   */
+  uint32_t GetColumn(unsigned int mx, unsigned int my) const;
+  /**
+   * @brief Get the mask of the voxels between two heights.
+   * @param z0 One height in voxels above origin_z
+   * @param z1 The other height in voxels above origin_z
+   * @param z_voxels Voxels per column
+   * @return The mask of the voxels in [min(z0, z1), max(z0, z1)] clipped to the column
+   */
+  static inline uint32_t SpanMask(double z0, double z1, unsigned int z_voxels) {
+    double low = std::max(std::min(z0, z1), 0.0);
+    double high = std::min(std::max(z0, z1), z_voxels - 0.5);
+    if (low > high) {
+      return 0;
+    }
+    unsigned int low_bit = static_cast<unsigned int>(low), high_bit = static_cast<unsigned int>(high);
+    return static_cast<uint32_t>((uint64_t(2) << high_bit) - (uint64_t(1) << low_bit));
+  }
+  /**
+   * @brief Get the cost of a column.
+   * @param column The occupancy mask of the column
+   * @param mark_threshold Marked voxels making the cell lethal
+   * @return LETHAL_OBSTACLE or FREE_SPACE
+   */
+  static inline unsigned char ProjectColumn(uint32_t column, unsigned int mark_threshold) {
+    // a single marked voxel is the common threshold and needs no popcount
+    if (mark_threshold <= 1) {
+      return column ? LETHAL_OBSTACLE : FREE_SPACE;
+    }
+    return static_cast<unsigned int>(__builtin_popcount(column)) >= mark_threshold ? LETHAL_OBSTACLE : FREE_SPACE;
+  }
+
+ protected:
+  virtual void ResetMaps() override;
+  virtual void InitMaps(unsigned int size_x, unsigned int size_y) override;
+  virtual void RaytraceFreespace(const Observation &clearing_observation, double *min_x, double *min_y,
+                                 double *max_x, double *max_y) override;
+  /**
+   * @brief Mark the voxels of the points of the marking observations and project their columns.
+   */
+  template<typename MaskType>
+  void MarkVoxels(MaskType *columns, const std::vector<Observation> &observations, double *min_x, double *min_y,
+                  double *max_x, double *max_y);
+  /**
+   * @brief Apply the function to the columns in use, std::vector<uint16_t> or std::vector<uint32_t>.
+   */
+  template<typename FunctionType>
+  void ForColumns(FunctionType function) {
+    if (z_voxels_ > 16) {
+      function(wide_columns_);
+    } else {
+      function(narrow_columns_);
+    }
+  }
+
+  //! Height of a voxel
+  double z_resolution_ = 0.125;
+  //! Height of the bottom of the lowest voxel
+  double origin_z_ = 0;
+  //! Voxels per column
+  unsigned int z_voxels_ = 16;
+  //! Marked voxels of a column making its cell lethal
+  unsigned int mark_threshold_ = 1;
+  //! Columns of up to 16 voxels
+  std::vector<uint16_t> narrow_columns_;
+  //! Columns of up to 32 voxels
+  std::vector<uint32_t> wide_columns_;
+  //! Cells of the footprint, whose columns are cleared with the footprint
+  ConvexSpans footprint_spans_;
+
+ private:
+  /**
+   * @brief Action for raytracing a beam staying within the same voxels in every cell, like the beams of a planar
+   *        laser, clearing these voxels and projecting the column to a cost.
+   */
+  template<typename MaskType>
+  class ClearColumn {
+   public:
+    ClearColumn(MaskType *columns, unsigned char *costmap, MaskType mask, unsigned int mark_threshold) :
+        columns_(columns), costmap_(costmap), keep_mask_(~mask), mark_threshold_(mark_threshold) {}
+    inline void operator()(unsigned int offset) {
+      MaskType column = columns_[offset] & keep_mask_;
+      columns_[offset] = column;
+      costmap_[offset] = ProjectColumn(column, mark_threshold_);
+    }
+   private:
+    MaskType *columns_;
+    unsigned char *costmap_;
+    MaskType keep_mask_;
+    unsigned int mark_threshold_;
+  };
+
+  /**
+   * @brief Action for raytracing a beam through the voxel columns, clearing the voxels the beam passes between
+   *        entering and leaving each cell and projecting the column to a cost.
+   */
+  template<typename MaskType>
+  class ClearVoxels {
+   public:
+    ClearVoxels(MaskType *columns, unsigned char *costmap, double z, double dz, double z_end, unsigned int z_voxels,
+                unsigned int mark_threshold) :
+        columns_(columns), costmap_(costmap), z_(z), dz_(dz), z_end_(z_end), z_voxels_(z_voxels),
+        mark_threshold_(mark_threshold) {}
+    inline void operator()(unsigned int offset) {
+      // the last cell only holds the end of the beam
+      double z_next = (z_ + dz_ - z_end_) * dz_ > 0 ? z_end_ : z_ + dz_;
+      MaskType column = columns_[offset] & ~static_cast<MaskType>(SpanMask(z_, z_next, z_voxels_));
+      columns_[offset] = column;
+      costmap_[offset] = ProjectColumn(column, mark_threshold_);
+      z_ = z_next;
+    }
+   private:
+    MaskType *columns_;
+    unsigned char *costmap_;
+    double z_, dz_, z_end_;
+    unsigned int z_voxels_, mark_threshold_;
+  };
+};
+
+} //namespace roborts_costmap
+
+#endif //ROBORTS_COSTMAP_VOXEL_LAYER_H
@@ -0,0 +1,193 @@
+/****************************************************************************
+ *  Copyright (C) 2019 RoboMaster.
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program. If not, see <http://www.gnu.org/licenses/>.
+ ***************************************************************************/
+
+#include <algorithm>
+
+#include "cost_pyramid.h"
+
+namespace roborts_costmap {
+
+CostPyramid::CostPyramid() : size_x_(0), size_y_(0), is_stale_(true),
+                             dirty_x0_(0), dirty_y0_(0), dirty_xn_(0), dirty_yn_(0) {}
+
+void CostPyramid::Resize(unsigned int size_x, unsigned int size_y) {
+  size_x_ = size_x;
+  size_y_ = size_y;
+  levels_.clear();
+  while (size_x > 1 || size_y > 1) {
+    size_x = (size_x + 1) / 2;
+    size_y = (size_y + 1) / 2;
+    Level level;
+    level.size_x = size_x;
+    level.size_y = size_y;
+    level.cost.assign(size_x * size_y, 0);
+    levels_.push_back(std::move(level));
+  }
+  is_stale_ = true;
+}
+
+void CostPyramid::Invalidate(unsigned int x0, unsigned int y0, unsigned int xn, unsigned int yn) {
+  if (xn <= x0 || yn <= y0) {
+    return;
+  }
+  if (dirty_x0_ >= dirty_xn_) {
+    dirty_x0_ = x0;
+    dirty_y0_ = y0;
+    dirty_xn_ = xn;
+    dirty_yn_ = yn;
+  } else {
+    dirty_x0_ = std::min(dirty_x0_, x0);
+    dirty_y0_ = std::min(dirty_y0_, y0);
+    dirty_xn_ = std::max(dirty_xn_, xn);
+    dirty_yn_ = std::max(dirty_yn_, yn);
+  }
+}
+
+void CostPyramid::Update(const unsigned char *base, unsigned int x0, unsigned int y0, unsigned int xn,
+                         unsigned int yn) {
+  if (is_stale_) {
+    x0 = y0 = 0;
+    xn = size_x_;
+    yn = size_y_;
+    is_stale_ = false;
+  } else if (dirty_x0_ < dirty_xn_) {
+    if (x0 >= xn || y0 >= yn) {
+      x0 = dirty_x0_;
+      y0 = dirty_y0_;
+      xn = dirty_xn_;
+      yn = dirty_yn_;
+    } else {
+      x0 = std::min(x0, dirty_x0_);
+      y0 = std::min(y0, dirty_y0_);
+      xn = std::max(xn, dirty_xn_);
+      yn = std::max(yn, dirty_yn_);
+    }
+  }
+  dirty_x0_ = dirty_y0_ = dirty_xn_ = dirty_yn_ = 0;
+  xn = std::min(xn, size_x_);
+  yn = std::min(yn, size_y_);
+  for (unsigned int level = 1; level <= levels_.size() && x0 < xn && y0 < yn; ++level) {
+    x0 /= 2;
+    y0 /= 2;
+    xn = (xn + 1) / 2;
+    yn = (yn + 1) / 2;
+    ReduceLevel(base, level, x0, y0, xn, yn);
+  }
+}
+
+void CostPyramid::ReduceLevel(const unsigned char *base, unsigned int level, unsigned int x0, unsigned int y0,
+                              unsigned int xn, unsigned int yn) {
+  const unsigned int below_size_x = level == 1 ? size_x_ : levels_[level - 2].size_x;
+  const unsigned int below_size_y = level == 1 ? size_y_ : levels_[level - 2].size_y;
+  const unsigned char *below = level == 1 ? base : levels_[level - 2].cost.data();
+  Level &current = levels_[level - 1];
+  for (unsigned int y = y0; y < yn; ++y) {
+    const unsigned char *row0 = below + 2 * y * below_size_x;
+    // the last row and column of an odd sized level have no partner
+    const unsigned char *row1 = 2 * y + 1 < below_size_y ? row0 + below_size_x : row0;
+    unsigned char *out = current.cost.data() + y * current.size_x;
+    for (unsigned int x = x0; x < xn; ++x) {
+      const unsigned int x1 = std::min(2 * x + 1, below_size_x - 1);
+      out[x] = std::max(std::max(row0[2 * x], row0[x1]), std::max(row1[2 * x], row1[x1]));
+    }
+  }
+}
+
+bool CostPyramid::Search(const unsigned char *base, unsigned int level, unsigned int x, unsigned int y,
+                         unsigned int x0, unsigned int y0, unsigned int xn, unsigned int yn,
+                         unsigned char stop_cost, unsigned char &max_cost) const {
+  const unsigned char cost = Cost(base, level, x, y);
+  if (cost <= max_cost) {
+    return false;
+  }
+  const unsigned int cell_x0 = x << level, cell_y0 = y << level;
+  const unsigned int cell_xn = std::min((x + 1) << level, size_x_);
+  const unsigned int cell_yn = std::min((y + 1) << level, size_y_);
+  if (level == 0 || (x0 <= cell_x0 && cell_xn <= xn && y0 <= cell_y0 && cell_yn <= yn)) {
+    max_cost = cost;
+    return max_cost >= stop_cost;
+  }
+  // the block straddles the region border, only some of its children count
+  const unsigned int child_x = std::max(2 * x, x0 >> (level - 1));
+  const unsigned int child_y = std::max(2 * y, y0 >> (level - 1));
+  const unsigned int child_xn = std::min(2 * x + 2, ((xn - 1) >> (level - 1)) + 1);
+  const unsigned int child_yn = std::min(2 * y + 2, ((yn - 1) >> (level - 1)) + 1);
+  for (unsigned int j = child_y; j < child_yn; ++j) {
+    for (unsigned int i = child_x; i < child_xn; ++i) {
+      if (Search(base, level - 1, i, j, x0, y0, xn, yn, stop_cost, max_cost)) {
+        return true;
+      }
+    }
+  }
+  return false;
+}
+
+bool CostPyramid::SearchRegion(const unsigned char *base, unsigned int x0, unsigned int y0, unsigned int xn,
+                               unsigned int yn, unsigned char stop_cost, unsigned char &max_cost) const {
+  unsigned int level = 0;
+  while (level < levels_.size() && (((xn - 1) >> level) - (x0 >> level) > 1 ||
+                                    ((yn - 1) >> level) - (y0 >> level) > 1)) {
+    ++level;
+  }
+  for (unsigned int y = y0 >> level; y <= (yn - 1) >> level; ++y) {
+    for (unsigned int x = x0 >> level; x <= (xn - 1) >> level; ++x) {
+      if (Search(base, level, x, y, x0, y0, xn, yn, stop_cost, max_cost)) {
+        return true;
+      }
+    }
+  }
+  return false;
+}
+
+unsigned char CostPyramid::GetMaxCost(const unsigned char *base, unsigned int x0, unsigned int y0,
+                                      unsigned int xn, unsigned int yn) const {
+  xn = std::min(xn, size_x_);
+  yn = std::min(yn, size_y_);
+  unsigned char max_cost = 0;
+  if (x0 >= xn || y0 >= yn) {
+    return max_cost;
+  }
+  if (!IsValid()) {
+    for (unsigned int y = y0; y < yn; ++y) {
+      const unsigned char *row = base + y * size_x_;
+      max_cost = std::max(max_cost, *std::max_element(row + x0, row + xn));
+    }
+    return max_cost;
+  }
+  SearchRegion(base, x0, y0, xn, yn, 255, max_cost);
+  return max_cost;
+}
+
+bool CostPyramid::IsCostAtLeast(const unsigned char *base, unsigned int x0, unsigned int y0, unsigned int xn,
+                                unsigned int yn, unsigned char threshold) const {
+  if (threshold == 0) {
+    return x0 < std::min(xn, size_x_) && y0 < std::min(yn, size_y_);
+  }
+  if (!IsValid()) {
+    return GetMaxCost(base, x0, y0, xn, yn) >= threshold;
+  }
+  xn = std::min(xn, size_x_);
+  yn = std::min(yn, size_y_);
+  if (x0 >= xn || y0 >= yn) {
+    return false;
+  }
+  // blocks below the threshold are pruned by starting the search just under it
+  unsigned char max_cost = threshold - 1;
+  return SearchRegion(base, x0, y0, xn, yn, threshold, max_cost);
+}
+
+} //namespace roborts_costmap
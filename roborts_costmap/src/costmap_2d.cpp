@@ -51,6 +51,9 @@
  *********************************************************************/
 
 #include "costmap_2d.h"
+#include <algorithm>
+#include <cstring>
+#include <limits>
 
 namespace roborts_costmap {
 
@@ -62,7 +65,8 @@ Costmap2D::Costmap2D(unsigned int cells_size_x, unsigned int cells_size_y, doubl
                                                                      origin_x_(origin_x),
                                                                      origin_y_(origin_y),
                                                                      costmap_(NULL),
-                                                                     default_value_(default_value) {
+                                                                     default_value_(default_value),
+                                                                     has_max_pyramid_(false) {
   access_ = new mutex_t();
   InitMaps(size_x_, size_y_);
   ResetMaps();
@@ -78,6 +82,9 @@ void Costmap2D::InitMaps(unsigned int size_x, unsigned int size_y) {
   std::unique_lock<mutex_t> lock(*access_);
   delete[] costmap_;
   costmap_ = new unsigned char[size_x * size_y];
+  if (has_max_pyramid_) {
+    max_pyramid_.Resize(size_x, size_y);
+  }
 }
 
 void Costmap2D::ResizeMap(unsigned int size_x,
@@ -97,6 +104,7 @@ void Costmap2D::ResizeMap(unsigned int size_x,
 void Costmap2D::ResetMaps() {
   std::unique_lock<mutex_t> lock(*access_);
   memset(costmap_, default_value_, size_x_ * size_y_ * sizeof(unsigned char));
+  max_pyramid_.Invalidate();
 }
 
 void Costmap2D::ResetPartMap(unsigned int x0, unsigned int y0, unsigned int xn, unsigned int yn) {
@@ -104,6 +112,7 @@ void Costmap2D::ResetPartMap(unsigned int x0, unsigned int y0, unsigned int xn,
   unsigned int len = xn - x0;
   for (unsigned int y = y0 * size_x_ + x0; y < yn * size_x_ + x0; y += size_x_)
     memset(costmap_ + y, default_value_, len * sizeof(unsigned char));
+  max_pyramid_.Invalidate(x0, y0, xn, yn);
 }
 
 bool Costmap2D::CopyCostMapWindow(const Costmap2D &map,
@@ -132,25 +141,32 @@ Costmap2D &Costmap2D::operator=(const Costmap2D &map) {
   // check for self assignement
   if (this == &map)
     return *this;
-  DeleteMaps();
+  // keep the cost array when the size does not change, so repeated copies do not allocate
+  if (costmap_ == NULL || size_x_ != map.size_x_ || size_y_ != map.size_y_) {
+    DeleteMaps();
+    InitMaps(map.size_x_, map.size_y_);
+  }
   size_x_ = map.size_x_;
   size_y_ = map.size_y_;
   resolution_ = map.resolution_;
   origin_x_ = map.origin_x_;
   origin_y_ = map.origin_y_;
-  InitMaps(size_x_, size_y_);
+  default_value_ = map.default_value_;
   memcpy(costmap_, map.costmap_, size_x_ * size_y_ * sizeof(unsigned char));
+  has_max_pyramid_ = map.has_max_pyramid_;
+  max_pyramid_ = map.max_pyramid_;
   return *this;
 }
 
 Costmap2D::Costmap2D(const Costmap2D &map) :
-    costmap_(NULL) {
+    costmap_(NULL), has_max_pyramid_(false) {
   access_ = new mutex_t();
   *this = map;
 }
 
 Costmap2D::Costmap2D() :
-    size_x_(0), size_y_(0), resolution_(0.0), origin_x_(0.0), origin_y_(0.0), costmap_(NULL) {
+    size_x_(0), size_y_(0), resolution_(0.0), origin_x_(0.0), origin_y_(0.0), costmap_(NULL),
+    has_max_pyramid_(false) {
   access_ = new mutex_t();
 }
 
@@ -168,6 +184,65 @@ unsigned char *Costmap2D::GetCharMap() const {
   return costmap_;
 }
 
+void Costmap2D::SetMaxPyramidEnabled(bool enabled) {
+  std::unique_lock<mutex_t> lock(*access_);
+  if (enabled && !has_max_pyramid_) {
+    max_pyramid_.Resize(size_x_, size_y_);
+  } else if (!enabled) {
+    max_pyramid_ = CostPyramid();
+  }
+  has_max_pyramid_ = enabled;
+}
+
+void Costmap2D::UpdateMaxPyramid(unsigned int x0, unsigned int y0, unsigned int xn, unsigned int yn) {
+  if (has_max_pyramid_) {
+    max_pyramid_.Update(costmap_, x0, y0, xn, yn);
+  }
+}
+
+unsigned char Costmap2D::GetRegionMaxCost(unsigned int x0, unsigned int y0, unsigned int xn,
+                                          unsigned int yn) const {
+  if (has_max_pyramid_) {
+    return max_pyramid_.GetMaxCost(costmap_, x0, y0, xn, yn);
+  }
+  xn = std::min(xn, size_x_);
+  yn = std::min(yn, size_y_);
+  unsigned char max_cost = 0;
+  for (unsigned int y = y0; y < yn && x0 < xn; ++y) {
+    const unsigned char *row = costmap_ + y * size_x_;
+    max_cost = std::max(max_cost, *std::max_element(row + x0, row + xn));
+  }
+  return max_cost;
+}
+
+bool Costmap2D::IsRegionCostAtLeast(unsigned int x0, unsigned int y0, unsigned int xn, unsigned int yn,
+                                    unsigned char threshold) const {
+  if (has_max_pyramid_) {
+    return max_pyramid_.IsCostAtLeast(costmap_, x0, y0, xn, yn, threshold);
+  }
+  return x0 < std::min(xn, size_x_) && y0 < std::min(yn, size_y_) &&
+         GetRegionMaxCost(x0, y0, xn, yn) >= threshold;
+}
+
+bool Costmap2D::GetFootprintMaxCost(const std::vector<geometry_msgs::Point> &footprint, unsigned char &cost) const {
+  if (footprint.empty()) {
+    return false;
+  }
+  double min_x = footprint[0].x, min_y = footprint[0].y, max_x = min_x, max_y = min_y;
+  for (const auto &point : footprint) {
+    min_x = std::min(min_x, point.x);
+    min_y = std::min(min_y, point.y);
+    max_x = std::max(max_x, point.x);
+    max_y = std::max(max_y, point.y);
+  }
+  unsigned int x0, y0, x1, y1;
+  if (!World2Map(min_x, min_y, x0, y0) || !World2Map(max_x, max_y, x1, y1)) {
+    return false;
+  }
+  cost = GetRegionMaxCost(x0, y0, x1 + 1, y1 + 1);
+  return true;
+}
+
 unsigned char Costmap2D::GetCost(unsigned int mx, unsigned int my) const {
   return costmap_[GetIndex(mx, my)];
 }
@@ -247,23 +322,72 @@ void Costmap2D::UpdateOrigin(double new_origin_x, double new_origin_y) {
 }
 
 bool Costmap2D::SetConvexRegionCost(const std::vector<geometry_msgs::Point> &polygon, unsigned char cost_value) {
-  std::vector<MapLocation> map_polygon;
+  return SetConvexRegionCost(polygon, cost_value, convex_spans_);
+}
+
+bool Costmap2D::SetConvexRegionCost(const std::vector<geometry_msgs::Point> &polygon, unsigned char cost_value,
+                                    ConvexSpans &spans) {
+  spans.vertices.resize(polygon.size());
   for (unsigned int i = 0; i < polygon.size(); ++i) {
-    MapLocation loc;
-    if (!World2Map(polygon[i].x, polygon[i].y, loc.x, loc.y)) {
+    if (!World2Map(polygon[i].x, polygon[i].y, spans.vertices[i].x, spans.vertices[i].y)) {
       return false;
     }
-    map_polygon.push_back(loc);
   }
-  std::vector<MapLocation> polygon_cells;
-  FillConvexCells(map_polygon, polygon_cells);
-  for (unsigned int i = 0; i < polygon_cells.size(); ++i) {
-    unsigned int index = GetIndex(polygon_cells[i].x, polygon_cells[i].y);
-    costmap_[index] = cost_value;
+  if (polygon.size() < 3) {
+    return true;
+  }
+  RasterizeConvexPolygon(spans.vertices.data(), spans.vertices.size(), spans);
+  for (unsigned int row = 0; row < spans.row_num; ++row) {
+    unsigned char *cell = costmap_ + GetIndex(spans.min_x[row], spans.min_y + row);
+    memset(cell, cost_value, spans.max_x[row] - spans.min_x[row] + 1);
   }
   return true;
 }
 
+void Costmap2D::RasterizeConvexPolygon(const MapLocation *polygon, size_t num, ConvexSpans &spans) const {
+  unsigned int min_y = polygon[0].y, max_y = polygon[0].y;
+  for (size_t i = 1; i < num; ++i) {
+    min_y = std::min(min_y, polygon[i].y);
+    max_y = std::max(max_y, polygon[i].y);
+  }
+  spans.min_y = min_y;
+  spans.row_num = max_y - min_y + 1;
+  if (spans.min_x.size() < spans.row_num) {
+    spans.min_x.resize(spans.row_num);
+    spans.max_x.resize(spans.row_num);
+  }
+  std::fill(spans.min_x.begin(), spans.min_x.begin() + spans.row_num, std::numeric_limits<unsigned int>::max());
+  std::fill(spans.max_x.begin(), spans.max_x.begin() + spans.row_num, 0);
+
+  // walk every edge with Bresenham, each visited cell widens the span of its row; every row of a closed
+  // outline is visited, and a convex polygon covers exactly the cells between the outline cells of a row
+  for (size_t i = 0; i < num; ++i) {
+    const MapLocation &from = polygon[i], &to = polygon[(i + 1) % num];
+    int x = from.x, y = from.y;
+    const int x1 = to.x, y1 = to.y;
+    const int dx = std::abs(x1 - x), dy = -std::abs(y1 - y);
+    const int step_x = x < x1 ? 1 : -1, step_y = y < y1 ? 1 : -1;
+    int error = dx + dy;
+    while (true) {
+      unsigned int row = y - min_y;
+      spans.min_x[row] = std::min(spans.min_x[row], static_cast<unsigned int>(x));
+      spans.max_x[row] = std::max(spans.max_x[row], static_cast<unsigned int>(x));
+      if (x == x1 && y == y1) {
+        break;
+      }
+      int double_error = 2 * error;
+      if (double_error >= dy) {
+        error += dy;
+        x += step_x;
+      }
+      if (double_error <= dx) {
+        error += dx;
+        y += step_y;
+      }
+    }
+  }
+}
+
 void Costmap2D::GetConvexEdge(const std::vector<MapLocation> &polygon, std::vector<MapLocation> &polygon_cells) {
   PolygonOutlineCells cell_gatherer(*this, costmap_, polygon_cells);
   for (unsigned int i = 0; i < polygon.size() - 1; ++i) {
@@ -278,51 +402,12 @@ void Costmap2D::GetConvexEdge(const std::vector<MapLocation> &polygon, std::vect
 void Costmap2D::FillConvexCells(const std::vector<MapLocation> &polygon, std::vector<MapLocation> &polygon_cells) {
   if (polygon.size() < 3)
     return;
-  GetConvexEdge(polygon, polygon_cells);
-  MapLocation swap;
-  unsigned int i = 0;
-  while (i < polygon_cells.size() - 1) {
-    if (polygon_cells[i].x > polygon_cells[i + 1].x) {
-      swap = polygon_cells[i];
-      polygon_cells[i] = polygon_cells[i + 1];
-      polygon_cells[i + 1] = swap;
-
-      if (i > 0)
-        --i;
-    } else
-      ++i;
-  }
-
-  i = 0;
-  MapLocation min_pt;
-  MapLocation max_pt;
-  unsigned int min_x = polygon_cells[0].x;
-  unsigned int max_x = polygon_cells[polygon_cells.size() - 1].x;
-  for (unsigned int x = min_x; x <= max_x; ++x) {
-    if (i >= polygon_cells.size() - 1)
-      break;
-
-    if (polygon_cells[i].y < polygon_cells[i + 1].y) {
-      min_pt = polygon_cells[i];
-      max_pt = polygon_cells[i + 1];
-    } else {
-      min_pt = polygon_cells[i + 1];
-      max_pt = polygon_cells[i];
-    }
-
-    i += 2;
-    while (i < polygon_cells.size() && polygon_cells[i].x == x) {
-      if (polygon_cells[i].y < min_pt.y)
-        min_pt = polygon_cells[i];
-      else if (polygon_cells[i].y > max_pt.y)
-        max_pt = polygon_cells[i];
-      ++i;
-    }
-
-    MapLocation pt;
-    for (unsigned int y = min_pt.y; y < max_pt.y; ++y) {
-      pt.x = x;
-      pt.y = y;
+  ConvexSpans spans;
+  RasterizeConvexPolygon(polygon.data(), polygon.size(), spans);
+  MapLocation pt;
+  for (unsigned int row = 0; row < spans.row_num; ++row) {
+    pt.y = spans.min_y + row;
+    for (pt.x = spans.min_x[row]; pt.x <= spans.max_x[row]; ++pt.x) {
       polygon_cells.push_back(pt);
     }
   }
@@ -51,6 +51,7 @@
  *********************************************************************/
 #include "costmap_parameter_setting.pb.h"
 #include "costmap_interface.h"
+#include "costmap_simd.h"
 
 namespace roborts_costmap {
 
@@ -59,7 +60,7 @@ CostmapInterface::CostmapInterface(std::string map_name,
                                    std::string config_file) :
     layered_costmap_(nullptr),
     name_(map_name),
-    tf_(tf),
+    tf_(&tf),
     config_file_(config_file),
     stop_updates_(false),
     initialized_(true),
@@ -69,14 +70,19 @@ CostmapInterface::CostmapInterface(std::string map_name,
     last_publish_(0),
     dist_behind_robot_threshold_to_care_obstacles_(0.05),
     is_debug_(false),
-    map_update_thread_shutdown_(false) {
+    map_update_thread_shutdown_(false),
+    publish_full_map_(true),
+    last_keyframe_(0),
+    last_diagnostics_(0) {
   std::string tf_error;
   ros::NodeHandle private_nh(map_name);
   LoadParameter();
   layered_costmap_ = new CostmapLayers(global_frame_, is_rolling_window_, is_track_unknown_);
   layered_costmap_->SetFilePath(config_file_inflation_);
+  layered_costmap_->SetUpdateThreadNum(update_thread_num_, update_tile_size_);
+  layered_costmap_->SetMaxPyramidEnabled(has_max_pyramid_);
   ros::Time last_error = ros::Time::now();
-  while (ros::ok() && !tf_.waitForTransform(global_frame_, robot_base_frame_, ros::Time(), ros::Duration(0.1), \
+  while (ros::ok() && !tf_->waitForTransform(global_frame_, robot_base_frame_, ros::Time(), ros::Duration(0.1), \
          ros::Duration(0.01), &tf_error)) {
     ros::spinOnce();
     if (last_error + ros::Duration(5.0) < ros::Time::now()) {
@@ -84,20 +90,36 @@ CostmapInterface::CostmapInterface(std::string map_name,
     }
     tf_error.clear();
   }
+  if (is_shared_costmap_client_) {
+    // a client runs no layer, the server it reads from is configured the same way
+    has_static_layer_ = has_obstacle_layer_ = false;
+    shared_costmap_client_.reset(new SharedCostmapClient(shared_costmap_name_));
+    // like the static layer waits for its map, the master takes the geometry of the server's map before returning
+    ros::Rate wait_rate(10);
+    while (ros::ok() && !layered_costmap_->UpdateMapFromShared(*shared_costmap_client_)) {
+      ROS_WARN_THROTTLE(5.0, "Waiting for the shared costmap %s", shared_costmap_name_.c_str());
+      wait_rate.sleep();
+    }
+  } else if (!shared_costmap_name_.empty()) {
+    shared_costmap_server_.reset(new SharedCostmapServer(shared_costmap_name_));
+  }
   if (has_static_layer_) {
     Layer *plugin_static_layer;
     plugin_static_layer = new StaticLayer;
     layered_costmap_->AddPlugin(plugin_static_layer);
-    plugin_static_layer->Initialize(layered_costmap_, map_name + "/" + "static_layer", &tf_);
+    plugin_static_layer->Initialize(layered_costmap_, map_name + "/" + "static_layer", tf_);
   }
   if (has_obstacle_layer_) {
-    Layer *plugin_obstacle_layer = new ObstacleLayer;
+    // the voxel layer takes the place of the obstacle layer, observing the same sensors
+    Layer *plugin_obstacle_layer = has_voxel_layer_ ? new VoxelLayer : new ObstacleLayer;
     layered_costmap_->AddPlugin(plugin_obstacle_layer);
-    plugin_obstacle_layer->Initialize(layered_costmap_, map_name + "/" + "obstacle_layer", &tf_);
+    plugin_obstacle_layer->Initialize(layered_costmap_, map_name + "/" + "obstacle_layer", tf_);
+  }
+  if (!is_shared_costmap_client_) {
+    Layer *plugin_inflation_layer = new InflationLayer;
+    layered_costmap_->AddPlugin(plugin_inflation_layer);
+    plugin_inflation_layer->Initialize(layered_costmap_, map_name + "/" + "inflation_layer", tf_);
   }
-  Layer *plugin_inflation_layer = new InflationLayer;
-  layered_costmap_->AddPlugin(plugin_inflation_layer);
-  plugin_inflation_layer->Initialize(layered_costmap_, map_name + "/" + "inflation_layer", &tf_);
   SetUnpaddedRobotFootprint(footprint_points_);
   stop_updates_ = false;
   initialized_ = true;
@@ -118,9 +140,15 @@ CostmapInterface::CostmapInterface(std::string map_name,
       cost_translation_table_[i] = char(1 + (97 * (i - 1)) / 251);
     }
   }
-  costmap_pub_ = private_nh.advertise<nav_msgs::OccupancyGrid>(name_ + "/costmap", 10);
+  costmap_pub_ = private_nh.advertise<nav_msgs::OccupancyGrid>(name_ + "/costmap", 10,
+      std::bind(&CostmapInterface::OnMapSubscribe, this, std::placeholders::_1));
+  costmap_update_pub_ = private_nh.advertise<map_msgs::OccupancyGridUpdate>(name_ + "/costmap_updates", 10);
+  if (diagnostics_period_ > 0) {
+    diagnostics_pub_ = private_nh.advertise<diagnostic_msgs::DiagnosticArray>("/diagnostics", 10);
+  }
   map_update_thread_ = new std::thread(std::bind(&CostmapInterface::MapUpdateLoop, this, map_update_frequency_));
-  if (is_rolling_window_) {
+  // a client already has the geometry of the server's map
+  if (is_rolling_window_ && !shared_costmap_client_) {
     layered_costmap_->ResizeMap((unsigned int) map_width_ / map_resolution_,
                                 (unsigned int) map_height_ / map_resolution_,
                                 map_resolution_,
@@ -129,6 +157,45 @@ CostmapInterface::CostmapInterface(std::string map_name,
   }
 }
 
+CostmapInterface::CostmapInterface(std::string map_name,
+                                   std::string config_file,
+                                   const nav_msgs::OccupancyGridConstPtr &map,
+                                   bool has_inflation_layer) :
+    layered_costmap_(nullptr),
+    name_(map_name),
+    tf_(nullptr),
+    config_file_(config_file),
+    stop_updates_(true),
+    initialized_(true),
+    stopped_(true),
+    robot_stopped_(false),
+    map_update_thread_(NULL),
+    last_publish_(0),
+    dist_behind_robot_threshold_to_care_obstacles_(0.05),
+    is_debug_(false),
+    map_update_thread_shutdown_(true),
+    publish_full_map_(false),
+    last_keyframe_(0),
+    last_diagnostics_(0) {
+  LoadParameter();
+  layered_costmap_ = new CostmapLayers(global_frame_, false, is_track_unknown_);
+  layered_costmap_->SetFilePath(config_file_inflation_);
+  layered_costmap_->SetUpdateThreadNum(update_thread_num_, update_tile_size_);
+  layered_costmap_->SetMaxPyramidEnabled(has_max_pyramid_);
+  // without tf the layers neither subscribe nor wait for anything
+  StaticLayer *plugin_static_layer = new StaticLayer;
+  layered_costmap_->AddPlugin(plugin_static_layer);
+  plugin_static_layer->Initialize(layered_costmap_, map_name + "/" + "static_layer", tf_);
+  plugin_static_layer->SetMap(map);
+  if (has_inflation_layer) {
+    Layer *plugin_inflation_layer = new InflationLayer;
+    layered_costmap_->AddPlugin(plugin_inflation_layer);
+    plugin_inflation_layer->Initialize(layered_costmap_, map_name + "/" + "inflation_layer", tf_);
+  }
+  SetUnpaddedRobotFootprint(footprint_points_);
+  layered_costmap_->UpdateMap(0, 0, 0);
+}
+
 void CostmapInterface::LoadParameter() {
 
   ParaCollection ParaCollectionConfig;
@@ -148,12 +215,23 @@ void CostmapInterface::LoadParameter() {
   is_debug_ = ParaCollectionConfig.para_basic().is_debug();
   is_track_unknown_ = ParaCollectionConfig.para_costmap_interface().is_tracking_unknown();
   has_obstacle_layer_ = ParaCollectionConfig.para_costmap_interface().has_obstacle_layer();
+  has_voxel_layer_ = ParaCollectionConfig.para_costmap_interface().has_voxel_layer();
   has_static_layer_ = ParaCollectionConfig.para_costmap_interface().has_static_layer();
   map_width_ = ParaCollectionConfig.para_costmap_interface().map_width();
   map_height_ = ParaCollectionConfig.para_costmap_interface().map_height();
   map_origin_x_ = ParaCollectionConfig.para_costmap_interface().map_origin_x();
   map_origin_y_ = ParaCollectionConfig.para_costmap_interface().map_origin_y();
   map_resolution_ = ParaCollectionConfig.para_costmap_interface().map_resolution();
+  update_thread_num_ = ParaCollectionConfig.para_costmap_interface().update_thread_num();
+  update_tile_size_ = ParaCollectionConfig.para_costmap_interface().update_tile_size();
+  has_max_pyramid_ = ParaCollectionConfig.para_costmap_interface().has_max_pyramid();
+  shared_costmap_name_ = ParaCollectionConfig.para_costmap_interface().shared_costmap_name();
+  is_shared_costmap_client_ = !shared_costmap_name_.empty()
+      && ParaCollectionConfig.para_costmap_interface().is_shared_costmap_client();
+  double keyframe_frequency = ParaCollectionConfig.para_costmap_interface().map_keyframe_frequency();
+  map_keyframe_period_ = keyframe_frequency > 0 ? 1.0 / keyframe_frequency : 0;
+  double diagnostics_frequency = ParaCollectionConfig.para_costmap_interface().diagnostics_frequency();
+  diagnostics_period_ = diagnostics_frequency > 0 ? 1.0 / diagnostics_frequency : 0;
 
 
   config_file_inflation_ = ros::package::getPath("roborts_costmap") + \
@@ -221,48 +299,141 @@ void CostmapInterface::MapUpdateLoop(double frequency) {
         frequency, r.cycleTime().toSec());
       }
     }
-    double x, y;
-    Costmap2D *temp_costmap = layered_costmap_->GetCostMap();
-    unsigned char *data = temp_costmap->GetCharMap();
-    temp_costmap->Map2World(0, 0, x, y);
+    PublishMap();
+    PublishDiagnostics();
+  }
+}
+
+void CostmapInterface::OnMapSubscribe(const ros::SingleSubscriberPublisher &pub) {
+  publish_full_map_ = true;
+}
+
+void CostmapInterface::PublishMap() {
+  std::shared_ptr<const Costmap2D> costmap = layered_costmap_->GetSnapshot();
+  if (!costmap) {
+    return;
+  }
+  const unsigned char *data = costmap->GetCharMap();
+  const unsigned char *table = reinterpret_cast<const unsigned char *>(cost_translation_table_);
+  const unsigned int size_x = costmap->GetSizeXCell(), size_y = costmap->GetSizeYCell();
+  ros::Time now = ros::Time::now();
+
+  // the rolling window moves its origin with the robot, which an update message can not describe
+  bool geometry_changed = grid_.info.width != size_x || grid_.info.height != size_y
+      || grid_.info.resolution != static_cast<float>(costmap->GetResolution())
+      || grid_.info.origin.position.x != costmap->GetOriginX()
+      || grid_.info.origin.position.y != costmap->GetOriginY();
+  bool keyframe_due = map_keyframe_period_ > 0 && (now - last_keyframe_).toSec() >= map_keyframe_period_;
+
+  if (publish_full_map_.exchange(false) || geometry_changed || keyframe_due) {
     grid_.header.frame_id = global_frame_;
-    grid_.header.stamp = ros::Time::now();
-    if (is_rolling_window_) {
-      grid_.info.resolution = map_resolution_;
-      grid_.info.width = map_width_ / map_resolution_;
-      grid_.info.height = map_height_ / map_resolution_;
-      grid_.info.origin.position.x = x - map_resolution_ * 0.5;
-      grid_.info.origin.position.y = y - map_resolution_ * 0.5;
-      grid_.info.origin.position.z = 0;
-      grid_.info.origin.orientation.w = 1.0;
-      grid_.data.resize(grid_.info.width * grid_.info.height);
-    } else {
-      auto resolution = temp_costmap->GetResolution();
-      auto map_width = temp_costmap->GetSizeXCell();
-      auto map_height = temp_costmap->GetSizeYCell();
-      grid_.info.resolution = resolution;
-      grid_.info.width = map_width;
-      grid_.info.height = map_height;
-      grid_.info.origin.position.x = temp_costmap->GetOriginX();
-      grid_.info.origin.position.y = temp_costmap->GetOriginY();
-      grid_.info.origin.position.z = 0;
-      grid_.info.origin.orientation.w = 1.0;
-      grid_.data.resize(map_width * map_height);
-    }
-    for (size_t i = 0; i < grid_.data.size(); i++) {
-      grid_.data[i] = cost_translation_table_[data[i]];
-    }
+    grid_.header.stamp = now;
+    grid_.info.resolution = costmap->GetResolution();
+    grid_.info.width = size_x;
+    grid_.info.height = size_y;
+    grid_.info.origin.position.x = costmap->GetOriginX();
+    grid_.info.origin.position.y = costmap->GetOriginY();
+    grid_.info.origin.position.z = 0;
+    grid_.info.origin.orientation.w = 1.0;
+    grid_.data.resize(size_x * size_y);
+    simd::TranslateRow(table, data, reinterpret_cast<unsigned char *>(grid_.data.data()), grid_.data.size());
     costmap_pub_.publish(grid_);
+    last_keyframe_ = now;
+    return;
+  }
+
+  // the bounds belong to the update that produced the snapshot, both are written by this thread
+  unsigned int x0, xn, y0, yn;
+  layered_costmap_->GetBounds(&x0, &xn, &y0, &yn);
+  if (xn <= x0 || yn <= y0) {
+    return;
+  }
+  grid_update_.header.frame_id = global_frame_;
+  grid_update_.header.stamp = now;
+  grid_update_.x = x0;
+  grid_update_.y = y0;
+  grid_update_.width = xn - x0;
+  grid_update_.height = yn - y0;
+  grid_update_.data.resize(grid_update_.width * grid_update_.height);
+  unsigned char *update_data = reinterpret_cast<unsigned char *>(grid_update_.data.data());
+  for (unsigned int j = y0; j < yn; ++j) {
+    simd::TranslateRow(table, data + j * size_x + x0, update_data + (j - y0) * grid_update_.width,
+                       grid_update_.width);
+  }
+  costmap_update_pub_.publish(grid_update_);
+}
+
+void CostmapInterface::PublishDiagnostics() {
+  ros::Time now = ros::Time::now();
+  if (diagnostics_period_ <= 0 || (now - last_diagnostics_).toSec() < diagnostics_period_) {
+    return;
+  }
+  last_diagnostics_ = now;
+  CostmapTelemetry telemetry = layered_costmap_->GetTelemetry();
+  if (telemetry.update_num == 0) {
+    return;
+  }
+
+  diagnostics_.header.stamp = now;
+  diagnostics_.status.resize(1);
+  diagnostic_msgs::DiagnosticStatus &status = diagnostics_.status[0];
+  status.name = name_ + ": costmap update";
+  status.hardware_id = name_;
+  double mean_update_time = telemetry.total_update_time / telemetry.update_num;
+  // judge the recent updates only, a slowdown late in a long run barely moves the lifetime mean
+  double recent_update_time = telemetry.update_time_histogram.GetMean();
+  double update_period = map_update_frequency_ > 0 ? 1e6 / map_update_frequency_ : 0;
+  if (update_period > 0 && recent_update_time > update_period) {
+    status.level = diagnostic_msgs::DiagnosticStatus::WARN;
+    status.message = "Recent updates take longer than the update period";
+  } else {
+    status.level = diagnostic_msgs::DiagnosticStatus::OK;
+    status.message = "OK";
+  }
+  status.values.clear();
+  auto add_value = [&status](const std::string &key, double value) {
+    diagnostic_msgs::KeyValue key_value;
+    key_value.key = key;
+    key_value.value = std::to_string(value);
+    status.values.push_back(key_value);
+  };
+  add_value("updates", telemetry.update_num);
+  add_value("update time us", telemetry.update_time);
+  add_value("update time mean us", mean_update_time);
+  add_value("update time recent mean us", recent_update_time);
+  add_value("update time p50 us", telemetry.update_time_histogram.GetPercentile(0.5));
+  add_value("update time p99 us", telemetry.update_time_histogram.GetPercentile(0.99));
+  add_value("bounds area cells", telemetry.bounds_area);
+  add_value("bounds area mean cells", static_cast<double>(telemetry.total_bounds_area) / telemetry.update_num);
+  add_value("bounds area p99 cells", telemetry.bounds_area_histogram.GetPercentile(0.99));
+  for (const LayerTelemetry &layer : telemetry.layers) {
+    add_value(layer.name + " bounds time mean us", layer.total_bounds_time / telemetry.update_num);
+    add_value(layer.name + " costs time mean us", layer.total_costs_time / telemetry.update_num);
+    add_value(layer.name + " time p99 us", layer.time_histogram.GetPercentile(0.99));
   }
+  diagnostics_pub_.publish(diagnostics_);
 }
 
 void CostmapInterface::UpdateMap() {
+  if (shared_costmap_client_) {
+    if (!stop_updates_ && !layered_costmap_->UpdateMapFromShared(*shared_costmap_client_)
+        && !layered_costmap_->IsInitialized()) {
+      ROS_WARN_THROTTLE(5.0, "Waiting for the shared costmap %s", shared_costmap_name_.c_str());
+    }
+    return;
+  }
   if (!stop_updates_) {
     tf::Stamped<tf::Pose> pose;
     if (GetRobotPose(pose)) {
       double x = pose.getOrigin().x(), y = pose.getOrigin().y(), \
  yaw = tf::getYaw(pose.getRotation());
       layered_costmap_->UpdateMap(x, y, yaw);
+      if (shared_costmap_server_) {
+        std::shared_ptr<const Costmap2D> snapshot = layered_costmap_->GetSnapshot();
+        if (snapshot) {
+          shared_costmap_server_->Publish(*snapshot);
+        }
+      }
       geometry_msgs::PolygonStamped footprint;
       footprint.header.frame_id = global_frame_;
       footprint.header.stamp = ros::Time::now();
@@ -312,22 +483,30 @@ void CostmapInterface::Resume() {
 
 void CostmapInterface::ResetLayers() {
   Costmap2D *master = layered_costmap_->GetCostMap();
+  std::unique_lock<Costmap2D::mutex_t> lock(*(master->GetMutex()));
   master->ResetPartMap(0, 0, master->GetSizeXCell(), master->GetSizeYCell());
+  // snapshot readers repairing their state over the changed bounds have to start over as well
+  layered_costmap_->MarkMapReset();
   auto plugins = layered_costmap_->GetPlugins();
   for (auto plugin = (*plugins).begin(); plugin != (*plugins).end(); ++plugin) {
     (*plugin)->Reset();
   }
+  // the next update only covers its own bounds, so subscribers need the whole reset map
+  publish_full_map_ = true;
 }
 
 bool CostmapInterface::GetRobotPose(tf::Stamped<tf::Pose> &global_pose) const {
   global_pose.setIdentity();
+  if (tf_ == nullptr) {
+    return false;
+  }
   tf::Stamped<tf::Pose> robot_pose;
   robot_pose.setIdentity();
   robot_pose.frame_id_ = robot_base_frame_;
   robot_pose.stamp_ = ros::Time();
   ros::Time current_time = ros::Time::now();
   try {
-    tf_.transformPose(global_frame_, robot_pose, global_pose);
+    tf_->transformPose(global_frame_, robot_pose, global_pose);
   }
   catch (tf::LookupException &ex) {
     ROS_ERROR("No Transform Error looking up robot pose: %s", ex.what());
@@ -405,12 +584,15 @@ bool CostmapInterface::GetRobotPose(RobotPose &pose) {
 }
 
 geometry_msgs::PoseStamped CostmapInterface::Pose2GlobalFrame(const geometry_msgs::PoseStamped &pose_msg) {
+  if (tf_ == nullptr) {
+    return pose_msg;
+  }
   tf::Stamped<tf::Pose> tf_pose, global_tf_pose;
   poseStampedMsgToTF(pose_msg, tf_pose);
 
   tf_pose.stamp_ = ros::Time();
   try {
-    tf_.transformPose(global_frame_, tf_pose, global_tf_pose);
+    tf_->transformPose(global_frame_, tf_pose, global_tf_pose);
   }
   catch (tf::TransformException &ex) {
     return pose_msg;
@@ -420,6 +602,18 @@ geometry_msgs::PoseStamped CostmapInterface::Pose2GlobalFrame(const geometry_msg
   return global_pose_msg;
 }
 
+uint64_t CostmapInterface::GetStaticMapHash() const {
+  return layered_costmap_->GetStaticMapHash();
+}
+
+uint64_t CostmapInterface::GetStaticCostMapHash() const {
+  return layered_costmap_->GetStaticCostMapHash();
+}
+
+bool CostmapInterface::GetStaticCostMap(Costmap2D &costmap) const {
+  return layered_costmap_->GetStaticCostMap(costmap);
+}
+
 void CostmapInterface::ClearCostMap() {
   std::vector<Layer *> *plugins = layered_costmap_->GetPlugins();
   tf::Stamped<tf::Pose> pose;
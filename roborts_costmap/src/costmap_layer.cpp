@@ -49,6 +49,7 @@
  *  POSSIBILITY OF SUCH DAMAGE.
  *
  *********************************************************************/
+#include "costmap_simd.h"
 #include "costmap_layer.h"
 
 namespace roborts_costmap {
@@ -90,7 +91,7 @@ void CostmapLayer::UseExtraBounds(double *min_x, double *min_y, double *max_x, d
 }
 
 void CostmapLayer::UpdateOverwriteByMax(Costmap2D &master_grid, int min_i, int min_j, int max_i, int max_j) {
-  if (!is_enabled_)
+  if (!is_enabled_ || max_i <= min_i)
     return;
 
   unsigned char *master_array = master_grid.GetCharMap();
@@ -98,77 +99,43 @@ void CostmapLayer::UpdateOverwriteByMax(Costmap2D &master_grid, int min_i, int m
 
   for (int j = min_j; j < max_j; j++) {
     unsigned int it = j * span + min_i;
-    for (int i = min_i; i < max_i; i++) {
-      if (costmap_[it] == NO_INFORMATION) {
-        it++;
-        continue;
-      }
-
-      unsigned char old_cost = master_array[it];
-      if (old_cost == NO_INFORMATION || old_cost < costmap_[it])
-        master_array[it] = costmap_[it];
-      it++;
-    }
+    simd::MergeRowByMax(master_array + it, costmap_ + it, max_i - min_i);
   }
 }
 
 void CostmapLayer::UpdateOverwriteByAll(Costmap2D &master_grid, int min_i, int min_j, int max_i, int max_j) {
-  if (!is_current_)
+  if (!is_current_ || max_i <= min_i)
     return;
   unsigned char *master = master_grid.GetCharMap();
   unsigned int span = master_grid.GetSizeXCell();
 
   for (int j = min_j; j < max_j; j++) {
     unsigned int it = span * j + min_i;
-    for (int i = min_i; i < max_i; i++) {
-      master[it] = costmap_[it];
-      it++;
-    }
+    simd::MergeRowByAll(master + it, costmap_ + it, max_i - min_i);
   }
 }
 
 void CostmapLayer::UpdateOverwriteByValid(Costmap2D &master_grid, int min_i, int min_j, int max_i, int max_j) {
-  if (!is_enabled_)
+  if (!is_enabled_ || max_i <= min_i)
     return;
   unsigned char *master = master_grid.GetCharMap();
   unsigned int span = master_grid.GetSizeXCell();
 
   for (int j = min_j; j < max_j; j++) {
     unsigned int it = span * j + min_i;
-    for (int i = min_i; i < max_i; i++) {
-      if (costmap_[it] != NO_INFORMATION)
-        master[it] = costmap_[it];
-      it++;
-    }
+    simd::MergeRowByValid(master + it, costmap_ + it, max_i - min_i);
   }
 }
 
 void CostmapLayer::UpdateOverwriteByAdd(Costmap2D &master_grid, int min_i, int min_j, int max_i, int max_j) {
-  if (!is_enabled_)
+  if (!is_enabled_ || max_i <= min_i)
     return;
   unsigned char *master_array = master_grid.GetCharMap();
   unsigned int span = master_grid.GetSizeXCell();
 
   for (int j = min_j; j < max_j; j++) {
     unsigned int it = j * span + min_i;
-    for (int i = min_i; i < max_i; i++) {
-      if (costmap_[it] == NO_INFORMATION) {
-        it++;
-        continue;
-      }
-
-      unsigned char old_cost = master_array[it];
-      if (old_cost == NO_INFORMATION)
-        master_array[it] = costmap_[it];
-      else {
-        int sum = old_cost + costmap_[it];
-        if (sum >= INSCRIBED_INFLATED_OBSTACLE)
-          master_array[it] = INSCRIBED_INFLATED_OBSTACLE - 1;
-        else
-          master_array[it] = sum;
-      }
-      it++;
-    }
+    simd::MergeRowByAdd(master_array + it, costmap_ + it, max_i - min_i);
   }
 }
 
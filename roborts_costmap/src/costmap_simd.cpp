@@ -0,0 +1,463 @@
+/****************************************************************************
+ *  Copyright (C) 2019 RoboMaster.
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program. If not, see <http://www.gnu.org/licenses/>.
+ ***************************************************************************/
+
+#include <cstring>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#include <immintrin.h>
+#define ROBORTS_COSTMAP_AVX2_DISPATCH
+#endif
+#if defined(__ARM_NEON) || defined(__ARM_NEON__)
+#include <arm_neon.h>
+#endif
+
+#include "map_common.h"
+#include "costmap_simd.h"
+
+namespace roborts_costmap {
+namespace simd {
+
+namespace {
+
+const unsigned char kMaxAddCost = INSCRIBED_INFLATED_OBSTACLE - 1;
+
+/*
+ * Scalar kernels, used for the tail of every row and on targets without SIMD.
+ */
+inline unsigned char ValidCell(unsigned char master, unsigned char layer) {
+  return layer == NO_INFORMATION ? master : layer;
+}
+
+inline unsigned char MaxCell(unsigned char master, unsigned char layer) {
+  if (layer == NO_INFORMATION) {
+    return master;
+  }
+  if (master == NO_INFORMATION || master < layer) {
+    return layer;
+  }
+  return master;
+}
+
+inline unsigned char AddCell(unsigned char master, unsigned char layer) {
+  if (layer == NO_INFORMATION) {
+    return master;
+  }
+  if (master == NO_INFORMATION) {
+    return layer;
+  }
+  int sum = master + layer;
+  return sum >= INSCRIBED_INFLATED_OBSTACLE ? kMaxAddCost : sum;
+}
+
+void ScalarValid(unsigned char *master, const unsigned char *layer, size_t num) {
+  for (size_t i = 0; i < num; ++i) {
+    master[i] = ValidCell(master[i], layer[i]);
+  }
+}
+
+void ScalarMax(unsigned char *master, const unsigned char *layer, size_t num) {
+  for (size_t i = 0; i < num; ++i) {
+    master[i] = MaxCell(master[i], layer[i]);
+  }
+}
+
+void ScalarAdd(unsigned char *master, const unsigned char *layer, size_t num) {
+  for (size_t i = 0; i < num; ++i) {
+    master[i] = AddCell(master[i], layer[i]);
+  }
+}
+
+unsigned int ScalarDecay(unsigned char *ttl, unsigned char *cost, size_t num, unsigned char ticks,
+                         unsigned char cleared_cost) {
+  unsigned char expired = 0, alive = 0;
+  for (size_t i = 0; i < num; ++i) {
+    unsigned char left = ttl[i] > ticks ? ttl[i] - ticks : 0;
+    unsigned char expire = (ttl[i] != 0 && left == 0) ? 0xFF : 0;
+    cost[i] = expire ? cleared_cost : cost[i];
+    ttl[i] = left;
+    expired |= expire;
+    alive |= left;
+  }
+  return (expired ? kDecayExpired : 0) | (alive ? kDecayAlive : 0);
+}
+
+void ScalarTranslate(const unsigned char *table, const unsigned char *in, unsigned char *out, size_t num) {
+  for (size_t i = 0; i < num; ++i) {
+    out[i] = table[in[i]];
+  }
+}
+
+/*
+ * SSE2 kernels, 16 cells per step. The unknown cell rule is applied with compare masks:
+ * a known layer cell replaces an unknown master cell, an unknown layer cell keeps the master cell.
+ */
+#if defined(__SSE2__)
+inline __m128i Select128(__m128i mask, __m128i a, __m128i b) {
+  return _mm_or_si128(_mm_and_si128(mask, a), _mm_andnot_si128(mask, b));
+}
+
+void Sse2Valid(unsigned char *master, const unsigned char *layer, size_t num) {
+  const __m128i unknown = _mm_set1_epi8(static_cast<char>(NO_INFORMATION));
+  size_t i = 0;
+  for (; i + 16 <= num; i += 16) {
+    __m128i m = _mm_loadu_si128(reinterpret_cast<const __m128i *>(master + i));
+    __m128i l = _mm_loadu_si128(reinterpret_cast<const __m128i *>(layer + i));
+    __m128i r = Select128(_mm_cmpeq_epi8(l, unknown), m, l);
+    _mm_storeu_si128(reinterpret_cast<__m128i *>(master + i), r);
+  }
+  ScalarValid(master + i, layer + i, num - i);
+}
+
+void Sse2Max(unsigned char *master, const unsigned char *layer, size_t num) {
+  const __m128i unknown = _mm_set1_epi8(static_cast<char>(NO_INFORMATION));
+  size_t i = 0;
+  for (; i + 16 <= num; i += 16) {
+    __m128i m = _mm_loadu_si128(reinterpret_cast<const __m128i *>(master + i));
+    __m128i l = _mm_loadu_si128(reinterpret_cast<const __m128i *>(layer + i));
+    // an unknown master cell counts as free, so the max picks the layer cell
+    __m128i known_m = _mm_andnot_si128(_mm_cmpeq_epi8(m, unknown), m);
+    __m128i r = Select128(_mm_cmpeq_epi8(l, unknown), m, _mm_max_epu8(known_m, l));
+    _mm_storeu_si128(reinterpret_cast<__m128i *>(master + i), r);
+  }
+  ScalarMax(master + i, layer + i, num - i);
+}
+
+void Sse2Add(unsigned char *master, const unsigned char *layer, size_t num) {
+  const __m128i unknown = _mm_set1_epi8(static_cast<char>(NO_INFORMATION));
+  const __m128i max_cost = _mm_set1_epi8(static_cast<char>(kMaxAddCost));
+  size_t i = 0;
+  for (; i + 16 <= num; i += 16) {
+    __m128i m = _mm_loadu_si128(reinterpret_cast<const __m128i *>(master + i));
+    __m128i l = _mm_loadu_si128(reinterpret_cast<const __m128i *>(layer + i));
+    __m128i sum = _mm_min_epu8(_mm_adds_epu8(m, l), max_cost);
+    __m128i r = Select128(_mm_cmpeq_epi8(m, unknown), l, sum);
+    r = Select128(_mm_cmpeq_epi8(l, unknown), m, r);
+    _mm_storeu_si128(reinterpret_cast<__m128i *>(master + i), r);
+  }
+  ScalarAdd(master + i, layer + i, num - i);
+}
+
+unsigned int Sse2Decay(unsigned char *ttl, unsigned char *cost, size_t num, unsigned char ticks,
+                       unsigned char cleared_cost) {
+  const __m128i zero = _mm_setzero_si128();
+  const __m128i step = _mm_set1_epi8(static_cast<char>(ticks));
+  const __m128i cleared = _mm_set1_epi8(static_cast<char>(cleared_cost));
+  __m128i expired = zero, alive = zero;
+  size_t i = 0;
+  for (; i + 16 <= num; i += 16) {
+    __m128i t = _mm_loadu_si128(reinterpret_cast<const __m128i *>(ttl + i));
+    __m128i c = _mm_loadu_si128(reinterpret_cast<const __m128i *>(cost + i));
+    __m128i left = _mm_subs_epu8(t, step);
+    __m128i expire = _mm_andnot_si128(_mm_cmpeq_epi8(t, zero), _mm_cmpeq_epi8(left, zero));
+    _mm_storeu_si128(reinterpret_cast<__m128i *>(cost + i), Select128(expire, cleared, c));
+    _mm_storeu_si128(reinterpret_cast<__m128i *>(ttl + i), left);
+    expired = _mm_or_si128(expired, expire);
+    alive = _mm_or_si128(alive, left);
+  }
+  unsigned int flags = ScalarDecay(ttl + i, cost + i, num - i, ticks, cleared_cost);
+  if (_mm_movemask_epi8(_mm_cmpeq_epi8(expired, zero)) != 0xFFFF) {
+    flags |= kDecayExpired;
+  }
+  if (_mm_movemask_epi8(_mm_cmpeq_epi8(alive, zero)) != 0xFFFF) {
+    flags |= kDecayAlive;
+  }
+  return flags;
+}
+#endif
+
+/*
+ * AVX2 kernels, 32 cells per step. They are compiled for AVX2 regardless of the build flags and only
+ * selected when the CPU reports AVX2 support.
+ */
+#if defined(ROBORTS_COSTMAP_AVX2_DISPATCH)
+__attribute__((target("avx2")))
+void Avx2Valid(unsigned char *master, const unsigned char *layer, size_t num) {
+  const __m256i unknown = _mm256_set1_epi8(static_cast<char>(NO_INFORMATION));
+  size_t i = 0;
+  for (; i + 32 <= num; i += 32) {
+    __m256i m = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(master + i));
+    __m256i l = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(layer + i));
+    __m256i r = _mm256_blendv_epi8(l, m, _mm256_cmpeq_epi8(l, unknown));
+    _mm256_storeu_si256(reinterpret_cast<__m256i *>(master + i), r);
+  }
+  ScalarValid(master + i, layer + i, num - i);
+}
+
+__attribute__((target("avx2")))
+void Avx2Max(unsigned char *master, const unsigned char *layer, size_t num) {
+  const __m256i unknown = _mm256_set1_epi8(static_cast<char>(NO_INFORMATION));
+  size_t i = 0;
+  for (; i + 32 <= num; i += 32) {
+    __m256i m = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(master + i));
+    __m256i l = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(layer + i));
+    __m256i known_m = _mm256_andnot_si256(_mm256_cmpeq_epi8(m, unknown), m);
+    __m256i r = _mm256_blendv_epi8(_mm256_max_epu8(known_m, l), m, _mm256_cmpeq_epi8(l, unknown));
+    _mm256_storeu_si256(reinterpret_cast<__m256i *>(master + i), r);
+  }
+  ScalarMax(master + i, layer + i, num - i);
+}
+
+__attribute__((target("avx2")))
+void Avx2Add(unsigned char *master, const unsigned char *layer, size_t num) {
+  const __m256i unknown = _mm256_set1_epi8(static_cast<char>(NO_INFORMATION));
+  const __m256i max_cost = _mm256_set1_epi8(static_cast<char>(kMaxAddCost));
+  size_t i = 0;
+  for (; i + 32 <= num; i += 32) {
+    __m256i m = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(master + i));
+    __m256i l = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(layer + i));
+    __m256i sum = _mm256_min_epu8(_mm256_adds_epu8(m, l), max_cost);
+    __m256i r = _mm256_blendv_epi8(sum, l, _mm256_cmpeq_epi8(m, unknown));
+    r = _mm256_blendv_epi8(r, m, _mm256_cmpeq_epi8(l, unknown));
+    _mm256_storeu_si256(reinterpret_cast<__m256i *>(master + i), r);
+  }
+  ScalarAdd(master + i, layer + i, num - i);
+}
+
+__attribute__((target("avx2")))
+unsigned int Avx2Decay(unsigned char *ttl, unsigned char *cost, size_t num, unsigned char ticks,
+                       unsigned char cleared_cost) {
+  const __m256i zero = _mm256_setzero_si256();
+  const __m256i step = _mm256_set1_epi8(static_cast<char>(ticks));
+  const __m256i cleared = _mm256_set1_epi8(static_cast<char>(cleared_cost));
+  __m256i expired = zero, alive = zero;
+  size_t i = 0;
+  for (; i + 32 <= num; i += 32) {
+    __m256i t = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(ttl + i));
+    __m256i c = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(cost + i));
+    __m256i left = _mm256_subs_epu8(t, step);
+    __m256i expire = _mm256_andnot_si256(_mm256_cmpeq_epi8(t, zero), _mm256_cmpeq_epi8(left, zero));
+    _mm256_storeu_si256(reinterpret_cast<__m256i *>(cost + i), _mm256_blendv_epi8(c, cleared, expire));
+    _mm256_storeu_si256(reinterpret_cast<__m256i *>(ttl + i), left);
+    expired = _mm256_or_si256(expired, expire);
+    alive = _mm256_or_si256(alive, left);
+  }
+  unsigned int flags = ScalarDecay(ttl + i, cost + i, num - i, ticks, cleared_cost);
+  if (!_mm256_testz_si256(expired, expired)) {
+    flags |= kDecayExpired;
+  }
+  if (!_mm256_testz_si256(alive, alive)) {
+    flags |= kDecayAlive;
+  }
+  return flags;
+}
+
+/*
+ * Table lookup with shuffles, 32 cells per step. The 256 entry table is split into 16 sub tables of 16 entries,
+ * each broadcast to both 128 bit lanes and looked up with one shuffle. For sub table k the index is built so
+ * that cells in [16k, 16k + 15] keep their low nibble with a clear top bit, while every other cell saturates
+ * to an index with the top bit set, which the shuffle turns into zero. OR-ing the 16 lookups gives the result.
+ */
+__attribute__((target("avx2")))
+void Avx2Translate(const unsigned char *table, const unsigned char *in, unsigned char *out, size_t num) {
+  __m256i sub_tables[16];
+  for (int k = 0; k < 16; ++k) {
+    __m128i sub_table = _mm_loadu_si128(reinterpret_cast<const __m128i *>(table + 16 * k));
+    sub_tables[k] = _mm256_broadcastsi128_si256(sub_table);
+  }
+  const __m256i bias = _mm256_set1_epi8(0x70);
+  size_t i = 0;
+  for (; i + 32 <= num; i += 32) {
+    __m256i cells = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(in + i));
+    __m256i r = _mm256_setzero_si256();
+    for (int k = 0; k < 16; ++k) {
+      __m256i block = _mm256_set1_epi8(static_cast<char>(k << 4));
+      __m256i index = _mm256_adds_epu8(_mm256_xor_si256(cells, block), bias);
+      r = _mm256_or_si256(r, _mm256_shuffle_epi8(sub_tables[k], index));
+    }
+    _mm256_storeu_si256(reinterpret_cast<__m256i *>(out + i), r);
+  }
+  ScalarTranslate(table, in + i, out + i, num - i);
+}
+#endif
+
+/*
+ * NEON kernels, 16 cells per step.
+ */
+#if defined(__ARM_NEON) || defined(__ARM_NEON__)
+void NeonValid(unsigned char *master, const unsigned char *layer, size_t num) {
+  const uint8x16_t unknown = vdupq_n_u8(NO_INFORMATION);
+  size_t i = 0;
+  for (; i + 16 <= num; i += 16) {
+    uint8x16_t m = vld1q_u8(master + i);
+    uint8x16_t l = vld1q_u8(layer + i);
+    vst1q_u8(master + i, vbslq_u8(vceqq_u8(l, unknown), m, l));
+  }
+  ScalarValid(master + i, layer + i, num - i);
+}
+
+void NeonMax(unsigned char *master, const unsigned char *layer, size_t num) {
+  const uint8x16_t unknown = vdupq_n_u8(NO_INFORMATION);
+  size_t i = 0;
+  for (; i + 16 <= num; i += 16) {
+    uint8x16_t m = vld1q_u8(master + i);
+    uint8x16_t l = vld1q_u8(layer + i);
+    uint8x16_t known_m = vbicq_u8(m, vceqq_u8(m, unknown));
+    vst1q_u8(master + i, vbslq_u8(vceqq_u8(l, unknown), m, vmaxq_u8(known_m, l)));
+  }
+  ScalarMax(master + i, layer + i, num - i);
+}
+
+void NeonAdd(unsigned char *master, const unsigned char *layer, size_t num) {
+  const uint8x16_t unknown = vdupq_n_u8(NO_INFORMATION);
+  const uint8x16_t max_cost = vdupq_n_u8(kMaxAddCost);
+  size_t i = 0;
+  for (; i + 16 <= num; i += 16) {
+    uint8x16_t m = vld1q_u8(master + i);
+    uint8x16_t l = vld1q_u8(layer + i);
+    uint8x16_t r = vbslq_u8(vceqq_u8(m, unknown), l, vminq_u8(vqaddq_u8(m, l), max_cost));
+    vst1q_u8(master + i, vbslq_u8(vceqq_u8(l, unknown), m, r));
+  }
+  ScalarAdd(master + i, layer + i, num - i);
+}
+
+unsigned int NeonDecay(unsigned char *ttl, unsigned char *cost, size_t num, unsigned char ticks,
+                       unsigned char cleared_cost) {
+  const uint8x16_t zero = vdupq_n_u8(0);
+  const uint8x16_t step = vdupq_n_u8(ticks);
+  const uint8x16_t cleared = vdupq_n_u8(cleared_cost);
+  uint8x16_t expired = zero, alive = zero;
+  size_t i = 0;
+  for (; i + 16 <= num; i += 16) {
+    uint8x16_t t = vld1q_u8(ttl + i);
+    uint8x16_t left = vqsubq_u8(t, step);
+    uint8x16_t expire = vbicq_u8(vceqq_u8(left, zero), vceqq_u8(t, zero));
+    vst1q_u8(cost + i, vbslq_u8(expire, cleared, vld1q_u8(cost + i)));
+    vst1q_u8(ttl + i, left);
+    expired = vorrq_u8(expired, expire);
+    alive = vorrq_u8(alive, left);
+  }
+  unsigned int flags = ScalarDecay(ttl + i, cost + i, num - i, ticks, cleared_cost);
+  uint8x8_t expired_half = vorr_u8(vget_low_u8(expired), vget_high_u8(expired));
+  uint8x8_t alive_half = vorr_u8(vget_low_u8(alive), vget_high_u8(alive));
+  if (vget_lane_u64(vreinterpret_u64_u8(expired_half), 0) != 0) {
+    flags |= kDecayExpired;
+  }
+  if (vget_lane_u64(vreinterpret_u64_u8(alive_half), 0) != 0) {
+    flags |= kDecayAlive;
+  }
+  return flags;
+}
+
+#if defined(__aarch64__)
+inline uint8x16x4_t LoadTable64(const unsigned char *table) {
+  uint8x16x4_t t;
+  t.val[0] = vld1q_u8(table);
+  t.val[1] = vld1q_u8(table + 16);
+  t.val[2] = vld1q_u8(table + 32);
+  t.val[3] = vld1q_u8(table + 48);
+  return t;
+}
+
+// AArch64 looks up 64 table entries per instruction, out of range indices leave the result untouched
+void NeonTranslate(const unsigned char *table, const unsigned char *in, unsigned char *out, size_t num) {
+  const uint8x16x4_t t0 = LoadTable64(table);
+  const uint8x16x4_t t1 = LoadTable64(table + 64);
+  const uint8x16x4_t t2 = LoadTable64(table + 128);
+  const uint8x16x4_t t3 = LoadTable64(table + 192);
+  const uint8x16_t step = vdupq_n_u8(64);
+  size_t i = 0;
+  for (; i + 16 <= num; i += 16) {
+    uint8x16_t index = vld1q_u8(in + i);
+    uint8x16_t r = vqtbl4q_u8(t0, index);
+    index = vsubq_u8(index, step);
+    r = vqtbx4q_u8(r, t1, index);
+    index = vsubq_u8(index, step);
+    r = vqtbx4q_u8(r, t2, index);
+    index = vsubq_u8(index, step);
+    r = vqtbx4q_u8(r, t3, index);
+    vst1q_u8(out + i, r);
+  }
+  ScalarTranslate(table, in + i, out + i, num - i);
+}
+#endif
+#endif
+
+typedef void (*RowKernel)(unsigned char *master, const unsigned char *layer, size_t num);
+typedef void (*TranslateKernel)(const unsigned char *table, const unsigned char *in, unsigned char *out,
+                                size_t num);
+typedef unsigned int (*DecayKernel)(unsigned char *ttl, unsigned char *cost, size_t num, unsigned char ticks,
+                                    unsigned char cleared_cost);
+
+struct Kernels {
+  RowKernel valid;
+  RowKernel max;
+  RowKernel add;
+  TranslateKernel translate;
+  DecayKernel decay;
+  const char *name;
+};
+
+Kernels SelectKernels() {
+#if defined(ROBORTS_COSTMAP_AVX2_DISPATCH)
+  __builtin_cpu_init();
+  if (__builtin_cpu_supports("avx2")) {
+    return Kernels{Avx2Valid, Avx2Max, Avx2Add, Avx2Translate, Avx2Decay, "avx2"};
+  }
+#endif
+#if defined(__SSE2__)
+  // without AVX2 the 16 shuffles per step are no faster than the scalar table lookup
+  return Kernels{Sse2Valid, Sse2Max, Sse2Add, ScalarTranslate, Sse2Decay, "sse2"};
+#elif defined(__aarch64__)
+  return Kernels{NeonValid, NeonMax, NeonAdd, NeonTranslate, NeonDecay, "neon"};
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+  return Kernels{NeonValid, NeonMax, NeonAdd, ScalarTranslate, NeonDecay, "neon"};
+#else
+  return Kernels{ScalarValid, ScalarMax, ScalarAdd, ScalarTranslate, ScalarDecay, "scalar"};
+#endif
+}
+
+const Kernels &GetKernels() {
+  static const Kernels kernels = SelectKernels();
+  return kernels;
+}
+
+} //namespace
+
+void MergeRowByAll(unsigned char *master, const unsigned char *layer, size_t num) {
+  memcpy(master, layer, num);
+}
+
+void MergeRowByValid(unsigned char *master, const unsigned char *layer, size_t num) {
+  GetKernels().valid(master, layer, num);
+}
+
+void MergeRowByMax(unsigned char *master, const unsigned char *layer, size_t num) {
+  GetKernels().max(master, layer, num);
+}
+
+void MergeRowByAdd(unsigned char *master, const unsigned char *layer, size_t num) {
+  GetKernels().add(master, layer, num);
+}
+
+void TranslateRow(const unsigned char *table, const unsigned char *in, unsigned char *out, size_t num) {
+  GetKernels().translate(table, in, out, num);
+}
+
+unsigned int DecayRow(unsigned char *ttl, unsigned char *cost, size_t num, unsigned char ticks,
+                      unsigned char cleared_cost) {
+  return GetKernels().decay(ttl, cost, num, ticks, cleared_cost);
+}
+
+const char *InstructionSet() {
+  return GetKernels().name;
+}
+
+} //namespace simd
+} //namespace roborts_costmap
@@ -76,7 +76,6 @@ InflationLayer::InflationLayer()
 void InflationLayer::OnInitialize() {
 
   std::unique_lock<std::recursive_mutex> lock(*inflation_access_);
-  ros::NodeHandle nh("~/" + name_), g_nh;
   is_current_ = true;
   if (seen_)
     delete[] seen_;
@@ -238,6 +237,144 @@ void InflationLayer::UpdateCosts(Costmap2D &master_grid, int min_i, int min_j, i
   inflation_cells_.clear();
 }
 
+void InflationLayer::InflateMap(Costmap2D &costmap) {
+  std::unique_lock<std::recursive_mutex> lock(*inflation_access_);
+  if (!is_enabled_ || cell_inflation_radius_ == 0) {
+    return;
+  }
+  UpdateCosts(costmap, 0, 0, costmap.GetSizeXCell(), costmap.GetSizeYCell());
+}
+
+uint64_t InflationLayer::HashCosts(uint64_t hash) const {
+  std::unique_lock<std::recursive_mutex> lock(*inflation_access_);
+  bool inflating = is_enabled_ && cell_inflation_radius_ != 0;
+  hash = HashBytes(&inflating, sizeof(inflating), hash);
+  if (!inflating) {
+    return hash;
+  }
+  hash = HashBytes(&cell_inflation_radius_, sizeof(cell_inflation_radius_), hash);
+  hash = HashBytes(&inflate_unknown_, sizeof(inflate_unknown_), hash);
+  for (unsigned int i = 0; i <= cell_inflation_radius_ + 1; ++i) {
+    hash = HashBytes(cached_costs_[i], cell_inflation_radius_ + 2, hash);
+  }
+  return hash;
+}
+
+void InflationLayer::PrepareTiles(Costmap2D &master_grid, int min_i, int min_j, int max_i, int max_j,
+                                  unsigned int thread_num) {
+  std::unique_lock<std::recursive_mutex> lock(*inflation_access_);
+  tile_seeds_.clear();
+  tile_seed_rows_.clear();
+  if (!is_enabled_ || (cell_inflation_radius_ == 0)) {
+    ROS_ERROR("Layer is not enabled or inflation radius is zero");
+    return;
+  }
+  unsigned char *master_array = master_grid.GetCharMap();
+  unsigned int size_x = master_grid.GetSizeXCell(), size_y = master_grid.GetSizeYCell();
+  if (tile_scratch_.size() < thread_num) {
+    tile_scratch_.resize(thread_num);
+  }
+
+  // every cell within the inflation radius of the update boundary may inflate into it
+  min_i = std::max(0, min_i - int(cell_inflation_radius_));
+  min_j = std::max(0, min_j - int(cell_inflation_radius_));
+  max_i = std::min(int(size_x), max_i + int(cell_inflation_radius_));
+  max_j = std::min(int(size_y), max_j + int(cell_inflation_radius_));
+
+  tile_seed_y0_ = min_j;
+  for (int j = min_j; j < max_j; j++) {
+    tile_seed_rows_.push_back(tile_seeds_.size());
+    for (int i = min_i; i < max_i; i++) {
+      int index = master_grid.GetIndex(i, j);
+      if (master_array[index] == LETHAL_OBSTACLE) {
+        tile_seeds_.push_back(CellData(index, i, j, i, j));
+      }
+    }
+  }
+  tile_seed_rows_.push_back(tile_seeds_.size());
+}
+
+void InflationLayer::UpdateCostsTile(Costmap2D &master_grid, int min_i, int min_j, int max_i, int max_j,
+                                     unsigned int thread_index) {
+  if (tile_seed_rows_.empty()) {
+    return;
+  }
+  unsigned char *master_array = master_grid.GetCharMap();
+  unsigned int size_x = master_grid.GetSizeXCell(), size_y = master_grid.GetSizeYCell();
+  TileScratch &scratch = tile_scratch_[thread_index];
+
+  // the tile window holds every cell on the way from a seed to a tile cell, it is the tile grown by the radius
+  int radius = cell_inflation_radius_;
+  unsigned int wx0 = std::max(0, min_i - radius), wy0 = std::max(0, min_j - radius);
+  unsigned int wxn = std::min(int(size_x), max_i + radius), wyn = std::min(int(size_y), max_j + radius);
+  unsigned int window_x = wxn - wx0;
+  size_t window_size = window_x * (wyn - wy0);
+  if (scratch.seen.size() < window_size) {
+    scratch.seen.resize(window_size);
+  }
+  memset(scratch.seen.data(), 0, window_size);
+
+  std::vector<CellData> &obs_bin = scratch.inflation_cells[0.0];
+  for (unsigned int j = wy0; j < wyn; j++) {
+    unsigned int row = j - tile_seed_y0_;
+    for (unsigned int k = tile_seed_rows_[row]; k < tile_seed_rows_[row + 1]; k++) {
+      if (tile_seeds_[k].x_ >= wx0 && tile_seeds_[k].x_ < wxn) {
+        obs_bin.push_back(tile_seeds_[k]);
+      }
+    }
+  }
+
+  // same propagation as UpdateCosts, bounded by the window and writing only the cells inside the tile
+  for (auto bin = scratch.inflation_cells.begin(); bin != scratch.inflation_cells.end(); ++bin) {
+    for (size_t i = 0; i < bin->second.size(); ++i) {
+      const CellData &cell = bin->second[i];
+      unsigned int index = cell.index_;
+      unsigned int mx = cell.x_;
+      unsigned int my = cell.y_;
+      unsigned int sx = cell.src_x_;
+      unsigned int sy = cell.src_y_;
+      unsigned int local_index = (my - wy0) * window_x + (mx - wx0);
+      if (scratch.seen[local_index]) {
+        continue;
+      }
+      scratch.seen[local_index] = 1;
+
+      if (int(mx) >= min_i && int(mx) < max_i && int(my) >= min_j && int(my) < max_j) {
+        unsigned char cost = CostLookup(mx, my, sx, sy);
+        unsigned char old_cost = master_array[index];
+        if (old_cost == NO_INFORMATION
+            && (inflate_unknown_ ? (cost > FREE_SPACE) : (cost >= INSCRIBED_INFLATED_OBSTACLE)))
+          master_array[index] = cost;
+        else
+          master_array[index] = std::max(old_cost, cost);
+      }
+
+      auto enqueue = [&](unsigned int n_index, unsigned int n_local_index, unsigned int nx, unsigned int ny) {
+        if (scratch.seen[n_local_index]) {
+          return;
+        }
+        double distance = DistanceLookup(nx, ny, sx, sy);
+        if (distance > cell_inflation_radius_) {
+          return;
+        }
+        scratch.inflation_cells[distance].push_back(CellData(n_index, nx, ny, sx, sy));
+      };
+      if (mx > wx0)
+        enqueue(index - 1, local_index - 1, mx - 1, my);
+      if (my > wy0)
+        enqueue(index - size_x, local_index - window_x, mx, my - 1);
+      if (mx < wxn - 1)
+        enqueue(index + 1, local_index + 1, mx + 1, my);
+      if (my < wyn - 1)
+        enqueue(index + size_x, local_index + window_x, mx, my + 1);
+    }
+  }
+
+  for (auto &bin : scratch.inflation_cells) {
+    bin.second.clear();
+  }
+}
+
 /**
  * @brief  Given an index of a cell in the costmap, place it into a list pending for obstacle inflation
  * @param  grid The costmap
@@ -50,12 +50,15 @@
  *
  *********************************************************************/
 #include "layered_costmap.h"
+#include "static_layer.h"
+#include "inflation_layer.h"
 
 namespace roborts_costmap {
 
 CostmapLayers::CostmapLayers(std::string global_frame, bool rolling_window, bool track_unknown) : costmap_(), \
                              global_frame_id_(global_frame), is_rolling_window_(rolling_window), is_initialized_(false), \
-                             is_size_locked_(false), file_path_("") {
+                             is_size_locked_(false), file_path_(""), tile_size_(64), \
+                             snapshot_sequence_(0), is_map_reset_(false) {
   if (track_unknown) {
     costmap_.SetDefaultValue(255);
   } else {
@@ -94,6 +97,7 @@ void CostmapLayers::ResizeMap(unsigned int size_x,
 void CostmapLayers::UpdateMap(double robot_x, double robot_y, double robot_yaw) {
   static int count = 0;
   std::unique_lock<Costmap2D::mutex_t> lock(*(costmap_.GetMutex()));
+  const auto update_start = TelemetryClock::now();
   if (is_rolling_window_) {
     double new_origin_x = robot_x - costmap_.GetSizeXWorld() / 2;
     double new_origin_y = robot_y - costmap_.GetSizeYWorld() / 2;
@@ -106,12 +110,15 @@ void CostmapLayers::UpdateMap(double robot_x, double robot_y, double robot_yaw)
 
   minx_ = miny_ = 1e30;
   maxx_ = maxy_ = -1e30;
+  layer_times_.assign(2 * plugins_.size(), 0);
   for (auto plugin = plugins_.begin(); plugin != plugins_.end(); ++plugin) {
     double prev_minx = minx_;
     double prev_miny = miny_;
     double prev_maxx = maxx_;
     double prev_maxy = maxy_;
+    auto start = TelemetryClock::now();
     (*plugin)->UpdateBounds(robot_x, robot_y, robot_yaw, &minx_, &miny_, &maxx_, &maxy_);
+    layer_times_[2 * (plugin - plugins_.begin())] = ElapsedMicroseconds(start);
     count++;
     if (minx_ > prev_minx || miny_ > prev_miny || maxx_ < prev_maxx || maxy_ < prev_maxy) {
       ROS_WARN("Illegal bounds change. The offending layer is %s", (*plugin)->GetName().c_str());
@@ -125,18 +132,240 @@ void CostmapLayers::UpdateMap(double robot_x, double robot_y, double robot_yaw)
   y0 = std::max(0, y0);
   yn = std::min(int(costmap_.GetSizeYCell()), yn + 1);
   if (xn < x0 || yn < y0) {
+    RecordTelemetry(update_start, 0);
     return;
   }
   costmap_.ResetPartMap(x0, y0, xn, yn);
+
+  // layers are applied one after another, a tile parallel layer spreads its own update over the tiles
+  tiles_.clear();
+  if (update_pool_) {
+    for (int j = y0; j < yn; j += tile_size_) {
+      for (int i = x0; i < xn; i += tile_size_) {
+        tiles_.push_back(i);
+        tiles_.push_back(j);
+        tiles_.push_back(std::min(i + tile_size_, xn));
+        tiles_.push_back(std::min(j + tile_size_, yn));
+      }
+    }
+  }
+  const int tile_num = tiles_.size() / 4;
   for (auto plugin = plugins_.begin(); plugin != plugins_.end(); ++plugin) {
-    (*plugin)->UpdateCosts(costmap_, x0, y0, xn, yn);
+    auto start = TelemetryClock::now();
+    if (tile_num > 1 && (*plugin)->IsTileParallel()) {
+      Layer *layer = *plugin;
+      layer->PrepareTiles(costmap_, x0, y0, xn, yn, update_pool_->GetThreadNum());
+      update_pool_->ParallelFor(tile_num, [&](int tile_index, unsigned int thread_index) {
+        const int *tile = &tiles_[4 * tile_index];
+        layer->UpdateCostsTile(costmap_, tile[0], tile[1], tile[2], tile[3], thread_index);
+      });
+    } else {
+      (*plugin)->UpdateCosts(costmap_, x0, y0, xn, yn);
+    }
+    layer_times_[2 * (plugin - plugins_.begin()) + 1] = ElapsedMicroseconds(start);
   }
 
+  costmap_.UpdateMaxPyramid(x0, y0, xn, yn);
   bx0_ = x0;
   bxn_ = xn;
   by0_ = y0;
   byn_ = yn;
   is_initialized_ = true;
+  PublishSnapshot();
+  RecordTelemetry(update_start, static_cast<uint64_t>(xn - x0) * (yn - y0));
+}
+
+double CostmapLayers::ElapsedMicroseconds(TelemetryClock::time_point start) {
+  return std::chrono::duration<double, std::micro>(TelemetryClock::now() - start).count();
+}
+
+void CostmapLayers::RecordTelemetry(TelemetryClock::time_point update_start, uint64_t bounds_area) {
+  double update_time = ElapsedMicroseconds(update_start);
+  std::lock_guard<std::mutex> lock(telemetry_mutex_);
+  if (telemetry_.layers.size() != plugins_.size()) {
+    telemetry_.layers.resize(plugins_.size());
+    for (size_t i = 0; i < plugins_.size(); ++i) {
+      telemetry_.layers[i].name = plugins_[i]->GetName();
+    }
+  }
+  ++telemetry_.update_num;
+  telemetry_.update_time = update_time;
+  telemetry_.total_update_time += update_time;
+  telemetry_.update_time_histogram.Add(update_time);
+  telemetry_.bounds_area = bounds_area;
+  telemetry_.total_bounds_area += bounds_area;
+  telemetry_.bounds_area_histogram.Add(bounds_area);
+  for (size_t i = 0; i < plugins_.size() && 2 * i + 1 < layer_times_.size(); ++i) {
+    LayerTelemetry &layer = telemetry_.layers[i];
+    layer.bounds_time = layer_times_[2 * i];
+    layer.costs_time = layer_times_[2 * i + 1];
+    layer.total_bounds_time += layer.bounds_time;
+    layer.total_costs_time += layer.costs_time;
+    layer.time_histogram.Add(layer.bounds_time + layer.costs_time);
+  }
+}
+
+bool CostmapLayers::UpdateMapFromShared(SharedCostmapClient &client) {
+  std::unique_lock<Costmap2D::mutex_t> lock(*(costmap_.GetMutex()));
+  if (!client.Read(costmap_)) {
+    // nothing changed, so there is no bound to publish
+    bx0_ = bxn_ = by0_ = byn_ = 0;
+    return false;
+  }
+  bx0_ = by0_ = 0;
+  bxn_ = costmap_.GetSizeXCell();
+  byn_ = costmap_.GetSizeYCell();
+  minx_ = costmap_.GetOriginX();
+  miny_ = costmap_.GetOriginY();
+  maxx_ = minx_ + costmap_.GetSizeXCell() * costmap_.GetResolution();
+  maxy_ = miny_ + costmap_.GetSizeYCell() * costmap_.GetResolution();
+  costmap_.UpdateMaxPyramid(bx0_, by0_, bxn_, byn_);
+  is_initialized_ = true;
+  PublishSnapshot();
+  return true;
+}
+
+void CostmapLayers::PublishSnapshot() {
+  // a reader may still hold the spare buffer, in which case it keeps it alive and we take a new one
+  std::shared_ptr<Costmap2D> buffer;
+  if (spare_buffer_ && spare_buffer_.use_count() == 1) {
+    buffer = spare_buffer_;
+  } else {
+    buffer = std::make_shared<Costmap2D>();
+  }
+  *buffer = costmap_;
+
+  SnapshotRecord record;
+  record.x0 = bx0_;
+  record.y0 = by0_;
+  record.xn = bxn_;
+  record.yn = byn_;
+  record.size_x = costmap_.GetSizeXCell();
+  record.size_y = costmap_.GetSizeYCell();
+  record.resolution = costmap_.GetResolution();
+  record.origin_x = costmap_.GetOriginX();
+  record.origin_y = costmap_.GetOriginY();
+  record.is_map_reset = is_map_reset_;
+  is_map_reset_ = false;
+  {
+    std::lock_guard<std::mutex> lock(snapshot_mutex_);
+    record.sequence = ++snapshot_sequence_;
+    snapshot_history_.push_back(record);
+    if (snapshot_history_.size() > kSnapshotHistorySize) {
+      snapshot_history_.pop_front();
+    }
+    std::atomic_store(&snapshot_, std::shared_ptr<const Costmap2D>(buffer));
+  }
+  spare_buffer_ = published_buffer_;
+  published_buffer_ = buffer;
+}
+
+std::shared_ptr<const Costmap2D> CostmapLayers::GetSnapshot(uint64_t since_sequence, SnapshotChanges &changes) const {
+  std::lock_guard<std::mutex> lock(snapshot_mutex_);
+  changes = SnapshotChanges();
+  changes.sequence = snapshot_sequence_;
+  if (since_sequence == 0 || since_sequence > snapshot_sequence_) {
+    return std::atomic_load(&snapshot_);
+  }
+  if (since_sequence == snapshot_sequence_) {
+    changes.is_bounded = true;
+    return std::atomic_load(&snapshot_);
+  }
+  // the bounds only cover the changes if the reader's snapshot is still recorded and the map kept its geometry
+  // and was not reset
+  auto since = snapshot_history_.begin();
+  while (since != snapshot_history_.end() && since->sequence != since_sequence) {
+    ++since;
+  }
+  if (since == snapshot_history_.end()) {
+    return std::atomic_load(&snapshot_);
+  }
+  changes.x0 = since->size_x;
+  changes.y0 = since->size_y;
+  for (auto record = since + 1; record != snapshot_history_.end(); ++record) {
+    if (record->size_x != since->size_x || record->size_y != since->size_y || record->resolution != since->resolution
+        || record->origin_x != since->origin_x || record->origin_y != since->origin_y || record->is_map_reset) {
+      changes = SnapshotChanges();
+      changes.sequence = snapshot_sequence_;
+      return std::atomic_load(&snapshot_);
+    }
+    if (record->xn > record->x0 && record->yn > record->y0) {
+      changes.x0 = std::min(changes.x0, record->x0);
+      changes.y0 = std::min(changes.y0, record->y0);
+      changes.xn = std::max(changes.xn, record->xn);
+      changes.yn = std::max(changes.yn, record->yn);
+    }
+  }
+  if (changes.xn <= changes.x0 || changes.yn <= changes.y0) {
+    changes.x0 = changes.y0 = changes.xn = changes.yn = 0;
+  }
+  changes.is_bounded = true;
+  return std::atomic_load(&snapshot_);
+}
+
+uint64_t CostmapLayers::GetStaticMapHash() const {
+  for (auto plugin : plugins_) {
+    StaticLayer *static_layer = dynamic_cast<StaticLayer *>(plugin);
+    if (static_layer != nullptr) {
+      return static_layer->GetMapHash();
+    }
+  }
+  return 0;
+}
+
+uint64_t CostmapLayers::GetStaticCostMapHash() const {
+  uint64_t hash = GetStaticMapHash();
+  if (hash == 0) {
+    return 0;
+  }
+  for (auto plugin : plugins_) {
+    InflationLayer *inflation_layer = dynamic_cast<InflationLayer *>(plugin);
+    if (inflation_layer != nullptr) {
+      hash = inflation_layer->HashCosts(hash);
+    }
+  }
+  return hash;
+}
+
+bool CostmapLayers::GetStaticCostMap(Costmap2D &costmap) {
+  StaticLayer *static_layer = nullptr;
+  InflationLayer *inflation_layer = nullptr;
+  for (auto plugin : plugins_) {
+    if (dynamic_cast<StaticLayer *>(plugin) != nullptr) {
+      static_layer = dynamic_cast<StaticLayer *>(plugin);
+    } else if (dynamic_cast<InflationLayer *>(plugin) != nullptr) {
+      inflation_layer = dynamic_cast<InflationLayer *>(plugin);
+    }
+  }
+  if (static_layer == nullptr || static_layer->GetMapHash() == 0) {
+    return false;
+  }
+  {
+    std::unique_lock<Costmap2D::mutex_t> lock(*(costmap_.GetMutex()));
+    std::unique_lock<Costmap2D::mutex_t> static_lock(*(static_layer->GetMutex()));
+    if (static_layer->GetSizeXCell() != costmap_.GetSizeXCell()
+        || static_layer->GetSizeYCell() != costmap_.GetSizeYCell()
+        || static_layer->GetResolution() != costmap_.GetResolution()
+        || static_layer->GetOriginX() != costmap_.GetOriginX()
+        || static_layer->GetOriginY() != costmap_.GetOriginY()) {
+      return false;
+    }
+    costmap.ResizeMap(static_layer->GetSizeXCell(), static_layer->GetSizeYCell(), static_layer->GetResolution(),
+                      static_layer->GetOriginX(), static_layer->GetOriginY());
+    // merged into the reset master like the static layer is, which leaves its unknown cells at the default
+    const unsigned char default_value = costmap_.GetDefaultValue();
+    const unsigned char *static_costs = static_layer->GetCharMap();
+    unsigned char *costs = costmap.GetCharMap();
+    costmap.SetDefaultValue(default_value);
+    for (size_t i = 0; i < static_cast<size_t>(costmap.GetSizeXCell()) * costmap.GetSizeYCell(); ++i) {
+      costs[i] = static_costs[i] == NO_INFORMATION ? default_value : static_costs[i];
+    }
+  }
+  // the inflation layer's own update, on the copy instead of the master
+  if (inflation_layer != nullptr) {
+    inflation_layer->InflateMap(costmap);
+  }
+  return true;
 }
 
 void CostmapLayers::SetFootprint(const std::vector<geometry_msgs::Point> &footprint_spec) {
@@ -147,4 +376,19 @@ void CostmapLayers::SetFootprint(const std::vector<geometry_msgs::Point> &footpr
   }
 }
 
+void CostmapLayers::SetUpdateThreadNum(unsigned int thread_num, unsigned int tile_size) {
+  std::unique_lock<Costmap2D::mutex_t> lock(*(costmap_.GetMutex()));
+  if (thread_num > 1) {
+    update_pool_.reset(new roborts_common::ThreadPool(thread_num));
+  } else {
+    update_pool_.reset();
+  }
+  tile_size_ = tile_size > 0 ? tile_size : 64;
+}
+
+void CostmapLayers::SetMaxPyramidEnabled(bool enabled) {
+  std::unique_lock<Costmap2D::mutex_t> lock(*(costmap_.GetMutex()));
+  costmap_.SetMaxPyramidEnabled(enabled);
+}
+
 } //namespace roborts_costmap
\ No newline at end of file
@@ -49,6 +49,7 @@
  *  POSSIBILITY OF SUCH DAMAGE.
  *
  *********************************************************************/
+#include <cmath>
 #include <pcl/point_types.h>
 #include <pcl_ros/transforms.h>
 #include <pcl/conversions.h>
@@ -62,13 +63,23 @@ using namespace tf;
 namespace roborts_costmap {
 ObservationBuffer::ObservationBuffer(string topic_name, double observation_keep_time, double expected_update_rate,
                                      double min_obstacle_height, double max_obstacle_height, double obstacle_range,
-                                     double raytrace_range, TransformListener& tf, string global_frame,
+                                     double raytrace_range, TransformListener* tf, string global_frame,
                                      string sensor_frame, double tf_tolerance) :
     tf_(tf), observation_keep_time_(observation_keep_time), expected_update_rate_(expected_update_rate),
     last_updated_(ros::Time::now()), global_frame_(global_frame), sensor_frame_(sensor_frame), topic_name_(topic_name),
     min_obstacle_height_(min_obstacle_height), max_obstacle_height_(max_obstacle_height),
-    obstacle_range_(obstacle_range), raytrace_range_(raytrace_range), tf_tolerance_(tf_tolerance)
+    obstacle_range_(obstacle_range), raytrace_range_(raytrace_range), tf_tolerance_(tf_tolerance),
+    observation_begin_(0), observation_count_(0), pending_clouds_(kPendingCapacity), pending_begin_(0),
+    pending_count_(0)
 {
+  // enough room for the observations kept at the expected rate, the ring grows if they arrive faster
+  size_t capacity = 1;
+  if (observation_keep_time > 0)
+  {
+    capacity = expected_update_rate > 0
+               ? static_cast<size_t>(std::ceil(observation_keep_time / expected_update_rate)) + 2 : 16;
+  }
+  observations_.resize(capacity);
 }
 
 ObservationBuffer::~ObservationBuffer()
@@ -77,10 +88,15 @@ ObservationBuffer::~ObservationBuffer()
 
 bool ObservationBuffer::SetGlobalFrame(const std::string new_global_frame)
 {
+  if (tf_ == nullptr)
+  {
+    ROS_ERROR("The %s observation buffer has no tf listener to change its global frame.", topic_name_.c_str());
+    return false;
+  }
   ros::Time transform_time = ros::Time::now();
   std::string tf_error;
 
-  if (!tf_.waitForTransform(new_global_frame, global_frame_, transform_time, ros::Duration(tf_tolerance_),
+  if (!tf_->waitForTransform(new_global_frame, global_frame_, transform_time, ros::Duration(tf_tolerance_),
                             ros::Duration(0.01), &tf_error))
   {
     ROS_ERROR("Transform between %s and %s with tolerance %.2f failed: %s.", new_global_frame.c_str(),
@@ -88,12 +104,11 @@ bool ObservationBuffer::SetGlobalFrame(const std::string new_global_frame)
     return false;
   }
 
-  list<Observation>::iterator obs_it;
-  for (obs_it = observation_list_.begin(); obs_it != observation_list_.end(); ++obs_it)
+  for (size_t i = 0; i < observation_count_; ++i)
   {
     try
     {
-      Observation& obs = *obs_it;
+      Observation& obs = observations_[(observation_begin_ + i) % observations_.size()];
 
       geometry_msgs::PointStamped origin;
       origin.header.frame_id = global_frame_;
@@ -101,11 +116,14 @@ bool ObservationBuffer::SetGlobalFrame(const std::string new_global_frame)
       origin.point = obs.origin_;
 
       // we need to transform the origin of the observation to the new global frame
-      tf_.transformPoint(new_global_frame, origin, origin);
+      tf_->transformPoint(new_global_frame, origin, origin);
       obs.origin_ = origin.point;
 
-      // we also need to transform the cloud of the observation to the new global frame
-      pcl_ros::transformPointCloud(new_global_frame, *obs.cloud_, *obs.cloud_, tf_);
+      // we also need to transform the cloud of the observation to the new global frame, readers may still
+      // hold the old cloud so the result goes to a new one
+      std::shared_ptr<pcl::PointCloud<pcl::PointXYZ> > cloud(new pcl::PointCloud<pcl::PointXYZ>());
+      pcl_ros::transformPointCloud(new_global_frame, *obs.cloud_, *cloud, *tf_);
+      obs.cloud_ = cloud;
     }
     catch (TransformException& ex)
     {
@@ -140,109 +158,184 @@ void ObservationBuffer::BufferCloud(const sensor_msgs::PointCloud2& cloud)
 
 void ObservationBuffer::BufferCloud(const pcl::PointCloud<pcl::PointXYZ>& cloud)
 {
-  Stamped < tf::Vector3 > global_origin;
+  // queue the cloud instead of waiting for tf in the sensor callback, the oldest one gives way if tf lags behind
+  if (pending_count_ == pending_clouds_.size())
+  {
+    ROS_WARN("Dropping a %s observation, its transform to %s is not available.", topic_name_.c_str(),
+             global_frame_.c_str());
+    pending_begin_ = (pending_begin_ + 1) % pending_clouds_.size();
+    --pending_count_;
+  }
+  pending_clouds_[(pending_begin_ + pending_count_) % pending_clouds_.size()] = cloud;
+  ++pending_count_;
+  TransformPendingClouds();
+}
 
-  // create a new observation on the list to be populated
-  observation_list_.push_front(Observation());
+void ObservationBuffer::TransformPendingClouds()
+{
+  // clouds are buffered in arrival order, so a cloud waiting for tf holds back the ones after it
+  while (pending_count_ > 0 && TransformCloud(pending_clouds_[pending_begin_]))
+  {
+    pending_begin_ = (pending_begin_ + 1) % pending_clouds_.size();
+    --pending_count_;
+  }
+}
 
+bool ObservationBuffer::TransformCloud(const pcl::PointCloud<pcl::PointXYZ>& cloud)
+{
   // check whether the origin frame has been set explicitly or whether we should get it from the cloud
   string origin_frame = sensor_frame_ == "" ? cloud.header.frame_id : sensor_frame_;
+  ros::Time stamp = pcl_conversions::fromPCL(cloud.header).stamp;
 
-  try
+  if (tf_ == nullptr)
   {
-    // given these observations come from sensors... we'll need to store the origin pt of the sensor
-    Stamped < tf::Vector3 > local_origin(tf::Vector3(0, 0, 0),
-                                         pcl_conversions::fromPCL(cloud.header).stamp, origin_frame);
-    tf_.waitForTransform(global_frame_, local_origin.frame_id_, local_origin.stamp_, ros::Duration(0.5));
-    tf_.transformPoint(global_frame_, local_origin, global_origin);
-    observation_list_.front().origin_.x = global_origin.getX();
-    observation_list_.front().origin_.y = global_origin.getY();
-    observation_list_.front().origin_.z = global_origin.getZ();
-
-    // make sure to pass on the raytrace/obstacle range of the observation buffer to the observations
-    observation_list_.front().raytrace_range_ = raytrace_range_;
-    observation_list_.front().obstacle_range_ = obstacle_range_;
-
-    pcl::PointCloud < pcl::PointXYZ > global_frame_cloud;
-
-    // transform the point cloud
-    pcl_ros::transformPointCloud(global_frame_, cloud, global_frame_cloud, tf_);
-    global_frame_cloud.header.stamp = cloud.header.stamp;
-
-    // now we need to remove observations from the cloud that are below or above our height thresholds
-    pcl::PointCloud < pcl::PointXYZ > &observation_cloud = *(observation_list_.front().cloud_);
-    unsigned int cloud_size = global_frame_cloud.points.size();
-    observation_cloud.points.resize(cloud_size);
-    unsigned int point_count = 0;
-
-    // copy over the points that are within our height bounds
-    for (unsigned int i = 0; i < cloud_size; ++i)
+    ROS_ERROR("The %s observation buffer has no tf listener, dropping an observation in %s.", topic_name_.c_str(),
+              origin_frame.c_str());
+    return true;
+  }
+  if (!tf_->canTransform(global_frame_, origin_frame, stamp)
+      || !tf_->canTransform(global_frame_, cloud.header.frame_id, stamp))
+  {
+    if ((ros::Time::now() - stamp).toSec() <= tf_tolerance_)
     {
-      if (global_frame_cloud.points[i].z <= max_obstacle_height_
-          && global_frame_cloud.points[i].z >= min_obstacle_height_)
-      {
-        observation_cloud.points[point_count++] = global_frame_cloud.points[i];
-      }
+      return false;
     }
+    ROS_WARN("Transform from %s to %s is still not available after %.2f seconds, dropping the %s observation.",
+             origin_frame.c_str(), global_frame_.c_str(), tf_tolerance_, topic_name_.c_str());
+    return true;
+  }
+
+  try
+  {
+    // given these observations come from sensors... we'll need to store the origin pt of the sensor
+    Stamped < tf::Vector3 > local_origin(tf::Vector3(0, 0, 0), stamp, origin_frame);
+    Stamped < tf::Vector3 > global_origin;
+    tf_->transformPoint(global_frame_, local_origin, global_origin);
 
-    // resize the cloud for the number of legal points
-    observation_cloud.points.resize(point_count);
-    observation_cloud.header.stamp = cloud.header.stamp;
-    observation_cloud.header.frame_id = global_frame_cloud.header.frame_id;
+    // transform into the scratch cloud, which keeps its memory from one observation to the next
+    transformed_cloud_.points.clear();
+    pcl_ros::transformPointCloud(global_frame_, cloud, transformed_cloud_, *tf_);
+
+    geometry_msgs::Point origin;
+    origin.x = global_origin.getX();
+    origin.y = global_origin.getY();
+    origin.z = global_origin.getZ();
+    BufferGlobalCloud(origin, transformed_cloud_);
   }
   catch (TransformException& ex)
   {
-    // if an exception occurs, we need to remove the empty observation from the list
-    observation_list_.pop_front();
     ROS_ERROR("TF Exception that should never happen for sensor frame: %s, cloud frame: %s, %s", sensor_frame_.c_str(),
               cloud.header.frame_id.c_str(), ex.what());
-    return;
+    return true;
+  }
+  return true;
+}
+
+void ObservationBuffer::BufferGlobalCloud(const geometry_msgs::Point& origin,
+                                          const pcl::PointCloud<pcl::PointXYZ>& global_cloud)
+{
+  Observation& observation = PushObservation();
+  observation.origin_ = origin;
+
+  // make sure to pass on the raytrace/obstacle range of the observation buffer to the observations
+  observation.raytrace_range_ = raytrace_range_;
+  observation.obstacle_range_ = obstacle_range_;
+
+  // reuse the cloud of the slot unless a reader still holds it
+  std::shared_ptr<pcl::PointCloud<pcl::PointXYZ> > observation_cloud;
+  if (observation.cloud_.use_count() == 1)
+  {
+    observation_cloud = std::const_pointer_cast<pcl::PointCloud<pcl::PointXYZ> >(observation.cloud_);
+  }
+  else
+  {
+    observation_cloud.reset(new pcl::PointCloud<pcl::PointXYZ>());
+  }
+
+  // copy over the points that are within our height bounds
+  observation_cloud->points.clear();
+  for (unsigned int i = 0; i < global_cloud.points.size(); ++i)
+  {
+    if (global_cloud.points[i].z <= max_obstacle_height_ && global_cloud.points[i].z >= min_obstacle_height_)
+    {
+      observation_cloud->points.push_back(global_cloud.points[i]);
+    }
   }
+  observation_cloud->width = observation_cloud->points.size();
+  observation_cloud->height = 1;
+  observation_cloud->header.stamp = global_cloud.header.stamp;
+  observation_cloud->header.frame_id = global_frame_;
+  observation.cloud_ = observation_cloud;
 
   // if the update was successful, we want to update the last updated time
   last_updated_ = ros::Time::now();
 
-  // we'll also remove any stale observations from the list
+  // we'll also remove any stale observations from the ring
   PurgeStaleObservations();
 }
 
-// returns a copy of the observations
+Observation& ObservationBuffer::PushObservation()
+{
+  if (observation_count_ == observations_.size())
+  {
+    if (observation_keep_time_ == ros::Duration(0.0))
+    {
+      // only the latest observation is kept, so the oldest one simply gives way
+      observation_begin_ = (observation_begin_ + 1) % observations_.size();
+      --observation_count_;
+    }
+    else
+    {
+      // the kept observations arrive faster than expected, grow the ring keeping the order
+      std::vector<Observation> observations(2 * observations_.size());
+      for (size_t i = 0; i < observation_count_; ++i)
+      {
+        observations[i] = observations_[(observation_begin_ + i) % observations_.size()];
+      }
+      observations_.swap(observations);
+      observation_begin_ = 0;
+    }
+  }
+  ++observation_count_;
+  return observations_[(observation_begin_ + observation_count_ - 1) % observations_.size()];
+}
+
 void ObservationBuffer::GetObservations(vector<Observation>& observations)
 {
-  // first... let's make sure that we don't have any stale observations
+  // buffer the clouds whose transform has arrived since, then drop the stale observations
+  TransformPendingClouds();
   PurgeStaleObservations();
-  // now we'll just copy the observations for the caller
-  list<Observation>::iterator obs_it;
-  for (obs_it = observation_list_.begin(); obs_it != observation_list_.end(); ++obs_it)
+  // the observations share their clouds, so this copies no points; newest first as the list used to be
+  for (size_t i = observation_count_; i > 0; --i)
   {
-    observations.push_back(*obs_it);
+    observations.push_back(observations_[(observation_begin_ + i - 1) % observations_.size()]);
   }
 }
 
 void ObservationBuffer::PurgeStaleObservations()
 {
-  if (!observation_list_.empty())
+  if (observation_count_ == 0)
   {
-    list<Observation>::iterator obs_it = observation_list_.begin();
-    // if we're keeping observations for no time... then we'll only keep one observation
-    if (observation_keep_time_ == ros::Duration(0.0))
-    {
-      observation_list_.erase(++obs_it, observation_list_.end());
-      return;
-    }
+    return;
+  }
+  // if we're keeping observations for no time... then we'll only keep one observation
+  if (observation_keep_time_ == ros::Duration(0.0))
+  {
+    observation_begin_ = (observation_begin_ + observation_count_ - 1) % observations_.size();
+    observation_count_ = 1;
+    return;
+  }
 
-    // otherwise... we'll have to loop through the observations to see which ones are stale
-    for (obs_it = observation_list_.begin(); obs_it != observation_list_.end(); ++obs_it)
+  // otherwise... the oldest observations go until the first one which is still in time
+  while (observation_count_ > 0)
+  {
+    const Observation& obs = observations_[observation_begin_];
+    if ((last_updated_ - pcl_conversions::fromPCL(obs.cloud_->header).stamp) <= observation_keep_time_)
     {
-      Observation& obs = *obs_it;
-      // check if the observation is out of date... and if it is, remove it and those that follow from the list
-      ros::Duration time_diff = last_updated_ - pcl_conversions::fromPCL(obs.cloud_->header).stamp;
-      if ((last_updated_ - pcl_conversions::fromPCL(obs.cloud_->header).stamp) > observation_keep_time_)
-      {
-        observation_list_.erase(obs_it, observation_list_.end());
-        return;
-      }
+      return;
     }
+    observation_begin_ = (observation_begin_ + 1) % observations_.size();
+    --observation_count_;
   }
 }
 
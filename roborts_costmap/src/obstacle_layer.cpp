@@ -51,11 +51,11 @@
  *********************************************************************/
 #include "obstacle_layer_setting.pb.h"
 #include "obstacle_layer.h"
+#include "costmap_simd.h"
 
 namespace roborts_costmap {
 
 void ObstacleLayer::OnInitialize() {
-  ros::NodeHandle nh;
   ParaObstacleLayer para_obstacle;
 
   std::string obstacle_map = ros::package::getPath("roborts_costmap") + \
@@ -72,6 +72,8 @@ void ObstacleLayer::OnInitialize() {
   raytrace_range = para_obstacle.raytrace_range();
   max_obstacle_height_ = max_obstacle_height;
   footprint_clearing_enabled_ = para_obstacle.footprint_clearing_enabled();
+  SetRaytraceThreadNum(para_obstacle.raytrace_thread_num());
+  double obstacle_decay_time = para_obstacle.obstacle_decay_time();
   std::string topic_string = "LaserScan", sensor_frame = "laser_frame";
   topic_string = para_obstacle.topic_string();
   sensor_frame = para_obstacle.sensor_frame();
@@ -81,6 +83,12 @@ void ObstacleLayer::OnInitialize() {
   clearing = para_obstacle.clearing();
   marking = para_obstacle.marking();
   rolling_window_ = layered_costmap_->IsRollingWindow();
+  // a rolling window forgets cells leaving the window anyway, decay only replaces the periodic reset
+  decay_enabled_ = !rolling_window_ && obstacle_decay_time > 0;
+  if (decay_enabled_) {
+    decay_step_ = std::chrono::duration_cast<std::chrono::system_clock::duration>(
+        std::chrono::duration<double>(obstacle_decay_time / kDecayTtl));
+  }
   bool track_unknown_space = layered_costmap_->IsTrackingUnknown();
   if (track_unknown_space) {
     default_value_ = NO_INFORMATION;
@@ -97,7 +105,7 @@ void ObstacleLayer::OnInitialize() {
                                                                                             max_obstacle_height,
                                                                                             obstacle_range,
                                                                                             raytrace_range,
-                                                                                            *tf_,
+                                                                                            tf_,
                                                                                             global_frame_,
                                                                                             sensor_frame,
                                                                                             transform_tolerance)));
@@ -108,6 +116,12 @@ void ObstacleLayer::OnInitialize() {
     clearing_buffers_.push_back(observation_buffers_.back());
   } 
   reset_time_ = std::chrono::system_clock::now();
+  is_enabled_ = true;
+  if (tf_ == nullptr) {
+    // offline, observations come from AddObservation()
+    return;
+  }
+  ros::NodeHandle nh;
   std::shared_ptr<message_filters::Subscriber<sensor_msgs::LaserScan>
   > sub(new message_filters::Subscriber<sensor_msgs::LaserScan>(nh, topic_string, 50));
   std::shared_ptr<tf::MessageFilter<sensor_msgs::LaserScan>
@@ -126,7 +140,14 @@ void ObstacleLayer::OnInitialize() {
   target_frames.push_back(global_frame_);
   target_frames.push_back(sensor_frame);
   observation_notifiers_.back()->setTargetFrames(target_frames);
-  is_enabled_ = true;
+}
+
+void ObstacleLayer::AddObservation(const geometry_msgs::Point &origin,
+                                   const pcl::PointCloud<pcl::PointXYZ> &cloud) {
+  const std::shared_ptr<ObservationBuffer> &buffer = observation_buffers_.back();
+  buffer->Lock();
+  buffer->BufferGlobalCloud(origin, cloud);
+  buffer->Unlock();
 }
 
 void ObstacleLayer::LaserScanCallback(const sensor_msgs::LaserScanConstPtr &message,
@@ -178,6 +199,8 @@ void ObstacleLayer::UpdateBounds(double robot_x,
                                  double *max_y) {
   if (rolling_window_) {
     UpdateOrigin(robot_x - GetSizeXWorld() / 2, robot_y - GetSizeYWorld() / 2);
+  } else if (decay_enabled_) {
+    DecayObstacles(min_x, min_y, max_x, max_y);
   } else if (std::chrono::duration_cast<std::chrono::seconds>(std::chrono::system_clock::now() - reset_time_) > std::chrono::seconds(2)){
     reset_time_ = std::chrono::system_clock::now();
     ResetMaps();
@@ -199,7 +222,7 @@ void ObstacleLayer::UpdateBounds(double robot_x,
   }
 
   for (std::vector<Observation>::const_iterator it = observations.begin(); it != observations.end(); it++) {
-    const Observation obs = *it;
+    const Observation &obs = *it;
     const pcl::PointCloud<pcl::PointXYZ> &cloud = *(obs.cloud_);
     double sq_obstacle_range = obs.obstacle_range_ * obs.obstacle_range_;
     for (unsigned int i = 0; i < cloud.points.size(); ++i) {
@@ -226,11 +249,68 @@ void ObstacleLayer::UpdateBounds(double robot_x,
       }
       unsigned int index = GetIndex(mx, my);
       costmap_[index] = LETHAL_OBSTACLE;
+      if (decay_enabled_) {
+        decay_ttl_[index] = kDecayTtl;
+        decay_bounds_[0] = std::min(decay_bounds_[0], mx);
+        decay_bounds_[1] = std::min(decay_bounds_[1], my);
+        decay_bounds_[2] = std::max(decay_bounds_[2], mx + 1);
+        decay_bounds_[3] = std::max(decay_bounds_[3], my + 1);
+      }
 
       Touch(px, py, min_x, min_y, max_x, max_y);
     }
   }
   UpdateFootprint(robot_x, robot_y, robot_yaw, min_x, min_y, max_x, max_y);
+  // clear the footprint here rather than in UpdateCosts, which may run on several tiles at once
+  if (footprint_clearing_enabled_) {
+    SetConvexRegionCost(transformed_footprint_, FREE_SPACE);
+  }
+}
+
+void ObstacleLayer::DecayObstacles(double *min_x, double *min_y, double *max_x, double *max_y) {
+  if (decay_ttl_.size() != size_x_ * size_y_) {
+    ResetDecay();
+  }
+  auto now = std::chrono::system_clock::now();
+  auto steps = (now - reset_time_) / decay_step_;
+  if (steps <= 0) {
+    return;
+  }
+  // keep the remainder, so the decay does not depend on the update rate
+  reset_time_ += steps * decay_step_;
+  unsigned char ticks = static_cast<unsigned char>(std::min<decltype(steps)>(steps, kDecayTtl));
+  if (decay_bounds_[2] <= decay_bounds_[0] || decay_bounds_[3] <= decay_bounds_[1]) {
+    return;
+  }
+
+  // only the box around the marked cells is aged, which keeps the cost proportional to what was seen
+  unsigned int flags = 0;
+  unsigned int width = decay_bounds_[2] - decay_bounds_[0];
+  for (unsigned int j = decay_bounds_[1]; j < decay_bounds_[3]; ++j) {
+    unsigned int index = GetIndex(decay_bounds_[0], j);
+    flags |= simd::DecayRow(&decay_ttl_[index], costmap_ + index, width, ticks, default_value_);
+  }
+  if (flags & simd::kDecayExpired) {
+    *min_x = std::min(*min_x, origin_x_ + decay_bounds_[0] * resolution_);
+    *min_y = std::min(*min_y, origin_y_ + decay_bounds_[1] * resolution_);
+    *max_x = std::max(*max_x, origin_x_ + decay_bounds_[2] * resolution_);
+    *max_y = std::max(*max_y, origin_y_ + decay_bounds_[3] * resolution_);
+  }
+  if (!(flags & simd::kDecayAlive)) {
+    decay_bounds_[0] = size_x_;
+    decay_bounds_[1] = size_y_;
+    decay_bounds_[2] = decay_bounds_[3] = 0;
+  }
+}
+
+void ObstacleLayer::ResetDecay() {
+  if (!decay_enabled_) {
+    return;
+  }
+  decay_ttl_.assign(size_x_ * size_y_, 0);
+  decay_bounds_[0] = size_x_;
+  decay_bounds_[1] = size_y_;
+  decay_bounds_[2] = decay_bounds_[3] = 0;
 }
 
 void ObstacleLayer::UpdateCosts(Costmap2D &master_grid, int min_i, int min_j, int max_i, int max_j) {
@@ -239,10 +319,21 @@ void ObstacleLayer::UpdateCosts(Costmap2D &master_grid, int min_i, int min_j, in
     return;
   }
 
-  if (footprint_clearing_enabled_) {
-    SetConvexRegionCost(transformed_footprint_, FREE_SPACE);
+  combination_method_ = 1;
+  UpdateCostsTile(master_grid, min_i, min_j, max_i, max_j, 0);
+}
+
+void ObstacleLayer::PrepareTiles(Costmap2D &master_grid, int min_i, int min_j, int max_i, int max_j,
+                                 unsigned int thread_num) {
+  if (!is_enabled_) {
+    ROS_WARN("Obstacle layer is not enabled");
+    return;
   }
   combination_method_ = 1;
+}
+
+void ObstacleLayer::UpdateCostsTile(Costmap2D &master_grid, int min_i, int min_j, int max_i, int max_j,
+                                    unsigned int thread_index) {
   switch (combination_method_) {
     case 0:  // Overwrite
       UpdateOverwriteByValid(master_grid, min_i, min_j, max_i, max_j);
@@ -278,6 +369,7 @@ void ObstacleLayer::Deactivate() {
 void ObstacleLayer::Reset() {
   Deactivate();
   ResetMaps();
+  ResetDecay();
   is_current_ = true;
   Activate();
 }
@@ -310,6 +402,17 @@ bool ObstacleLayer::GetClearingObservations(std::vector<Observation> &clearing_o
   return current;
 }
 
+void ObstacleLayer::SetRaytraceThreadNum(unsigned int thread_num) {
+  if (thread_num > 1) {
+    raytrace_pool_.reset(new roborts_common::ThreadPool(thread_num));
+  } else {
+    raytrace_pool_.reset();
+  }
+  raytrace_touched_.clear();
+  raytrace_touched_.resize(thread_num > 1 ? thread_num : 0);
+  raytrace_bounds_.resize(thread_num > 1 ? 4 * kRaytraceTaskPerThread * thread_num : 0);
+}
+
 void ObstacleLayer::RaytraceFreespace(const Observation &clearing_observation,
                                       double *min_x,
                                       double *min_y,
@@ -317,23 +420,93 @@ void ObstacleLayer::RaytraceFreespace(const Observation &clearing_observation,
                                       double *max_y) {
   double ox = clearing_observation.origin_.x;
   double oy = clearing_observation.origin_.y;
-  pcl::PointCloud<pcl::PointXYZ> cloud = *(clearing_observation.cloud_);
+  const pcl::PointCloud<pcl::PointXYZ> &cloud = *(clearing_observation.cloud_);
 
   // get the map coordinates of the origin of the sensor
   unsigned int x0, y0;
   if (!World2Map(ox, oy, x0, y0)) {
     return;
   }
+  Touch(ox, oy, min_x, min_y, max_x, max_y);
+
+  const size_t beam_num = cloud.points.size();
+  const unsigned int thread_num = raytrace_pool_ ? raytrace_pool_->GetThreadNum() : 1;
+  if (thread_num == 1 || beam_num < 2 * thread_num) {
+    MarkCell marker(costmap_, FREE_SPACE);
+    RaytraceBeams(clearing_observation, 0, beam_num, x0, y0, marker, min_x, min_y, max_x, max_y);
+    return;
+  }
+
+  // every cell a beam can clear lies in the window of raytrace range around the sensor cell,
+  // so the touched buffers only cover those rows, with the same row stride as the map
+  unsigned int cell_raytrace_range = World2Cell(clearing_observation.raytrace_range_);
+  unsigned int win_x0 = x0 > cell_raytrace_range ? x0 - cell_raytrace_range : 0;
+  unsigned int win_y0 = y0 > cell_raytrace_range ? y0 - cell_raytrace_range : 0;
+  unsigned int win_xn = std::min(size_x_, x0 + cell_raytrace_range + 1);
+  unsigned int win_yn = std::min(size_y_, y0 + cell_raytrace_range + 1);
+  unsigned int base_offset = win_y0 * size_x_;
+  size_t window_size = (win_yn - win_y0) * size_x_;
+  for (auto &touched : raytrace_touched_) {
+    if (touched.size() < window_size) {
+      touched.assign(window_size, 0);
+    }
+  }
+
+  // beams are split into contiguous blocks, bounds are kept per block and merged in block order
+  const int task_num = kRaytraceTaskPerThread * thread_num;
+  raytrace_pool_->ParallelFor(task_num, [&](int task_index, unsigned int thread_index) {
+    size_t begin = beam_num * task_index / task_num;
+    size_t end = beam_num * (task_index + 1) / task_num;
+    double *bounds = &raytrace_bounds_[4 * task_index];
+    bounds[0] = bounds[1] = std::numeric_limits<double>::max();
+    bounds[2] = bounds[3] = -std::numeric_limits<double>::max();
+    TouchCell toucher(raytrace_touched_[thread_index].data(), base_offset);
+    RaytraceBeams(clearing_observation, begin, end, x0, y0, toucher, &bounds[0], &bounds[1], &bounds[2], &bounds[3]);
+  });
+
+  for (int i = 0; i < task_num; ++i) {
+    *min_x = std::min(*min_x, raytrace_bounds_[4 * i]);
+    *min_y = std::min(*min_y, raytrace_bounds_[4 * i + 1]);
+    *max_x = std::max(*max_x, raytrace_bounds_[4 * i + 2]);
+    *max_y = std::max(*max_y, raytrace_bounds_[4 * i + 3]);
+  }
+
+  // merge the touched buffers into the layer and clear them for the next observation
+  for (auto &thread_touched : raytrace_touched_) {
+    for (unsigned int y = win_y0; y < win_yn; ++y) {
+      unsigned char *touched_row = thread_touched.data() + (y - win_y0) * size_x_;
+      unsigned char *cost_row = costmap_ + y * size_x_;
+      for (unsigned int x = win_x0; x < win_xn; ++x) {
+        cost_row[x] = touched_row[x] ? FREE_SPACE : cost_row[x];
+        touched_row[x] = 0;
+      }
+    }
+  }
+}
+
+template<typename ActionType>
+void ObstacleLayer::RaytraceBeams(const Observation &clearing_observation,
+                                  size_t begin,
+                                  size_t end,
+                                  unsigned int x0,
+                                  unsigned int y0,
+                                  ActionType at,
+                                  double *min_x,
+                                  double *min_y,
+                                  double *max_x,
+                                  double *max_y) {
+  double ox = clearing_observation.origin_.x;
+  double oy = clearing_observation.origin_.y;
+  const pcl::PointCloud<pcl::PointXYZ> &cloud = *(clearing_observation.cloud_);
 
   // we can pre-compute the enpoints of the map outside of the inner loop... we'll need these later
   double origin_x = origin_x_, origin_y = origin_y_;
   double map_end_x = origin_x + size_x_ * resolution_;
   double map_end_y = origin_y + size_y_ * resolution_;
-
-  Touch(ox, oy, min_x, min_y, max_x, max_y);
+  unsigned int cell_raytrace_range = World2Cell(clearing_observation.raytrace_range_);
 
   // for each point in the cloud, we want to trace a line from the origin and clear obstacles along it
-  for (unsigned int i = 0; i < cloud.points.size(); ++i) {
+  for (size_t i = begin; i < end; ++i) {
     double wx = cloud.points[i].x;
     double wy = cloud.points[i].y;
 
@@ -373,10 +546,8 @@ void ObstacleLayer::RaytraceFreespace(const Observation &clearing_observation,
     if (!World2Map(wx, wy, x1, y1))
       continue;
 
-    unsigned int cell_raytrace_range = World2Cell(clearing_observation.raytrace_range_);
-    MarkCell marker(costmap_, FREE_SPACE);
     // and finally... we can execute our trace to clear obstacles along that line
-    RaytraceLine(marker, x0, y0, x1, y1, cell_raytrace_range);
+    RaytraceLine(at, x0, y0, x1, y1, cell_raytrace_range);
 
     UpdateRaytraceBounds(ox, oy, wx, wy, clearing_observation.raytrace_range_, min_x, min_y, max_x, max_y);
   }
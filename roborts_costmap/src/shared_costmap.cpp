@@ -0,0 +1,235 @@
+/****************************************************************************
+ *  Copyright (C) 2019 RoboMaster.
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program. If not, see <http://www.gnu.org/licenses/>.
+ ***************************************************************************/
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <cstring>
+#include <new>
+#include <ros/console.h>
+
+#include "shared_costmap.h"
+
+namespace roborts_costmap {
+
+namespace {
+
+const char kSharedCostmapMagic[8] = {'R', 'M', 'S', 'H', 'C', 'O', 'S', 'T'};
+const uint32_t kSharedCostmapVersion = 1;
+//! Cost data starts at this offset, a cache line after the region start
+const size_t kDataOffset = (sizeof(SharedCostmapHeader) + 63) / 64 * 64;
+
+std::string RegionName(const std::string &name) {
+  return name.empty() || name[0] == '/' ? name : "/" + name;
+}
+
+} //namespace
+
+SharedCostmapServer::SharedCostmapServer(const std::string &name) :
+    name_(RegionName(name)), header_(nullptr), region_size_(0) {}
+
+SharedCostmapServer::~SharedCostmapServer() {
+  Close();
+}
+
+bool SharedCostmapServer::Create(size_t capacity) {
+  // readers still mapping a replaced region see it retired and open the new one by name
+  shm_unlink(name_.c_str());
+  int fd = shm_open(name_.c_str(), O_RDWR | O_CREAT | O_EXCL, 0644);
+  if (fd < 0) {
+    ROS_ERROR("Failed to create the shared costmap %s", name_.c_str());
+    return false;
+  }
+  size_t region_size = kDataOffset + capacity;
+  void *region = MAP_FAILED;
+  if (ftruncate(fd, region_size) == 0) {
+    region = mmap(nullptr, region_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+  }
+  close(fd);
+  if (region == MAP_FAILED) {
+    ROS_ERROR("Failed to map the shared costmap %s", name_.c_str());
+    shm_unlink(name_.c_str());
+    return false;
+  }
+  header_ = new(region) SharedCostmapHeader();
+  memcpy(header_->magic, kSharedCostmapMagic, sizeof(kSharedCostmapMagic));
+  header_->version = kSharedCostmapVersion;
+  header_->capacity = capacity;
+  header_->size_x = header_->size_y = 0;
+  header_->retired.store(0, std::memory_order_relaxed);
+  header_->sequence.store(0, std::memory_order_release);
+  region_size_ = region_size;
+  return true;
+}
+
+void SharedCostmapServer::Close() {
+  if (header_ != nullptr) {
+    header_->retired.store(1, std::memory_order_release);
+    munmap(header_, region_size_);
+    shm_unlink(name_.c_str());
+    header_ = nullptr;
+  }
+}
+
+bool SharedCostmapServer::Publish(const Costmap2D &map) {
+  size_t cell_num = static_cast<size_t>(map.GetSizeXCell()) * map.GetSizeYCell();
+  if (header_ == nullptr || header_->capacity < cell_num) {
+    Close();
+    if (!Create(cell_num)) {
+      return false;
+    }
+  }
+  uint32_t sequence = header_->sequence.load(std::memory_order_relaxed);
+  header_->sequence.store(sequence + 1, std::memory_order_relaxed);
+  std::atomic_thread_fence(std::memory_order_release);
+  header_->size_x = map.GetSizeXCell();
+  header_->size_y = map.GetSizeYCell();
+  header_->default_value = map.GetDefaultValue();
+  header_->resolution = map.GetResolution();
+  header_->origin_x = map.GetOriginX();
+  header_->origin_y = map.GetOriginY();
+  memcpy(reinterpret_cast<unsigned char *>(header_) + kDataOffset, map.GetCharMap(), cell_num);
+  header_->sequence.store(sequence + 2, std::memory_order_release);
+  return true;
+}
+
+const int SharedCostmapClient::kMaxReadAttempts;
+const unsigned int SharedCostmapClient::kRegionCheckPeriod;
+const double SharedCostmapClient::kStaleTimeout = 2.0;
+
+SharedCostmapClient::SharedCostmapClient(const std::string &name) :
+    name_(RegionName(name)), header_(nullptr), region_size_(0), region_dev_(0), region_ino_(0), sequence_(0),
+    failed_read_num_(0), is_stale_(false) {}
+
+SharedCostmapClient::~SharedCostmapClient() {
+  Close();
+}
+
+bool SharedCostmapClient::Open() {
+  int fd = shm_open(name_.c_str(), O_RDONLY, 0);
+  if (fd < 0) {
+    return false;
+  }
+  struct stat region_stat;
+  void *region = MAP_FAILED;
+  if (fstat(fd, &region_stat) == 0 && region_stat.st_size >= static_cast<off_t>(kDataOffset)) {
+    region = mmap(nullptr, region_stat.st_size, PROT_READ, MAP_SHARED, fd, 0);
+  }
+  close(fd);
+  if (region == MAP_FAILED) {
+    return false;
+  }
+  const SharedCostmapHeader *header = static_cast<const SharedCostmapHeader *>(region);
+  if (memcmp(header->magic, kSharedCostmapMagic, sizeof(kSharedCostmapMagic)) != 0
+      || header->version != kSharedCostmapVersion
+      || static_cast<size_t>(region_stat.st_size) < kDataOffset + header->capacity) {
+    munmap(region, region_stat.st_size);
+    return false;
+  }
+  header_ = header;
+  region_size_ = region_stat.st_size;
+  region_dev_ = region_stat.st_dev;
+  region_ino_ = region_stat.st_ino;
+  sequence_ = 0;
+  failed_read_num_ = 0;
+  return true;
+}
+
+void SharedCostmapClient::Close() {
+  if (header_ != nullptr) {
+    munmap(const_cast<SharedCostmapHeader *>(header_), region_size_);
+    header_ = nullptr;
+  }
+}
+
+bool SharedCostmapClient::IsRegionReplaced() const {
+  int fd = shm_open(name_.c_str(), O_RDONLY, 0);
+  if (fd < 0) {
+    // no server at the moment, keep the mapped region until a new one shows up
+    return false;
+  }
+  struct stat region_stat;
+  bool is_replaced = fstat(fd, &region_stat) == 0
+      && (region_stat.st_dev != region_dev_ || region_stat.st_ino != region_ino_);
+  close(fd);
+  return is_replaced;
+}
+
+bool SharedCostmapClient::Read(Costmap2D &map) {
+  if (header_ != nullptr && header_->retired.load(std::memory_order_acquire)) {
+    Close();
+  } else if (header_ != nullptr && failed_read_num_ >= kRegionCheckPeriod) {
+    failed_read_num_ = 0;
+    if (IsRegionReplaced()) {
+      ROS_WARN("The shared costmap %s was replaced by a new server, opening it again", name_.c_str());
+      Close();
+    }
+  }
+  if ((header_ != nullptr || Open()) && CopyVersion(map)) {
+    failed_read_num_ = 0;
+    last_version_time_ = std::chrono::steady_clock::now();
+    if (is_stale_) {
+      ROS_INFO("The shared costmap %s is updated again", name_.c_str());
+      is_stale_ = false;
+    }
+    return true;
+  }
+  ++failed_read_num_;
+  if (!is_stale_ && last_version_time_ != std::chrono::steady_clock::time_point()
+      && std::chrono::steady_clock::now() - last_version_time_ > std::chrono::duration<double>(kStaleTimeout)) {
+    ROS_WARN("No new version of the shared costmap %s for %.1f s, the costmap is stale", name_.c_str(),
+             kStaleTimeout);
+    is_stale_ = true;
+  }
+  return false;
+}
+
+bool SharedCostmapClient::CopyVersion(Costmap2D &map) {
+  const unsigned char *data = reinterpret_cast<const unsigned char *>(header_) + kDataOffset;
+  for (int attempt = 0; attempt < kMaxReadAttempts; ++attempt) {
+    uint32_t sequence = header_->sequence.load(std::memory_order_acquire);
+    if (sequence == sequence_) {
+      return false;
+    }
+    if (sequence & 1) {
+      sched_yield();
+      continue;
+    }
+    unsigned int size_x = header_->size_x, size_y = header_->size_y;
+    double resolution = header_->resolution, origin_x = header_->origin_x, origin_y = header_->origin_y;
+    unsigned char default_value = header_->default_value;
+    if (static_cast<size_t>(size_x) * size_y > header_->capacity) {
+      continue;
+    }
+    if (map.GetSizeXCell() != size_x || map.GetSizeYCell() != size_y || map.GetResolution() != resolution
+        || map.GetOriginX() != origin_x || map.GetOriginY() != origin_y) {
+      map.ResizeMap(size_x, size_y, resolution, origin_x, origin_y);
+    }
+    map.SetDefaultValue(default_value);
+    memcpy(map.GetCharMap(), data, static_cast<size_t>(size_x) * size_y);
+    // the copy only counts if the writer did not start another version meanwhile
+    std::atomic_thread_fence(std::memory_order_acquire);
+    if (header_->sequence.load(std::memory_order_relaxed) == sequence) {
+      sequence_ = sequence;
+      return true;
+    }
+  }
+  return false;
+}
+
+} //namespace roborts_costmap
@@ -49,13 +49,74 @@
  *  POSSIBILITY OF SUCH DAMAGE.
  *
  *********************************************************************/
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+
 #include "static_layer_setting.pb.h"
 #include "static_layer.h"
+#include "costmap_simd.h"
 
 namespace roborts_costmap {
 
+namespace {
+
+const char kMapCacheMagic[8] = {'R', 'M', 'S', 'T', 'M', 'A', 'P', 'C'};
+const uint32_t kMapCacheVersion = 1;
+
+/**
+ * @brief Layout of the static map cache file. The header is followed by the map frame id and the
+ *        interpreted costs, row by row.
+ */
+struct MapCacheHeader {
+  char magic[8];
+  uint32_t version;
+  uint32_t size_x, size_y;
+  uint32_t frame_length;
+  double resolution, origin_x, origin_y;
+  //! Hash of the interpretation table, which covers every parameter the costs depend on
+  uint64_t table_hash;
+  //! Hash of the map message the costs were interpreted from
+  uint64_t map_hash;
+};
+
+/**
+ * @brief Clip [lo, hi) to the positions t along a row with 0 <= origin + slope * t < size.
+ */
+void ClipSpan(double origin, double slope, double size, double &lo, double &hi) {
+  if (slope == 0) {
+    if (origin < 0 || origin >= size) {
+      hi = lo;
+    }
+    return;
+  }
+  double t0 = -origin / slope, t1 = (size - origin) / slope;
+  if (slope < 0) {
+    std::swap(t0, t1);
+  }
+  lo = std::max(lo, t0);
+  hi = std::min(hi, t1);
+}
+
+} //namespace
+
+uint64_t StaticLayer::HashMap(const nav_msgs::OccupancyGrid &map) {
+  uint32_t size[2] = {map.info.width, map.info.height};
+  double origin[2] = {map.info.origin.position.x, map.info.origin.position.y};
+  float resolution = map.info.resolution;
+  uint64_t hash = HashBytes(size, sizeof(size));
+  hash = HashBytes(&resolution, sizeof(resolution), hash);
+  hash = HashBytes(origin, sizeof(origin), hash);
+  hash = HashBytes(map.header.frame_id.data(), map.header.frame_id.size(), hash);
+  return HashBytes(map.data.data(), map.data.size(), hash);
+}
+
 void StaticLayer::OnInitialize() {
-  ros::NodeHandle nh;
   is_current_ = true;
   ParaStaticLayer para_static_layer;
 
@@ -74,11 +135,22 @@ void StaticLayer::OnInitialize() {
   map_received_ = false;
   bool is_debug_ = para_static_layer.is_debug();
   map_topic_ = para_static_layer.topic_name();
-  map_sub_ = nh.subscribe(map_topic_.c_str(), 1, &StaticLayer::InComingMap, this);
-  ros::Rate temp_rate(10);
-  while(!map_received_) {
-    ros::spinOnce();
-    temp_rate.sleep();
+  map_cache_path_ = para_static_layer.map_cache_path();
+  map_hash_ = 0;
+  BuildInterpretTable();
+  // start from the cache if there is one, the map message replaces it later if the map has changed
+  if (!map_cache_path_.empty() && LoadMapCache()) {
+    ROS_INFO("Static layer loaded from the map cache %s", map_cache_path_.c_str());
+  }
+  // offline, the map comes from SetMap()
+  if (tf_ != nullptr) {
+    ros::NodeHandle nh;
+    map_sub_ = nh.subscribe(map_topic_.c_str(), 1, &StaticLayer::InComingMap, this);
+    ros::Rate temp_rate(10);
+    while(!map_received_) {
+      ros::spinOnce();
+      temp_rate.sleep();
+    }
   }
   staic_layer_x_ = staic_layer_y_ = 0;
   width_ = size_x_;
@@ -96,39 +168,45 @@ void StaticLayer::MatchSize() {
 }
 
 void StaticLayer::InComingMap(const nav_msgs::OccupancyGridConstPtr &new_map) {
-  unsigned int temp_index = 0;
-  unsigned char value = 0;
-  unsigned int size_x = new_map->info.width, size_y = new_map->info.height;
-  auto resolution = new_map->info.resolution;
-  auto origin_x = new_map->info.origin.position.x;
-  auto origin_y = new_map->info.origin.position.y;
-  auto master_map = layered_costmap_->GetCostMap();
-  if(!layered_costmap_->IsRolling() && (master_map->GetSizeXCell() != size_x || master_map->GetSizeYCell() != size_y ||
-      master_map->GetResolution() != resolution || master_map->GetOriginX() != origin_x || master_map->GetOriginY() != origin_y ||
-      !layered_costmap_->IsSizeLocked())) {
-    layered_costmap_->ResizeMap(size_x, size_y, resolution, origin_x, origin_y, true);
-  } else if(size_x_ != size_x || size_y_ != size_y || resolution_ != resolution || origin_x_ != origin_x || origin_y_ != origin_y) {
-    ResizeMap(size_x, size_y, resolution, origin_x, origin_y);
-  }
-
-  for (auto i = 0; i < size_y; i++) {
-    for (auto j = 0; j < size_x; j++) {
-      value = new_map->data[temp_index];
-      costmap_[temp_index] = InterpretValue(value);
-      ++temp_index;
+  uint64_t map_hash = HashMap(*new_map);
+  if (map_received_ && map_hash == map_hash_) {
+    // the same map as the cache or the previous message, nothing to reinterpret
+    if (first_map_only_) {
+      map_sub_.shutdown();
     }
+    return;
   }
+  MatchMapGeometry(new_map->info.width, new_map->info.height, new_map->info.resolution,
+                   new_map->info.origin.position.x, new_map->info.origin.position.y);
+  simd::TranslateRow(interpret_table_, reinterpret_cast<const unsigned char *>(new_map->data.data()), costmap_,
+                     std::min<size_t>(new_map->data.size(), size_x_ * size_y_));
   map_received_ = true;
   has_updated_data_ = true;
+  map_hash_ = map_hash;
   map_frame_ = new_map->header.frame_id;
   staic_layer_x_ = staic_layer_y_ = 0;
   width_ = size_x_;
   height_ = size_y_;
+  if (!map_cache_path_.empty()) {
+    SaveMapCache();
+  }
   if (first_map_only_) {
     map_sub_.shutdown();
   }
 }
 
+void StaticLayer::MatchMapGeometry(unsigned int size_x, unsigned int size_y, double resolution, double origin_x,
+                                   double origin_y) {
+  auto master_map = layered_costmap_->GetCostMap();
+  if(!layered_costmap_->IsRolling() && (master_map->GetSizeXCell() != size_x || master_map->GetSizeYCell() != size_y ||
+      master_map->GetResolution() != resolution || master_map->GetOriginX() != origin_x || master_map->GetOriginY() != origin_y ||
+      !layered_costmap_->IsSizeLocked())) {
+    layered_costmap_->ResizeMap(size_x, size_y, resolution, origin_x, origin_y, true);
+  } else if(size_x_ != size_x || size_y_ != size_y || resolution_ != resolution || origin_x_ != origin_x || origin_y_ != origin_y) {
+    ResizeMap(size_x, size_y, resolution, origin_x, origin_y);
+  }
+}
+
 unsigned char StaticLayer::InterpretValue(unsigned char value) {
   // check if the static value is above the unknown or lethal thresholds
   if (track_unknown_space_ && value == unknown_cost_value_)
@@ -144,6 +222,73 @@ unsigned char StaticLayer::InterpretValue(unsigned char value) {
   return scale * LETHAL_OBSTACLE;
 }
 
+void StaticLayer::BuildInterpretTable() {
+  for (int value = 0; value < 256; ++value) {
+    interpret_table_[value] = InterpretValue(value);
+  }
+}
+
+bool StaticLayer::LoadMapCache() {
+  int fd = open(map_cache_path_.c_str(), O_RDONLY);
+  if (fd < 0) {
+    return false;
+  }
+  struct stat file_stat;
+  if (fstat(fd, &file_stat) != 0 || file_stat.st_size < static_cast<off_t>(sizeof(MapCacheHeader))) {
+    close(fd);
+    return false;
+  }
+  size_t file_size = file_stat.st_size;
+  void *file = mmap(nullptr, file_size, PROT_READ, MAP_PRIVATE, fd, 0);
+  close(fd);
+  if (file == MAP_FAILED) {
+    return false;
+  }
+
+  const MapCacheHeader *header = static_cast<const MapCacheHeader *>(file);
+  const char *frame = static_cast<const char *>(file) + sizeof(MapCacheHeader);
+  size_t data_size = static_cast<size_t>(header->size_x) * header->size_y;
+  bool valid = memcmp(header->magic, kMapCacheMagic, sizeof(kMapCacheMagic)) == 0
+      && header->version == kMapCacheVersion
+      && header->table_hash == HashBytes(interpret_table_, sizeof(interpret_table_))
+      && file_size == sizeof(MapCacheHeader) + header->frame_length + data_size;
+  if (valid) {
+    MatchMapGeometry(header->size_x, header->size_y, header->resolution, header->origin_x, header->origin_y);
+    memcpy(costmap_, frame + header->frame_length, data_size);
+    map_frame_.assign(frame, header->frame_length);
+    map_hash_ = header->map_hash;
+    map_received_ = true;
+    has_updated_data_ = true;
+    staic_layer_x_ = staic_layer_y_ = 0;
+    width_ = size_x_;
+    height_ = size_y_;
+  } else {
+    ROS_WARN("Map cache %s is outdated, waiting for the map", map_cache_path_.c_str());
+  }
+  munmap(file, file_size);
+  return valid;
+}
+
+void StaticLayer::SaveMapCache() {
+  MapCacheHeader header;
+  memcpy(header.magic, kMapCacheMagic, sizeof(kMapCacheMagic));
+  header.version = kMapCacheVersion;
+  header.size_x = size_x_;
+  header.size_y = size_y_;
+  header.frame_length = map_frame_.size();
+  header.resolution = resolution_;
+  header.origin_x = origin_x_;
+  header.origin_y = origin_y_;
+  header.table_hash = HashBytes(interpret_table_, sizeof(interpret_table_));
+  header.map_hash = map_hash_;
+
+  if (!WriteFileAtomically(map_cache_path_, {{&header, sizeof(header)},
+                                              {map_frame_.data(), map_frame_.size()},
+                                              {costmap_, size_x_ * size_y_}})) {
+    ROS_WARN("Failed to write the map cache %s", map_cache_path_.c_str());
+  }
+}
+
 void StaticLayer::Activate() {
   OnInitialize();
 }
@@ -187,9 +332,70 @@ void StaticLayer::UpdateBounds(double robot_x,
 }
 
 void StaticLayer::UpdateCosts(Costmap2D& master_grid, int min_i, int min_j, int max_i, int max_j) {
+  PrepareTiles(master_grid, min_i, min_j, max_i, max_j, 1);
+  UpdateCostsTile(master_grid, min_i, min_j, max_i, max_j, 0);
+}
+
+void StaticLayer::PrepareTiles(Costmap2D& master_grid, int min_i, int min_j, int max_i, int max_j,
+                               unsigned int thread_num) {
+  update_ready_ = false;
   if(!map_received_) {
     return;
   }
+  if(layered_costmap_->IsRollingWindow()) {
+    try {
+      if (tf_ != nullptr) {
+        tf_->lookupTransform(map_frame_, global_frame_, ros::Time(0), update_transform_);
+      } else {
+        // offline, the map is given in the global frame
+        update_transform_.setIdentity();
+      }
+    }
+    catch (tf::TransformException ex) {
+      ROS_ERROR("%s", ex.what());
+      return;
+    }
+    // the map position of a master cell center is affine in the cell index, so only the row and column
+    // steps are needed instead of transforming every cell
+    const tf::Matrix3x3 &basis = update_transform_.getBasis();
+    const tf::Vector3 &origin = update_transform_.getOrigin();
+    double master_resolution = master_grid.GetResolution();
+    double x0 = master_grid.GetOriginX() + 0.5 * master_resolution;
+    double y0 = master_grid.GetOriginY() + 0.5 * master_resolution;
+    double affine[6];
+    affine[0] = (basis[0].x() * x0 + basis[0].y() * y0 + origin.x() - origin_x_) / resolution_;
+    affine[1] = basis[0].x() * master_resolution / resolution_;
+    affine[2] = basis[0].y() * master_resolution / resolution_;
+    affine[3] = (basis[1].x() * x0 + basis[1].y() * y0 + origin.y() - origin_y_) / resolution_;
+    affine[4] = basis[1].x() * master_resolution / resolution_;
+    affine[5] = basis[1].y() * master_resolution / resolution_;
+
+    // with the same transform, master origin and map the last reprojection is still valid
+    bool same_geometry = std::equal(affine, affine + 6, reprojection_affine_)
+        && reprojection_size_x_ == master_grid.GetSizeXCell() && reprojection_size_y_ == master_grid.GetSizeYCell()
+        && reprojection_map_hash_ == map_hash_;
+    reproject_ = !same_geometry || min_i < reprojection_bounds_[0] || min_j < reprojection_bounds_[1]
+        || max_i > reprojection_bounds_[2] || max_j > reprojection_bounds_[3];
+    if (reproject_) {
+      std::copy(affine, affine + 6, reprojection_affine_);
+      reprojection_size_x_ = master_grid.GetSizeXCell();
+      reprojection_size_y_ = master_grid.GetSizeYCell();
+      reprojection_map_hash_ = map_hash_;
+      reprojection_bounds_[0] = min_i;
+      reprojection_bounds_[1] = min_j;
+      reprojection_bounds_[2] = max_i;
+      reprojection_bounds_[3] = max_j;
+      reprojection_.resize(reprojection_size_x_ * reprojection_size_y_);
+    }
+  }
+  update_ready_ = true;
+}
+
+void StaticLayer::UpdateCostsTile(Costmap2D& master_grid, int min_i, int min_j, int max_i, int max_j,
+                                  unsigned int thread_index) {
+  if(!update_ready_) {
+    return;
+  }
   if(!layered_costmap_->IsRollingWindow()) {
     if(!use_maximum_) {
       UpdateOverwriteByAll(master_grid, min_i, min_j, max_i, max_j);
@@ -197,33 +403,75 @@ void StaticLayer::UpdateCosts(Costmap2D& master_grid, int min_i, int min_j, int
       UpdateOverwriteByMax(master_grid, min_i, min_j, max_i, max_j);
     }
   } else {
-    unsigned int mx, my;
-    double wx, wy;
-    tf::StampedTransform temp_transform;
-    try {
-      tf_->lookupTransform(map_frame_, global_frame_, ros::Time(0), temp_transform);
-    }
-    catch (tf::TransformException ex) {
-      ROS_ERROR("%s", ex.what());
-      return;
+    if (reproject_) {
+      ReprojectTile(master_grid, min_i, min_j, max_i, max_j);
     }
-    for(auto i = min_i; i < max_i; ++i) {
-      for(auto j = min_j; j < max_j; ++j) {
-        layered_costmap_->GetCostMap()->Map2World(i, j, wx, wy);
-        tf::Point p(wx, wy, 0);
-        p = temp_transform(p);
-        if(World2Map(p.x(), p.y(), mx, my)){
-          if(!use_maximum_) {
-            master_grid.SetCost(i, j, GetCost(mx, my));
-          }
-          else {
-            master_grid.SetCost(i, j, std::max(master_grid.GetCost(i, j), GetCost(i, j)));
-          }
-        }
+    // only the cells reprojecting into the static map are merged, unknown ones included
+    unsigned int size_x = master_grid.GetSizeXCell();
+    unsigned char *master = master_grid.GetCharMap();
+    for (int j = min_j; j < max_j; ++j) {
+      int begin, end;
+      GetInsideSpan(j, min_i, max_i, begin, end);
+      unsigned int index = j * size_x + begin;
+      if (!use_maximum_) {
+        simd::MergeRowByAll(master + index, &reprojection_[index], end - begin);
+      } else {
+        simd::MergeRowByMax(master + index, &reprojection_[index], end - begin);
       }
     }
   }
 }
 
+void StaticLayer::ReprojectTile(const Costmap2D& master_grid, int min_i, int min_j, int max_i, int max_j) {
+  const double *affine = reprojection_affine_;
+  unsigned int master_size_x = master_grid.GetSizeXCell();
+  for (int j = min_j; j < max_j; ++j) {
+    double row_u = affine[0] + affine[2] * j;
+    double row_v = affine[3] + affine[5] * j;
+    unsigned char *row = &reprojection_[j * master_size_x];
+    int begin, end;
+    GetInsideSpan(j, min_i, max_i, begin, end);
+    for (int i = begin; i < end; ++i) {
+      double u = row_u + affine[1] * i;
+      double v = row_v + affine[4] * i;
+      row[i] = costmap_[static_cast<unsigned int>(v) * size_x_ + static_cast<unsigned int>(u)];
+    }
+  }
+}
+
+void StaticLayer::GetInsideSpan(int j, int min_i, int max_i, int &begin, int &end) const {
+  const double *affine = reprojection_affine_;
+  const double size_x = size_x_, size_y = size_y_;
+  double row_u = affine[0] + affine[2] * j;
+  double row_v = affine[3] + affine[5] * j;
+  // same test as World2Map, points before the map origin and past its end are outside
+  auto inside = [&](int i) {
+    double u = row_u + affine[1] * i;
+    double v = row_v + affine[4] * i;
+    return u >= 0 && v >= 0 && u < size_x && v < size_y;
+  };
+  // estimate the span in closed form, then settle its ends with the exact test. u and v are monotone along the row,
+  // even rounded, so the inside cells are contiguous and the estimate is off by at most a cell at either end
+  double lo = min_i, hi = max_i;
+  ClipSpan(row_u, affine[1], size_x, lo, hi);
+  ClipSpan(row_v, affine[4], size_y, lo, hi);
+  lo = std::min(lo, static_cast<double>(max_i));
+  hi = std::max(hi, lo);
+  begin = static_cast<int>(std::ceil(lo));
+  end = static_cast<int>(std::ceil(hi));
+  while (begin < end && !inside(begin)) {
+    ++begin;
+  }
+  while (end > begin && !inside(end - 1)) {
+    --end;
+  }
+  while (begin > min_i && inside(begin - 1)) {
+    --begin;
+  }
+  while (end < max_i && inside(end)) {
+    ++end;
+  }
+}
+
 } //namespace roborts_costmap
 
@@ -0,0 +1,236 @@
+/****************************************************************************
+ *  Copyright (C) 2019 RoboMaster.
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program. If not, see <http://www.gnu.org/licenses/>.
+ ***************************************************************************/
+#include "voxel_layer_setting.pb.h"
+#include "voxel_layer.h"
+
+namespace roborts_costmap {
+
+void VoxelLayer::OnInitialize() {
+  ParaVoxelLayer para_voxel;
+  std::string voxel_map = ros::package::getPath("roborts_costmap") + "/config/voxel_layer_config.prototxt";
+  roborts_common::ReadProtoFromTextFile(voxel_map.c_str(), &para_voxel);
+  z_resolution_ = para_voxel.z_resolution();
+  origin_z_ = para_voxel.origin_z();
+  z_voxels_ = std::min(std::max(para_voxel.z_voxels(), 1u), 32u);
+  mark_threshold_ = std::max(para_voxel.mark_threshold(), 1u);
+  if (z_voxels_ != para_voxel.z_voxels()) {
+    ROS_WARN("Voxel layer supports 1 to 32 voxels per column, using %u.", z_voxels_);
+  }
+  // the column size has to be known before the base layer sizes the maps
+  ObstacleLayer::OnInitialize();
+  // voxels have no decay counters, a decayed cell would come back with its column, reset periodically instead
+  decay_enabled_ = false;
+  // the touched buffers of the parallel raytracing only hold cells, not voxels
+  SetRaytraceThreadNum(1);
+}
+
+uint32_t VoxelLayer::GetColumn(unsigned int mx, unsigned int my) const {
+  unsigned int index = GetIndex(mx, my);
+  return z_voxels_ > 16 ? wide_columns_[index] : narrow_columns_[index];
+}
+
+void VoxelLayer::InitMaps(unsigned int size_x, unsigned int size_y) {
+  std::unique_lock<mutex_t> lock(*GetMutex());
+  ObstacleLayer::InitMaps(size_x, size_y);
+  ForColumns([size_x, size_y](auto &columns) {
+    columns.assign(size_x * size_y, 0);
+  });
+}
+
+void VoxelLayer::ResetMaps() {
+  std::unique_lock<mutex_t> lock(*GetMutex());
+  ObstacleLayer::ResetMaps();
+  ForColumns([](auto &columns) {
+    std::fill(columns.begin(), columns.end(), 0);
+  });
+}
+
+void VoxelLayer::UpdateOrigin(double new_origin_x, double new_origin_y) {
+  int cell_ox = int((new_origin_x - origin_x_) / resolution_);
+  int cell_oy = int((new_origin_y - origin_y_) / resolution_);
+  if (cell_ox == 0 && cell_oy == 0) {
+    return;
+  }
+  // keep the same region of the columns as Costmap2D::UpdateOrigin keeps of the costs
+  int size_x = size_x_;
+  int size_y = size_y_;
+  int lower_left_x = std::min(std::max(cell_ox, 0), size_x);
+  int lower_left_y = std::min(std::max(cell_oy, 0), size_y);
+  int upper_right_x = std::min(std::max(cell_ox + size_x, 0), size_x);
+  int upper_right_y = std::min(std::max(cell_oy + size_y, 0), size_y);
+  unsigned int cell_size_x = upper_right_x - lower_left_x;
+  unsigned int cell_size_y = upper_right_y - lower_left_y;
+  ForColumns([&](auto &columns) {
+    typedef typename std::decay<decltype(columns)>::type::value_type MaskType;
+    std::vector<MaskType> local_columns(cell_size_x * cell_size_y);
+    CopyMapRegion(columns.data(), local_columns.data(), size_x_, cell_size_x, lower_left_x, lower_left_y, 0, 0,
+                  cell_size_x, cell_size_y);
+    // resets the columns along with the costs
+    ObstacleLayer::UpdateOrigin(new_origin_x, new_origin_y);
+    CopyMapRegion(local_columns.data(), columns.data(), cell_size_x, size_x_, 0, 0, lower_left_x - cell_ox,
+                  lower_left_y - cell_oy, cell_size_x, cell_size_y);
+  });
+}
+
+void VoxelLayer::UpdateBounds(double robot_x,
+                              double robot_y,
+                              double robot_yaw,
+                              double *min_x,
+                              double *min_y,
+                              double *max_x,
+                              double *max_y) {
+  if (rolling_window_) {
+    UpdateOrigin(robot_x - GetSizeXWorld() / 2, robot_y - GetSizeYWorld() / 2);
+  } else if (std::chrono::system_clock::now() - reset_time_ > std::chrono::seconds(2)) {
+    reset_time_ = std::chrono::system_clock::now();
+    ResetMaps();
+  }
+  if (!is_enabled_) {
+    ROS_ERROR("Voxel layer is not enabled.");
+    return;
+  }
+  UseExtraBounds(min_x, min_y, max_x, max_y);
+  std::vector<Observation> observations, clearing_observations;
+  bool temp_is_current = GetMarkingObservations(observations);
+  temp_is_current = GetClearingObservations(clearing_observations) && temp_is_current;
+  is_current_ = temp_is_current;
+
+  for (unsigned int i = 0; i < clearing_observations.size(); ++i) {
+    RaytraceFreespace(clearing_observations[i], min_x, min_y, max_x, max_y);
+  }
+  ForColumns([&](auto &columns) {
+    MarkVoxels(columns.data(), observations, min_x, min_y, max_x, max_y);
+  });
+
+  UpdateFootprint(robot_x, robot_y, robot_yaw, min_x, min_y, max_x, max_y);
+  if (footprint_clearing_enabled_ && transformed_footprint_.size() >= 3
+      && SetConvexRegionCost(transformed_footprint_, FREE_SPACE, footprint_spans_)) {
+    ForColumns([this](auto &columns) {
+      for (unsigned int row = 0; row < footprint_spans_.row_num; ++row) {
+        auto begin = columns.begin() + GetIndex(footprint_spans_.min_x[row], footprint_spans_.min_y + row);
+        std::fill(begin, begin + (footprint_spans_.max_x[row] - footprint_spans_.min_x[row] + 1), 0);
+      }
+    });
+  }
+}
+
+template<typename MaskType>
+void VoxelLayer::MarkVoxels(MaskType *columns,
+                            const std::vector<Observation> &observations,
+                            double *min_x,
+                            double *min_y,
+                            double *max_x,
+                            double *max_y) {
+  for (const Observation &obs : observations) {
+    const pcl::PointCloud<pcl::PointXYZ> &cloud = *(obs.cloud_);
+    double sq_obstacle_range = obs.obstacle_range_ * obs.obstacle_range_;
+    for (unsigned int i = 0; i < cloud.points.size(); ++i) {
+      double px = cloud.points[i].x, py = cloud.points[i].y, pz = cloud.points[i].z;
+      if (pz > max_obstacle_height_) {
+        continue;
+      }
+      double sq_dist = (px - obs.origin_.x) * (px - obs.origin_.x) + (py - obs.origin_.y) * (py - obs.origin_.y)
+          + (pz - obs.origin_.z) * (pz - obs.origin_.z);
+      if (sq_dist >= sq_obstacle_range) {
+        continue;
+      }
+      unsigned int mx, my;
+      if (!World2Map(px, py, mx, my)) {
+        continue;
+      }
+      double z = (pz - origin_z_) / z_resolution_;
+      if (z < 0 || z >= z_voxels_) {
+        continue;
+      }
+      unsigned int index = GetIndex(mx, my);
+      columns[index] |= static_cast<MaskType>(1u << static_cast<unsigned int>(z));
+      costmap_[index] = ProjectColumn(columns[index], mark_threshold_);
+      Touch(px, py, min_x, min_y, max_x, max_y);
+    }
+  }
+}
+
+void VoxelLayer::RaytraceFreespace(const Observation &clearing_observation,
+                                   double *min_x,
+                                   double *min_y,
+                                   double *max_x,
+                                   double *max_y) {
+  double ox = clearing_observation.origin_.x;
+  double oy = clearing_observation.origin_.y;
+  double oz = clearing_observation.origin_.z;
+  const pcl::PointCloud<pcl::PointXYZ> &cloud = *(clearing_observation.cloud_);
+
+  unsigned int x0, y0;
+  if (!World2Map(ox, oy, x0, y0)) {
+    return;
+  }
+  Touch(ox, oy, min_x, min_y, max_x, max_y);
+
+  double map_end_x = origin_x_ + size_x_ * resolution_;
+  double map_end_y = origin_y_ + size_y_ * resolution_;
+  unsigned int cell_raytrace_range = World2Cell(clearing_observation.raytrace_range_);
+  double z0 = (oz - origin_z_) / z_resolution_;
+  ForColumns([&](auto &columns) {
+    typedef typename std::decay<decltype(columns)>::type::value_type MaskType;
+    for (unsigned int i = 0; i < cloud.points.size(); ++i) {
+      double a = cloud.points[i].x - ox;
+      double b = cloud.points[i].y - oy;
+      double c = cloud.points[i].z - oz;
+
+      // shorten the beam to the map, keeping its slope so the heights along it stay right
+      double t = 1.0;
+      if (ox + a < origin_x_) {
+        t = std::min(t, (origin_x_ - ox) / a);
+      }
+      if (oy + b < origin_y_) {
+        t = std::min(t, (origin_y_ - oy) / b);
+      }
+      if (ox + a > map_end_x) {
+        t = std::min(t, (map_end_x - .001 - ox) / a);
+      }
+      if (oy + b > map_end_y) {
+        t = std::min(t, (map_end_y - .001 - oy) / b);
+      }
+      double wx = ox + a * t, wy = oy + b * t;
+      unsigned int x1, y1;
+      if (!World2Map(wx, wy, x1, y1)) {
+        continue;
+      }
+
+      double z1 = z0 + c * t / z_resolution_;
+      uint32_t beam_mask = SpanMask(z0, z1, z_voxels_);
+      if (beam_mask == 0) {
+        // the beam passes above or below every column
+        continue;
+      }
+      if (std::floor(z0) == std::floor(z1)) {
+        ClearColumn<MaskType> clearer(columns.data(), costmap_, static_cast<MaskType>(beam_mask), mark_threshold_);
+        RaytraceLine(clearer, x0, y0, x1, y1, cell_raytrace_range);
+      } else {
+        // the beam rises or falls by dz voxels per step along its dominant axis
+        unsigned int step_num = std::max(x1 > x0 ? x1 - x0 : x0 - x1, y1 > y0 ? y1 - y0 : y0 - y1);
+        double dz = step_num > 0 ? (z1 - z0) / step_num : 0;
+        ClearVoxels<MaskType> clearer(columns.data(), costmap_, z0, dz, z1, z_voxels_, mark_threshold_);
+        RaytraceLine(clearer, x0, y0, x1, y1, cell_raytrace_range);
+      }
+
+      UpdateRaytraceBounds(ox, oy, wx, wy, clearing_observation.raytrace_range_, min_x, min_y, max_x, max_y);
+    }
+  });
+}
+
+} //namespace roborts_costmap
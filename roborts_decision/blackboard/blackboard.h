@@ -46,9 +46,6 @@ class Blackboard {
       "/config/costmap_parameter_config_for_decision.prototxt";
     costmap_ptr_ = std::make_shared<CostMap>("decision_costmap", *tf_ptr_,
                                              map_path);
-    charmap_ = costmap_ptr_->GetCostMap()->GetCharMap();
-
-    costmap_2d_ = costmap_ptr_->GetLayeredCostmap()->GetCostMap();
 
     // Enemy fake pose
     ros::NodeHandle rviz_nh("/move_base_simple");
@@ -179,12 +176,19 @@ class Blackboard {
     return costmap_ptr_;
   }
 
-  const CostMap2D* GetCostMap2D() {
-    return costmap_2d_;
+  /**
+   * @brief Get the decision costmap as of its last update, it can be read without locking.
+   * @return The costmap snapshot, null until the costmap has been updated once.
+   */
+  std::shared_ptr<const CostMap2D> GetCostMap2D() {
+    return costmap_ptr_->GetCostMapSnapshot();
   }
 
+  /**
+   * @brief Get the cells of the decision costmap, only valid until its next update, which may reallocate them.
+   */
   const unsigned char* GetCharMap() {
-    return charmap_;
+    return costmap_ptr_->GetCostMap()->GetCharMap();
   }
 
  private:
@@ -221,8 +225,6 @@ class Blackboard {
 
   //! cost map
   std::shared_ptr<CostMap> costmap_ptr_;
-  CostMap2D* costmap_2d_;
-  unsigned char* charmap_;
 
   //! robot map pose
   geometry_msgs::PoseStamped robot_map_pose_;
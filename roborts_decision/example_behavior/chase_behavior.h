@@ -72,13 +72,14 @@ class ChaseBehavior {
         reduce_goal.pose.position.z = 1;
         unsigned int goal_cell_x, goal_cell_y;
 
-        // if necessary add mutex lock
-        //blackboard_->GetCostMap2D()->GetMutex()->lock();
-        auto get_enemy_cell = blackboard_->GetCostMap2D()->World2Map(enemy_x,
-                                                                   enemy_y,
-                                                                   goal_cell_x,
-                                                                   goal_cell_y);
-        //blackboard_->GetCostMap2D()->GetMutex()->unlock();
+        auto costmap_2d = blackboard_->GetCostMap2D();
+        if (!costmap_2d) {
+          return;
+        }
+        auto get_enemy_cell = costmap_2d->World2Map(enemy_x,
+                                                    enemy_y,
+                                                    goal_cell_x,
+                                                    goal_cell_y);
 
         if (!get_enemy_cell) {
           return;
@@ -88,27 +89,27 @@ class ChaseBehavior {
         auto robot_y = robot_map_pose.pose.position.y;
         unsigned int robot_cell_x, robot_cell_y;
         double goal_x, goal_y;
-        blackboard_->GetCostMap2D()->World2Map(robot_x,
-                                              robot_y,
-                                              robot_cell_x,
-                                              robot_cell_y);
+        costmap_2d->World2Map(robot_x,
+                              robot_y,
+                              robot_cell_x,
+                              robot_cell_y);
 
-        if (blackboard_->GetCostMap2D()->GetCost(goal_cell_x, goal_cell_y) >= 253) {
+        if (costmap_2d->GetCost(goal_cell_x, goal_cell_y) >= 253) {
 
           bool find_goal = false;
           for(FastLineIterator line( goal_cell_x, goal_cell_y, robot_cell_x, robot_cell_x); line.IsValid(); line.Advance()) {
 
-            auto point_cost = blackboard_->GetCostMap2D()->GetCost((unsigned int) (line.GetX()), (unsigned int) (line.GetY())); //current point's cost
+            auto point_cost = costmap_2d->GetCost((unsigned int) (line.GetX()), (unsigned int) (line.GetY())); //current point's cost
 
             if(point_cost >= 253){
               continue;
 
             } else {
               find_goal = true;
-              blackboard_->GetCostMap2D()->Map2World((unsigned int) (line.GetX()),
-                                                     (unsigned int) (line.GetY()),
-                                                     goal_x,
-                                                     goal_y);
+              costmap_2d->Map2World((unsigned int) (line.GetX()),
+                                    (unsigned int) (line.GetY()),
+                                    goal_x,
+                                    goal_y);
 
               reduce_goal.pose.position.x = goal_x;
               reduce_goal.pose.position.y = goal_y;
@@ -77,10 +77,15 @@ class EscapeBehavior {
         std::uniform_real_distribution<float> y_uni_dis(0, 5);
         //std::uniform_real_distribution<float> yaw_uni_dis(-M_PI, M_PI);
 
-        auto get_enemy_cell = blackboard_->GetCostMap2D()->World2Map(enemy.pose.position.x,
-                                               enemy.pose.position.y,
-                                               enemy_cell_x,
-                                               enemy_cell_y);
+        auto costmap_2d = blackboard_->GetCostMap2D();
+        if (!costmap_2d) {
+          return;
+        }
+
+        auto get_enemy_cell = costmap_2d->World2Map(enemy.pose.position.x,
+                                                    enemy.pose.position.y,
+                                                    enemy_cell_x,
+                                                    enemy_cell_y);
 
         if (!get_enemy_cell) {
           chassis_executor_->Execute(whirl_vel_);
@@ -91,24 +96,23 @@ class EscapeBehavior {
         while (true) {
           goal_x = x_uni_dis(gen);
           goal_y = y_uni_dis(gen);
-          auto get_goal_cell = blackboard_->GetCostMap2D()->World2Map(goal_x,
-                                                                      goal_y,
-                                                                      goal_cell_x,
-                                                                      goal_cell_y);
+          auto get_goal_cell = costmap_2d->World2Map(goal_x,
+                                                     goal_y,
+                                                     goal_cell_x,
+                                                     goal_cell_y);
 
           if (!get_goal_cell) {
             continue;
           }
 
-          auto index = blackboard_->GetCostMap2D()->GetIndex(goal_cell_x, goal_cell_y);
-//          costmap_2d_->GetCost(goal_cell_x, goal_cell_y);
-          if (blackboard_->GetCharMap()[index] >= 253) {
+          auto index = costmap_2d->GetIndex(goal_cell_x, goal_cell_y);
+          if (costmap_2d->GetCharMap()[index] >= 253) {
             continue;
           }
 
           unsigned int obstacle_count = 0;
           for(FastLineIterator line( goal_cell_x, goal_cell_y, enemy_cell_x, enemy_cell_y); line.IsValid(); line.Advance()) {
-            auto point_cost = blackboard_->GetCostMap2D()->GetCost((unsigned int)(line.GetX()), (unsigned int)(line.GetY())); //current point's cost
+            auto point_cost = costmap_2d->GetCost((unsigned int)(line.GetX()), (unsigned int)(line.GetY())); //current point's cost
 
             if(point_cost > 253){
               obstacle_count++;
@@ -27,11 +27,14 @@
 #include "costmap/costmap_interface.h"
 
 #include "../global_planner_base.h"
+#include "../search_arena.h"
+#include "../landmark_table.h"
 
 namespace roborts_global_planner{
 
 /**
- * @brief Global planner alogorithm class for A star under the representation of costmap
+ * @brief Global planner alogorithm class for A star under the representation of costmap. If a landmark table
+ *        built from the static map of the costmap is available, the heuristic is raised to its lower bound.
  */
 class AStarPlanner : public GlobalPlannerBase {
 
@@ -54,34 +57,18 @@ class AStarPlanner : public GlobalPlannerBase {
                                std::vector<geometry_msgs::PoseStamped> &path);
 
  private:
-  /**
-   * @brief State enumerate for the cell.
-   */
-  enum SearchState {
-    NOT_HANDLED, /**< The cell is not handled.*/
-    OPEN, /**< The cell is in open priority queue.*/
-    CLOSED /**< The cell is in close queue.*/
-  };
   /**
    * @brief Plan based on 1D Costmap list. Input the index in the costmap and get the plan path.
+   * @param costmap costmap snapshot to search in
    * @param start_index start pose index in the 1D costmap list
    * @param goal_index goal pose index in the 1D costmap list
    * @param path plan path output
    * @return ErrorInfo which is OK if succeed
    */
-  roborts_common::ErrorInfo SearchPath(const int &start_index,
+  roborts_common::ErrorInfo SearchPath(const roborts_costmap::Costmap2D &costmap,
+                                     const int &start_index,
                                      const int &goal_index,
                                      std::vector<geometry_msgs::PoseStamped> &path);
-  /**
-   * @brief Calculate the cost for the diagonal or parallel movement.
-   * @param current_index Index of the current cell as input
-   * @param neighbor_index Index of the neighbor cell as input
-   * @param move_cost Movement cost as output
-   * @return ErrorInfo which is OK if succeed
-   */
-  roborts_common::ErrorInfo GetMoveCost(const int &current_index,
-                                      const int &neighbor_index,
-                                      int &move_cost) const;
   /**
    * @brief Calculate the Manhattan distance between two cell index used as the heuristic function of A star algorithm.
    * @param index1 Index of the first cell as input
@@ -92,21 +79,19 @@ class AStarPlanner : public GlobalPlannerBase {
                             const int &index2,
                             int &manhattan_distance) const;
   /**
-   * @brief Get the index of nine neighbor cell from the current cell
-   * @param current_index Index of the current cell as input
-   * @param neighbors_index Index of the neighbor cells as out
+   * @brief Calculate the heuristic of a cell, the Manhattan distance raised to the landmark lower bound if the
+   *        landmark table is used in this search.
+   * @param index Index of the cell
+   * @param goal_index Index of the goal cell
+   * @return The heuristic
    */
-  void GetNineNeighbors(const int &current_index,
-                        std::vector<int> &neighbors_index) const;
-
+  int GetHeuristic(int index, int goal_index) const;
   /**
-   * @brief Used for priority queue compare process.
+   * @brief Check whether the landmark table was built from the static map of a costmap snapshot.
+   * @param costmap costmap snapshot to search in
+   * @return True if the table can be used for the snapshot
    */
-  struct Compare {
-    bool operator()(const int &index1, const int &index2) {
-      return AStarPlanner::f_score_.at(index1) > AStarPlanner::f_score_.at(index2);
-    }
-  };
+  bool CheckLandmarkTable(const roborts_costmap::Costmap2D &costmap);
 
   //! heuristic_factor_
   float heuristic_factor_;
@@ -119,20 +104,19 @@ class AStarPlanner : public GlobalPlannerBase {
   //! gridmap height width
   unsigned int gridmap_width_;
   //! gridmap cost array
-  unsigned char *cost_;
-  //! search algorithm related f score, f_score = g_score + heuristic_cost_estimate
-  static std::vector<int> f_score_;
-  //! search algorithm related g score, which refers to the score from start cell to current cell
-  std::vector<int> g_score_;
-  //! vector that indicates the parent cell index of each cell
-  std::vector<int> parent_;
-  //! vector that indicates the state of each cell
-  std::vector<AStarPlanner::SearchState> state_;
-
-
+  const unsigned char *cost_;
+  //! g score, parent and state of every cell, kept between plans
+  SearchArena arena_;
+  //! open list ordered by f score, f_score = g_score + heuristic_cost_estimate
+  IndexedHeap<int> open_list_;
+  //! Landmark distances of the static map, empty if no table was loaded
+  LandmarkTable landmark_table_;
+  //! Whether the current search uses the landmark table
+  bool use_landmarks_;
+  //! Static map hash the table was last found to be stale for, so it is reported once per map
+  uint64_t stale_map_hash_;
 };
 
-std::vector<int> AStarPlanner::f_score_;
 roborts_common::REGISTER_ALGORITHM(GlobalPlannerBase,
                                  "a_star_planner",
                                  AStarPlanner,
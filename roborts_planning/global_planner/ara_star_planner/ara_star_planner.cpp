@@ -0,0 +1,198 @@
+/****************************************************************************
+ *  Copyright (C) 2019 RoboMaster.
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program. If not, see <http://www.gnu.org/licenses/>.
+ ***************************************************************************/
+
+#include <algorithm>
+#include <limits>
+
+#include "ara_star_planner.h"
+
+namespace roborts_global_planner{
+
+using roborts_common::ErrorCode;
+using roborts_common::ErrorInfo;
+
+namespace {
+//! Expansions between two checks of the deadline
+const int kDeadlineCheckInterval = 256;
+}
+
+AraStarPlanner::AraStarPlanner(CostmapPtr costmap_ptr) :
+    GlobalPlannerBase::GlobalPlannerBase(costmap_ptr),
+    epsilon_(1),
+    suboptimality_bound_(1),
+    width_(0),
+    search_num_(0) {
+
+  AraStarPlannerConfig ara_star_planner_config;
+  std::string full_path = ros::package::getPath("roborts_planning") + "/global_planner/ara_star_planner/"\
+      "config/ara_star_planner_config.prototxt";
+
+  if (!roborts_common::ReadProtoFromTextFile(full_path.c_str(),
+                                             &ara_star_planner_config)) {
+    ROS_ERROR("Cannot load ara star planner protobuf configuration file.");
+  }
+  inaccessible_cost_ = ara_star_planner_config.inaccessible_cost();
+  goal_search_tolerance_ = ara_star_planner_config.goal_search_tolerance()/costmap_ptr->GetCostMap()->GetResolution();
+  initial_epsilon_ = std::max(1.0f, ara_star_planner_config.initial_epsilon());
+  epsilon_step_ = ara_star_planner_config.epsilon_step();
+  time_budget_ = std::chrono::microseconds(static_cast<int64_t>(ara_star_planner_config.time_budget() * 1e6));
+}
+
+AraStarPlanner::~AraStarPlanner(){
+}
+
+ErrorInfo AraStarPlanner::Plan(const geometry_msgs::PoseStamped &start,
+                               const geometry_msgs::PoseStamped &goal,
+                               std::vector<geometry_msgs::PoseStamped> &path) {
+
+  // plan on the latest costmap snapshot, so the costmap keeps updating while searching
+  return PlanWithSearch(costmap_ptr_->GetCostMapSnapshot(), start, goal, inaccessible_cost_, goal_search_tolerance_,
+                        [this](const roborts_costmap::Costmap2D &costmap, int start_index, int goal_index,
+                               std::vector<geometry_msgs::PoseStamped> &path) {
+                          return SearchPath(costmap, start_index, goal_index, path);
+                        }, path);
+}
+
+ErrorInfo AraStarPlanner::SearchPath(const roborts_costmap::Costmap2D &costmap,
+                                     const int &start_index,
+                                     const int &goal_index,
+                                     std::vector<geometry_msgs::PoseStamped> &path) {
+  const Clock::time_point deadline = Clock::now() + time_budget_;
+  const int width = costmap.GetSizeXCell(), height = costmap.GetSizeYCell();
+  const size_t cell_num = static_cast<size_t>(width) * height;
+  width_ = width;
+  arena_.NewSearch(width, height);
+  open_list_.Resize(cell_num);
+  open_list_.Clear();
+  inconsistent_cells_.clear();
+  if (closed_search_.size() != cell_num) {
+    closed_search_.assign(cell_num, 0);
+  }
+  path_cells_.clear();
+
+  epsilon_ = initial_epsilon_;
+  arena_.Node(start_index).g = 0;
+  open_list_.Push(start_index, GetKey(start_index, goal_index));
+  int count = 0;
+  double bound = epsilon_;
+  while (true) {
+    // a new search number opens every cell closed by the searches before
+    if (++search_num_ == 0) {
+      std::fill(closed_search_.begin(), closed_search_.end(), 0);
+      search_num_ = 1;
+    }
+    if (!ImprovePath(costmap, goal_index, deadline, count)) {
+      break;
+    }
+    if (arena_.Node(goal_index).g == std::numeric_limits<int>::max()) {
+      break;
+    }
+    path_cells_.clear();
+    for (int index = goal_index; index >= 0; index = arena_.Node(index).parent) {
+      path_cells_.push_back(index);
+    }
+    double last_epsilon = epsilon_;
+    epsilon_ = std::max(1.0, epsilon_ - epsilon_step_);
+    bound = std::min(last_epsilon, ReopenCells(goal_index));
+    if (last_epsilon <= 1 || bound <= 1 || epsilon_step_ <= 0) {
+      break;
+    }
+  }
+  expansion_num_ += count;
+  ROS_INFO("Search takes %d cycle counts", count);
+
+  if (path_cells_.empty()) {
+    if (Clock::now() >= deadline) {
+      ROS_WARN("Global planner can't find a path within the time budget!");
+      return ErrorInfo(ErrorCode::GP_TIME_OUT_ERROR, "No path found within the time budget.");
+    }
+    ROS_WARN("Global planner can't search the valid path!");
+    return ErrorInfo(ErrorCode::GP_PATH_SEARCH_ERROR, "Valid global path not found.");
+  }
+  suboptimality_bound_ = std::max(1.0, bound);
+  ROS_INFO("Path found with suboptimality bound %.2f", suboptimality_bound_);
+
+  geometry_msgs::PoseStamped iter_pos;
+  iter_pos.pose.orientation.w = 1;
+  iter_pos.header.frame_id = "map";
+  path.clear();
+  for (auto index = path_cells_.rbegin(); index != path_cells_.rend(); ++index) {
+    costmap.Map2World(*index % width, *index / width, iter_pos.pose.position.x, iter_pos.pose.position.y);
+    path.push_back(iter_pos);
+  }
+  return ErrorInfo(ErrorCode::OK);
+}
+
+bool AraStarPlanner::ImprovePath(const roborts_costmap::Costmap2D &costmap, int goal_index,
+                                 Clock::time_point deadline, int &count) {
+  const unsigned char *cost = costmap.GetCharMap();
+  const std::array<NeighborMove, SearchArena::kNeighborNum> &moves = arena_.GetNeighbors();
+  // the key of the goal is its g score, as its heuristic is 0
+  while (!open_list_.Empty() && open_list_.TopKey() < arena_.Node(goal_index).g) {
+    if (++count % kDeadlineCheckInterval == 0 && Clock::now() >= deadline) {
+      return false;
+    }
+    int current_index = open_list_.Pop();
+    closed_search_[current_index] = search_num_;
+    const int current_g = arena_.Node(current_index).g;
+
+    unsigned int neighbor_mask = arena_.GetNeighborMask(current_index);
+    for (int i = 0; i < SearchArena::kNeighborNum; ++i) {
+      if (!(neighbor_mask & (1u << i))) {
+        continue;
+      }
+      int neighbor_index = current_index + moves[i].offset;
+      if (cost[neighbor_index] >= inaccessible_cost_) {
+        continue;
+      }
+      SearchNode &neighbor_node = arena_.Node(neighbor_index);
+      int g_score = current_g + moves[i].move_cost + cost[neighbor_index];
+      if (neighbor_node.g <= g_score) {
+        continue;
+      }
+      neighbor_node.g = g_score;
+      neighbor_node.parent = current_index;
+      // a cell closed in this search is not expanded again until the next one
+      if (closed_search_[neighbor_index] != search_num_) {
+        open_list_.Push(neighbor_index, GetKey(neighbor_index, goal_index));
+      } else {
+        inconsistent_cells_.push_back(neighbor_index);
+      }
+    }
+  }
+  return true;
+}
+
+double AraStarPlanner::ReopenCells(int goal_index) {
+  reopened_cells_.clear();
+  while (!open_list_.Empty()) {
+    reopened_cells_.push_back(open_list_.Pop());
+  }
+  reopened_cells_.insert(reopened_cells_.end(), inconsistent_cells_.begin(), inconsistent_cells_.end());
+  inconsistent_cells_.clear();
+
+  // no cell left to expand has an f score below the optimal cost
+  int min_f_score = std::numeric_limits<int>::max();
+  for (int index : reopened_cells_) {
+    min_f_score = std::min(min_f_score, arena_.Node(index).g + GetOctileDistance(index, goal_index));
+    open_list_.Push(index, GetKey(index, goal_index));
+  }
+  const int goal_g = arena_.Node(goal_index).g;
+  return min_f_score >= goal_g ? 1.0 : static_cast<double>(goal_g) / min_f_score;
+}
+
+} //namespace roborts_global_planner
@@ -0,0 +1,155 @@
+/****************************************************************************
+ *  Copyright (C) 2019 RoboMaster.
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program. If not, see <http://www.gnu.org/licenses/>.
+ ***************************************************************************/
+#ifndef ROBORTS_PLANNING_GLOBAL_PLANNER_ARA_STAR_PLANNER_H
+#define ROBORTS_PLANNING_GLOBAL_PLANNER_ARA_STAR_PLANNER_H
+
+#include <chrono>
+
+#include <ros/ros.h>
+#include <geometry_msgs/PoseStamped.h>
+
+#include "proto/ara_star_planner_config.pb.h"
+
+#include "alg_factory/algorithm_factory.h"
+#include "state/error_code.h"
+#include "costmap/costmap_interface.h"
+
+#include "../global_planner_base.h"
+#include "../search_arena.h"
+
+namespace roborts_global_planner{
+
+/**
+ * @brief Global planner algorithm class for anytime repairing A star (ARA*) under the representation of costmap.
+ *        A first search with the heuristic inflated by a factor epsilon finds a path quickly, which costs at most
+ *        epsilon times the optimal one. Further searches lower epsilon step by step while the time budget of the
+ *        plan lasts, each reusing the scores of the previous one and only expanding again the cells whose score
+ *        improved. The path of the last finished search is returned.
+ */
+class AraStarPlanner : public GlobalPlannerBase {
+
+ public:
+  /**
+   * @brief Constructor of ARA* planner, set the costmap pointer and relevant costmap size.
+   * @param costmap_ptr The shared pointer of costmap interface
+   */
+  AraStarPlanner(CostmapPtr costmap_ptr);
+  virtual ~AraStarPlanner();
+  /**
+   * @brief Main Plan function(override the base-class function)
+   * @param start Start pose input
+   * @param goal Goal pose input
+   * @param path Global plan path output
+   * @return ErrorInfo which is OK if succeed
+   */
+  roborts_common::ErrorInfo Plan(const geometry_msgs::PoseStamped &start,
+                                 const geometry_msgs::PoseStamped &goal,
+                                 std::vector<geometry_msgs::PoseStamped> &path);
+  /**
+   * @brief Get the suboptimality bound of the last plan.
+   * @return The largest ratio of the cost of the path and the optimal cost, 1 if the path is optimal
+   */
+  double GetSuboptimalityBound() const {
+    return suboptimality_bound_;
+  }
+
+ private:
+  typedef std::chrono::steady_clock Clock;
+
+  /**
+   * @brief Search a path between two cells within the time budget.
+   * @param costmap costmap snapshot to search in
+   * @param start_index start pose index in the 1D costmap list
+   * @param goal_index goal pose index in the 1D costmap list
+   * @param path plan path output
+   * @return ErrorInfo which is OK if succeed
+   */
+  roborts_common::ErrorInfo SearchPath(const roborts_costmap::Costmap2D &costmap,
+                                       const int &start_index,
+                                       const int &goal_index,
+                                       std::vector<geometry_msgs::PoseStamped> &path);
+  /**
+   * @brief Expand the open cells until the goal has the smallest key, for the current epsilon.
+   * @param costmap costmap snapshot to search in
+   * @param goal_index goal pose index in the 1D costmap list
+   * @param deadline time the search has to stop at
+   * @param count number of expanded cells, increased by the expansions of this search
+   * @return False if the deadline was reached before
+   */
+  bool ImprovePath(const roborts_costmap::Costmap2D &costmap, int goal_index, Clock::time_point deadline,
+                   int &count);
+  /**
+   * @brief Move the open and the inconsistent cells into the open list of the next search, queued with the keys
+   *        of the current epsilon.
+   * @param goal_index goal pose index in the 1D costmap list
+   * @return The suboptimality bound of the path found by the last search
+   */
+  double ReopenCells(int goal_index);
+  /**
+   * @brief Get the key of a cell in the open list, its g score plus the inflated heuristic.
+   */
+  int GetKey(int index, int goal_index) {
+    return arena_.Node(index).g + static_cast<int>(epsilon_ * GetOctileDistance(index, goal_index));
+  }
+  /**
+   * @brief Calculate the octile distance between two cells used as the heuristic function.
+   */
+  int GetOctileDistance(int index1, int index2) const {
+    int dx = std::abs(index1 % width_ - index2 % width_), dy = std::abs(index1 / width_ - index2 / width_);
+    return 10 * std::max(dx, dy) + 4 * std::min(dx, dy);
+  }
+
+  //! inaccessible_cost
+  unsigned int inaccessible_cost_;
+  //! goal_search_tolerance
+  unsigned int goal_search_tolerance_;
+  //! Heuristic inflation factor of the first search
+  double initial_epsilon_;
+  //! Decrease of the inflation factor after every search
+  double epsilon_step_;
+  //! Time a plan may take
+  std::chrono::microseconds time_budget_;
+  //! Heuristic inflation factor of the current search
+  double epsilon_;
+  //! Suboptimality bound of the path of the last plan
+  double suboptimality_bound_;
+  //! Width of the map of the current plan
+  int width_;
+  //! Search data of every cell, kept over the searches of a plan
+  SearchArena arena_;
+  //! Open list ordered by the key of the current search
+  IndexedHeap<int> open_list_;
+  //! Cells whose g score improved after they were expanded in the current search, may hold a cell more than once
+  std::vector<int> inconsistent_cells_;
+  //! Search in which every cell was expanded last, a cell is closed if it was expanded in the current one
+  std::vector<uint32_t> closed_search_;
+  //! Number of the current search, counting over the plans
+  uint32_t search_num_;
+  //! Cells of the path found by the last finished search, from the goal to the start
+  std::vector<int> path_cells_;
+  //! Open and inconsistent cells moved into the open list of the next search
+  std::vector<int> reopened_cells_;
+};
+
+roborts_common::REGISTER_ALGORITHM(GlobalPlannerBase,
+                                   "ara_star_planner",
+                                   AraStarPlanner,
+                                   std::shared_ptr<roborts_costmap::CostmapInterface>);
+
+} //namespace roborts_global_planner
+
+#endif // ROBORTS_PLANNING_GLOBAL_PLANNER_ARA_STAR_PLANNER_H
@@ -0,0 +1,365 @@
+/****************************************************************************
+ *  Copyright (C) 2019 RoboMaster.
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program. If not, see <http://www.gnu.org/licenses/>.
+ ***************************************************************************/
+
+/**
+ * Offline global planner benchmark. Loads every map of roborts_bringup/maps into an offline global costmap through
+ * the static layer, with and without the inflation layer, and runs every registered planner on the same fixed seed
+ * start and goal pairs without ROS master and tf. For every map, inflation and planner it reports the plan time
+ * percentiles, the search expansions, the memory and the length and cost of the paths as one CSV row.
+ *
+ * usage: global_planner_benchmark [--queries N] [--seed N] [--upsample N] [--planners a,b] [--output FILE]
+ *
+ * The start and goal pairs are drawn from the cells the inflated map leaves accessible, so that the same pairs are
+ * valid with and without inflation. Expansions are the cells the planners expanded in every search of a plan,
+ * failed plans included. The first plan of every planner is reported on its own, since it includes the preprocessing
+ * the planner does on a new map. The planners run with their caches disabled, so that they preprocess every map
+ * and the caches of the robot stay untouched.
+ */
+
+#include <glob.h>
+#include <unistd.h>
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <memory>
+#include <random>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include <ros/package.h>
+#include <nav_msgs/OccupancyGrid.h>
+
+#include "costmap/costmap_interface.h"
+#include "costmap/map_loader.h"
+#include "../global_planner_base.h"
+#include "../global_planner_algorithms.h"
+
+namespace {
+
+using roborts_global_planner::GlobalPlannerBase;
+typedef roborts_common::AlgorithmFactory<GlobalPlannerBase, GlobalPlannerBase::CostmapPtr> PlannerFactory;
+
+/**
+ * @brief A start and goal pair in the map frame.
+ */
+struct Query {
+  geometry_msgs::PoseStamped start, goal;
+};
+
+/**
+ * @brief Length and costs of a path, measured on the costmap it was planned in.
+ */
+struct PathStats {
+  //! Length in m
+  double length = 0;
+  //! Sum of the costs of the cells the path enters
+  double cost = 0;
+  //! Number of entered cells at or above the inscribed cost
+  int blocked_num = 0;
+};
+
+/**
+ * @brief Benchmark results of a planner on a map.
+ */
+struct PlannerResult {
+  std::string map_name, planner_name;
+  bool inflation;
+  int query_num, solved_num;
+  double first_plan_time;
+  std::vector<double> plan_times;
+  long expansion_num, memory;
+  PathStats path_stats;
+};
+
+
+/**
+ * @brief Draw start and goal pairs on accessible cells at least min_distance apart.
+ */
+std::vector<Query> MakeQueries(const roborts_costmap::Costmap2D &costmap, int query_num, unsigned int seed,
+                               double min_distance) {
+  std::vector<unsigned int> accessible_cells;
+  for (unsigned int index = 0; index < costmap.GetSizeXCell() * costmap.GetSizeYCell(); ++index) {
+    if (costmap.GetCharMap()[index] < roborts_costmap::INSCRIBED_INFLATED_OBSTACLE) {
+      accessible_cells.push_back(index);
+    }
+  }
+  std::vector<Query> queries;
+  if (accessible_cells.size() < 2) {
+    return queries;
+  }
+  std::mt19937 random_engine(seed);
+  std::uniform_int_distribution<size_t> cell_distribution(0, accessible_cells.size() - 1);
+  auto random_pose = [&]() {
+    unsigned int x, y;
+    costmap.Index2Cells(accessible_cells[cell_distribution(random_engine)], x, y);
+    geometry_msgs::PoseStamped pose;
+    pose.header.frame_id = "map";
+    costmap.Map2World(x, y, pose.pose.position.x, pose.pose.position.y);
+    pose.pose.orientation.w = 1.0;
+    return pose;
+  };
+  // give up on the distance for maps too small to keep it
+  for (int attempt = 0; static_cast<int>(queries.size()) < query_num && attempt < 100 * query_num; ++attempt) {
+    Query query;
+    query.start = random_pose();
+    query.goal = random_pose();
+    if (std::hypot(query.goal.pose.position.x - query.start.pose.position.x,
+                   query.goal.pose.position.y - query.start.pose.position.y) >= min_distance) {
+      queries.push_back(query);
+    }
+  }
+  return queries;
+}
+
+/**
+ * @brief Walk the segments of a path at half the resolution and add up the cells it enters.
+ */
+void MeasurePath(const roborts_costmap::Costmap2D &costmap, const std::vector<geometry_msgs::PoseStamped> &path,
+                 PathStats &stats) {
+  if (path.empty()) {
+    return;
+  }
+  const double step = costmap.GetResolution() / 2;
+  unsigned int x, y;
+  int last_index = costmap.World2Map(path[0].pose.position.x, path[0].pose.position.y, x, y) ?
+                   static_cast<int>(costmap.GetIndex(x, y)) : -1;
+  for (size_t i = 1; i < path.size(); ++i) {
+    double start_x = path[i - 1].pose.position.x, start_y = path[i - 1].pose.position.y;
+    double dx = path[i].pose.position.x - start_x, dy = path[i].pose.position.y - start_y;
+    double length = std::hypot(dx, dy);
+    stats.length += length;
+    int step_num = static_cast<int>(std::ceil(length / step));
+    for (int k = 1; k <= step_num; ++k) {
+      if (!costmap.World2Map(start_x + dx * k / step_num, start_y + dy * k / step_num, x, y)) {
+        continue;
+      }
+      int index = costmap.GetIndex(x, y);
+      if (index == last_index) {
+        continue;
+      }
+      last_index = index;
+      unsigned char cost = costmap.GetCost(x, y);
+      stats.cost += cost;
+      if (cost >= roborts_costmap::INSCRIBED_INFLATED_OBSTACLE) {
+        ++stats.blocked_num;
+      }
+    }
+  }
+}
+
+/**
+ * @brief Resident memory of the process in KB.
+ */
+long ResidentMemory() {
+  long pages = 0, resident = 0;
+  FILE *statm = fopen("/proc/self/statm", "r");
+  if (statm != nullptr) {
+    if (fscanf(statm, "%ld %ld", &pages, &resident) != 2) {
+      resident = 0;
+    }
+    fclose(statm);
+  }
+  return resident * (sysconf(_SC_PAGESIZE) / 1024);
+}
+
+double Percentile(std::vector<double> values, double percentile) {
+  if (values.empty()) {
+    return 0;
+  }
+  size_t index = std::min(values.size() - 1, static_cast<size_t>(percentile * values.size()));
+  std::nth_element(values.begin(), values.begin() + index, values.end());
+  return values[index];
+}
+
+double ElapsedMicroseconds(std::chrono::steady_clock::time_point start) {
+  return std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count();
+}
+
+bool RunPlanner(const std::string &planner_name, const GlobalPlannerBase::CostmapPtr &costmap_ptr,
+                const std::vector<Query> &queries, PlannerResult &result) {
+  long memory_before = ResidentMemory();
+  std::unique_ptr<GlobalPlannerBase> planner = PlannerFactory::CreateAlgorithm(planner_name, costmap_ptr);
+  if (planner == nullptr) {
+    return false;
+  }
+  // the maps and configurations of the benchmark must not replace the caches the robot plans with
+  planner->DisableCache();
+  const roborts_costmap::Costmap2D &costmap = *costmap_ptr->GetCostMapSnapshot();
+  std::vector<geometry_msgs::PoseStamped> path;
+  result.planner_name = planner_name;
+  result.query_num = queries.size();
+  result.solved_num = 0;
+  result.expansion_num = 0;
+  result.path_stats = PathStats();
+  result.plan_times.clear();
+
+  auto start = std::chrono::steady_clock::now();
+  planner->Plan(queries[0].start, queries[0].goal, path);
+  result.first_plan_time = ElapsedMicroseconds(start);
+  for (const Query &query : queries) {
+    path.clear();
+    long expansion_num = planner->GetExpansionNum();
+    start = std::chrono::steady_clock::now();
+    roborts_common::ErrorInfo error_info = planner->Plan(query.start, query.goal, path);
+    result.plan_times.push_back(ElapsedMicroseconds(start));
+    result.expansion_num += planner->GetExpansionNum() - expansion_num;
+    if (error_info.IsOK() && !path.empty()) {
+      ++result.solved_num;
+      MeasurePath(costmap, path, result.path_stats);
+    }
+  }
+  result.memory = ResidentMemory() - memory_before;
+  return true;
+}
+
+void WriteHeader(FILE *output) {
+  fprintf(output, "map,inflation,planner,queries,solved,first_plan_us,mean_us,p50_us,p90_us,p99_us,max_us,"
+                  "mean_expansions,mean_length_m,mean_cost,blocked_cells,memory_kb\n");
+}
+
+void WriteResult(FILE *output, const PlannerResult &result) {
+  double total = 0;
+  for (double time : result.plan_times) {
+    total += time;
+  }
+  int solved_num = std::max(1, result.solved_num);
+  fprintf(output, "%s,%d,%s,%d,%d,%.1f,%.1f,%.1f,%.1f,%.1f,%.1f,%.1f,%.3f,%.1f,%d,%ld\n", result.map_name.c_str(),
+          result.inflation ? 1 : 0, result.planner_name.c_str(), result.query_num, result.solved_num,
+          result.first_plan_time, total / std::max<size_t>(1, result.plan_times.size()),
+          Percentile(result.plan_times, 0.5), Percentile(result.plan_times, 0.9),
+          Percentile(result.plan_times, 0.99), Percentile(result.plan_times, 1.0),
+          static_cast<double>(result.expansion_num) / std::max(1, result.query_num),
+          result.path_stats.length / solved_num, result.path_stats.cost / solved_num,
+          result.path_stats.blocked_num, result.memory);
+  fflush(output);
+}
+
+} //namespace
+
+int main(int argc, char **argv) {
+  int query_num = 100, upsample = 1;
+  unsigned int seed = 1;
+  std::string planner_list, output_path = "global_planner_benchmark.csv";
+  for (int i = 1; i + 1 < argc; i += 2) {
+    std::string option = argv[i];
+    if (option == "--queries") {
+      query_num = std::max(1, atoi(argv[i + 1]));
+    } else if (option == "--seed") {
+      seed = static_cast<unsigned int>(atoi(argv[i + 1]));
+    } else if (option == "--upsample") {
+      upsample = std::max(1, atoi(argv[i + 1]));
+    } else if (option == "--planners") {
+      planner_list = argv[i + 1];
+    } else if (option == "--output") {
+      output_path = argv[i + 1];
+    } else {
+      fprintf(stderr, "usage: %s [--queries N] [--seed N] [--upsample N] [--planners a,b] [--output FILE]\n",
+              argv[0]);
+      return 1;
+    }
+  }
+  // only wall time is needed, no master
+  ros::Time::init();
+
+  std::vector<std::string> planner_names;
+  if (planner_list.empty()) {
+    for (const auto &algorithm : PlannerFactory::GetAlgorithmHash()) {
+      planner_names.push_back(algorithm.first);
+    }
+  } else {
+    std::istringstream stream(planner_list);
+    std::string name;
+    while (std::getline(stream, name, ',')) {
+      planner_names.push_back(name);
+    }
+  }
+  std::sort(planner_names.begin(), planner_names.end());
+
+  std::vector<std::string> map_paths;
+  glob_t map_glob;
+  if (glob((ros::package::getPath("roborts_bringup") + "/maps/*.yaml").c_str(), 0, nullptr, &map_glob) == 0) {
+    map_paths.assign(map_glob.gl_pathv, map_glob.gl_pathv + map_glob.gl_pathc);
+  }
+  globfree(&map_glob);
+  if (map_paths.empty()) {
+    fprintf(stderr, "No map in roborts_bringup/maps\n");
+    return 1;
+  }
+
+  FILE *output = fopen(output_path.c_str(), "w");
+  if (output == nullptr) {
+    fprintf(stderr, "Can not open %s\n", output_path.c_str());
+    return 1;
+  }
+  WriteHeader(output);
+  const std::string config_file = ros::package::getPath("roborts_costmap") +
+      "/config/costmap_parameter_config_for_global_plan.prototxt";
+  const double min_query_distance = 1.0;
+  std::vector<PlannerResult> results;
+  for (const std::string &map_path : map_paths) {
+    nav_msgs::OccupancyGrid::Ptr map(new nav_msgs::OccupancyGrid());
+    if (!roborts_costmap::LoadMap(map_path, upsample, *map)) {
+      fclose(output);
+      return 1;
+    }
+    std::string map_name = map_path.substr(map_path.rfind('/') + 1);
+    map_name = map_name.substr(0, map_name.rfind('.'));
+    if (upsample > 1) {
+      map_name += " x" + std::to_string(upsample);
+    }
+    std::vector<Query> queries;
+    for (bool inflation : {true, false}) {
+      auto costmap_ptr = std::make_shared<roborts_costmap::CostmapInterface>("global_costmap", config_file, map,
+                                                                            inflation);
+      if (queries.empty()) {
+        queries = MakeQueries(*costmap_ptr->GetCostMapSnapshot(), query_num, seed, min_query_distance);
+        if (queries.empty()) {
+          fprintf(stderr, "No accessible cell in %s\n", map_path.c_str());
+          fclose(output);
+          return 1;
+        }
+      }
+      for (const std::string &planner_name : planner_names) {
+        PlannerResult result;
+        result.map_name = map_name;
+        result.inflation = inflation;
+        if (!RunPlanner(planner_name, costmap_ptr, queries, result)) {
+          fclose(output);
+          return 1;
+        }
+        WriteResult(output, result);
+        results.push_back(result);
+      }
+    }
+  }
+  fclose(output);
+
+  // the planners log every search, so the summary comes after all of them
+  printf("\n%-16s %-9s %-20s %8s %10s %10s %10s %12s %10s %8s\n", "map", "inflation", "planner", "solved",
+         "p50 us", "p99 us", "first us", "expansions", "length m", "mem KB");
+  for (const PlannerResult &result : results) {
+    printf("%-16s %-9s %-20s %4d/%-3d %10.1f %10.1f %10.1f %12.1f %10.2f %8ld\n", result.map_name.c_str(),
+           result.inflation ? "yes" : "no", result.planner_name.c_str(), result.solved_num, result.query_num,
+           Percentile(result.plan_times, 0.5), Percentile(result.plan_times, 0.99), result.first_plan_time,
+           static_cast<double>(result.expansion_num) / std::max(1, result.query_num),
+           result.path_stats.length / std::max(1, result.solved_num), result.memory);
+  }
+  printf("\nResults written to %s\n", output_path.c_str());
+  return 0;
+}
@@ -0,0 +1,216 @@
+/****************************************************************************
+ *  Copyright (C) 2019 RoboMaster.
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program. If not, see <http://www.gnu.org/licenses/>.
+ ***************************************************************************/
+
+#include <algorithm>
+
+#include <ros/ros.h>
+
+#include "cost_to_go_field.h"
+
+namespace roborts_global_planner{
+
+const int CostToGoField::kUnreachable;
+
+namespace {
+//! Cells relaxed by one task of the thread pool
+const int kRelaxChunkSize = 256;
+}
+
+CostToGoField::CostToGoField(unsigned int thread_num, int bucket_width) :
+    bucket_width_(std::max(bucket_width, 1)),
+    inaccessible_cost_(0),
+    source_index_(0),
+    cell_num_(0) {
+  if (thread_num > 1) {
+    pool_.reset(new roborts_common::ThreadPool(thread_num));
+  }
+  improved_cells_.resize(std::max(thread_num, 1u));
+}
+
+bool CostToGoField::Compute(const std::shared_ptr<roborts_costmap::CostmapInterface> &costmap_ptr,
+                            unsigned int inaccessible_cost) {
+  std::shared_ptr<const roborts_costmap::Costmap2D> costmap = costmap_ptr->GetCostMapSnapshot();
+  geometry_msgs::PoseStamped robot_pose;
+  unsigned int robot_x, robot_y;
+  if (!costmap || !costmap_ptr->GetRobotPose(robot_pose)
+      || !costmap->World2Map(robot_pose.pose.position.x, robot_pose.pose.position.y, robot_x, robot_y)) {
+    ROS_WARN("Failed to get the robot cell for the cost to go field");
+    return false;
+  }
+  Compute(costmap, costmap->GetIndex(robot_x, robot_y), inaccessible_cost);
+  return true;
+}
+
+void CostToGoField::Compute(const std::shared_ptr<const roborts_costmap::Costmap2D> &costmap,
+                            unsigned int source_index, unsigned int inaccessible_cost) {
+  costmap_ = costmap;
+  inaccessible_cost_ = inaccessible_cost;
+  source_index_ = source_index;
+  neighbors_.Resize(costmap->GetSizeXCell(), costmap->GetSizeYCell());
+  const size_t cell_num = static_cast<size_t>(costmap->GetSizeXCell()) * costmap->GetSizeYCell();
+  if (cell_num_ != cell_num) {
+    cell_num_ = cell_num;
+    cost_.reset(new std::atomic<int>[cell_num]);
+  }
+  for (size_t i = 0; i < cell_num; ++i) {
+    cost_[i].store(kUnreachable, std::memory_order_relaxed);
+  }
+  relaxed_cost_.assign(cell_num, kUnreachable);
+  for (auto &bucket : buckets_) {
+    bucket.clear();
+  }
+
+  cost_[source_index].store(0, std::memory_order_relaxed);
+  if (buckets_.empty()) {
+    buckets_.resize(1);
+  }
+  buckets_[0].push_back(source_index);
+  // the buckets grow while the relaxations queue cells in later ones
+  for (size_t i = 0; i < buckets_.size(); ++i) {
+    settled_.clear();
+    while (!buckets_[i].empty()) {
+      frontier_.clear();
+      for (int index : buckets_[i]) {
+        int cost = GetCost(index);
+        if (static_cast<size_t>(cost / bucket_width_) == i && relaxed_cost_[index] != cost) {
+          relaxed_cost_[index] = cost;
+          frontier_.push_back(index);
+        }
+      }
+      buckets_[i].clear();
+      settled_.insert(settled_.end(), frontier_.begin(), frontier_.end());
+      RelaxMoves(frontier_, true);
+    }
+    RelaxMoves(settled_, false);
+  }
+}
+
+void CostToGoField::RelaxMoves(const std::vector<int> &cells, bool light) {
+  const unsigned char *cost = costmap_->GetCharMap();
+  const std::array<NeighborMove, GridNeighbors::kNeighborNum> &moves = neighbors_.GetMoves();
+  auto relax_chunk = [&](int task_index, unsigned int thread_index) {
+    std::vector<int> &improved_cells = improved_cells_[thread_index];
+    const size_t end = std::min(cells.size(), static_cast<size_t>(task_index + 1) * kRelaxChunkSize);
+    for (size_t i = static_cast<size_t>(task_index) * kRelaxChunkSize; i < end; ++i) {
+      const int index = cells[i];
+      const int index_cost = GetCost(index);
+      unsigned int neighbor_mask = neighbors_.GetMask(index);
+      for (int j = 0; j < GridNeighbors::kNeighborNum; ++j) {
+        if (!(neighbor_mask & (1u << j))) {
+          continue;
+        }
+        int neighbor_index = index + moves[j].offset;
+        if (cost[neighbor_index] >= inaccessible_cost_) {
+          continue;
+        }
+        int move_cost = moves[j].move_cost + cost[neighbor_index];
+        if ((move_cost <= bucket_width_) != light) {
+          continue;
+        }
+        int new_cost = index_cost + move_cost;
+        int old_cost = cost_[neighbor_index].load(std::memory_order_relaxed);
+        while (new_cost < old_cost) {
+          if (cost_[neighbor_index].compare_exchange_weak(old_cost, new_cost, std::memory_order_relaxed)) {
+            improved_cells.push_back(neighbor_index);
+            break;
+          }
+        }
+      }
+    }
+  };
+  const int task_num = (cells.size() + kRelaxChunkSize - 1) / kRelaxChunkSize;
+  if (pool_ && task_num > 1) {
+    pool_->ParallelFor(task_num, relax_chunk);
+  } else {
+    for (int i = 0; i < task_num; ++i) {
+      relax_chunk(i, 0);
+    }
+  }
+
+  for (auto &improved_cells : improved_cells_) {
+    for (int index : improved_cells) {
+      size_t bucket = GetCost(index) / bucket_width_;
+      if (bucket >= buckets_.size()) {
+        buckets_.resize(bucket + 1);
+      }
+      buckets_[bucket].push_back(index);
+    }
+    improved_cells.clear();
+  }
+}
+
+int CostToGoField::GetCost(const geometry_msgs::PoseStamped &pose) const {
+  unsigned int x, y;
+  if (!costmap_ || !costmap_->World2Map(pose.pose.position.x, pose.pose.position.y, x, y)) {
+    return kUnreachable;
+  }
+  return GetCost(costmap_->GetIndex(x, y));
+}
+
+bool CostToGoField::ExtractPath(unsigned int target_index, std::vector<geometry_msgs::PoseStamped> &path) const {
+  path.clear();
+  if (!costmap_ || target_index >= cell_num_ || GetCost(target_index) == kUnreachable) {
+    return false;
+  }
+  const unsigned char *cost = costmap_->GetCharMap();
+  const std::array<NeighborMove, GridNeighbors::kNeighborNum> &moves = neighbors_.GetMoves();
+  const unsigned int width = costmap_->GetSizeXCell();
+  geometry_msgs::PoseStamped iter_pos;
+  iter_pos.pose.orientation.w = 1;
+  iter_pos.header.frame_id = "map";
+
+  // step back to a neighbor whose cost plus the move gives the cost of the cell, there is one on every cheapest path
+  int index = target_index;
+  while (true) {
+    costmap_->Map2World(index % width, index / width, iter_pos.pose.position.x, iter_pos.pose.position.y);
+    path.push_back(iter_pos);
+    if (index == static_cast<int>(source_index_)) {
+      break;
+    }
+    const int index_cost = GetCost(index);
+    unsigned int neighbor_mask = neighbors_.GetMask(index);
+    int previous_index = -1;
+    for (int j = 0; j < GridNeighbors::kNeighborNum && previous_index < 0; ++j) {
+      int neighbor_index = index + moves[j].offset;
+      if ((neighbor_mask & (1u << j)) && GetCost(neighbor_index) != kUnreachable
+          && GetCost(neighbor_index) + moves[j].move_cost + cost[index] == index_cost) {
+        previous_index = neighbor_index;
+      }
+    }
+    if (previous_index < 0) {
+      path.clear();
+      return false;
+    }
+    index = previous_index;
+  }
+  std::reverse(path.begin(), path.end());
+  return true;
+}
+
+bool CostToGoField::ExtractPath(const geometry_msgs::PoseStamped &goal,
+                                std::vector<geometry_msgs::PoseStamped> &path) const {
+  unsigned int x, y;
+  if (!costmap_ || !costmap_->World2Map(goal.pose.position.x, goal.pose.position.y, x, y)
+      || !ExtractPath(costmap_->GetIndex(x, y), path)) {
+    path.clear();
+    return false;
+  }
+  path.back().pose.orientation = goal.pose.orientation;
+  return true;
+}
+
+} //namespace roborts_global_planner
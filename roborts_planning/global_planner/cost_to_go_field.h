@@ -0,0 +1,139 @@
+/****************************************************************************
+ *  Copyright (C) 2019 RoboMaster.
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program. If not, see <http://www.gnu.org/licenses/>.
+ ***************************************************************************/
+#ifndef ROBORTS_PLANNING_GLOBAL_PLANNER_COST_TO_GO_FIELD_H
+#define ROBORTS_PLANNING_GLOBAL_PLANNER_COST_TO_GO_FIELD_H
+
+#include <atomic>
+#include <limits>
+#include <memory>
+#include <vector>
+
+#include <geometry_msgs/PoseStamped.h>
+
+#include "thread_pool/thread_pool.h"
+#include "costmap/costmap_interface.h"
+
+#include "search_arena.h"
+
+namespace roborts_global_planner{
+
+/**
+ * @brief Cost of the cheapest path from one source cell to every cell of a costmap, with the move costs of the
+ *        A star planner, so many candidate goals can be compared and planned to with a single search.
+ *
+ * The field is computed by delta-stepping, a Dijkstra search which settles a whole bucket of cells with costs in
+ * [i * delta, (i + 1) * delta) at once instead of one cell at a time. The cells of a bucket are relaxed in parallel,
+ * light moves of at most delta cost first and again until the bucket is settled, then the heavy moves which always
+ * lead to a later bucket. The costs are the same as a sequential search would find.
+ */
+class CostToGoField {
+ public:
+  //! Cost of a cell which can not be reached from the source
+  static const int kUnreachable = std::numeric_limits<int>::max();
+
+  /**
+   * @brief Constructor of the field.
+   * @param thread_num Number of threads relaxing the moves of a bucket, including the caller
+   * @param bucket_width Cost range delta of a bucket
+   */
+  CostToGoField(unsigned int thread_num, int bucket_width);
+  /**
+   * @brief Compute the field from the robot pose in the latest costmap snapshot.
+   * @param costmap_ptr The costmap to compute in
+   * @param inaccessible_cost Lowest cost of the cells which can not be entered
+   * @return True if the robot pose is inside the costmap
+   */
+  bool Compute(const std::shared_ptr<roborts_costmap::CostmapInterface> &costmap_ptr,
+               unsigned int inaccessible_cost);
+  /**
+   * @brief Compute the field from a source cell.
+   * @param costmap Costmap snapshot to compute in, kept for the path extraction
+   * @param source_index Index of the source cell
+   * @param inaccessible_cost Lowest cost of the cells which can not be entered
+   */
+  void Compute(const std::shared_ptr<const roborts_costmap::Costmap2D> &costmap, unsigned int source_index,
+               unsigned int inaccessible_cost);
+  /**
+   * @brief Get the cost of the cheapest path from the source to a cell.
+   * @param index Index of the cell
+   * @return The cost, kUnreachable if the cell can not be reached
+   */
+  int GetCost(unsigned int index) const {
+    return cost_[index].load(std::memory_order_relaxed);
+  }
+  /**
+   * @brief Get the cost of the cheapest path from the source to a pose.
+   * @param pose The pose in the costmap frame
+   * @return The cost, kUnreachable if the pose can not be reached or is outside of the costmap
+   */
+  int GetCost(const geometry_msgs::PoseStamped &pose) const;
+  /**
+   * @brief Get the cheapest path from the source to a cell.
+   * @param target_index Index of the cell
+   * @param path Path output from the source to the target
+   * @return True if the cell can be reached
+   */
+  bool ExtractPath(unsigned int target_index, std::vector<geometry_msgs::PoseStamped> &path) const;
+  /**
+   * @brief Get the cheapest path from the source to a pose.
+   * @param goal The pose in the costmap frame, also the orientation of the last pose of the path
+   * @param path Path output from the source to the goal
+   * @return True if the pose can be reached
+   */
+  bool ExtractPath(const geometry_msgs::PoseStamped &goal, std::vector<geometry_msgs::PoseStamped> &path) const;
+  /**
+   * @brief Get the costmap snapshot the field was computed in, null before the first computation.
+   */
+  std::shared_ptr<const roborts_costmap::Costmap2D> GetCostmap() const {
+    return costmap_;
+  }
+
+ private:
+  /**
+   * @brief Relax the light or the heavy moves out of some cells in parallel, and queue the improved cells in the
+   *        buckets of their new costs.
+   */
+  void RelaxMoves(const std::vector<int> &cells, bool light);
+
+  //! Cost range of a bucket
+  int bucket_width_;
+  //! Threads relaxing the moves, null if the caller relaxes them alone
+  std::unique_ptr<roborts_common::ThreadPool> pool_;
+  //! Costmap snapshot of the field
+  std::shared_ptr<const roborts_costmap::Costmap2D> costmap_;
+  //! Lowest cost of the cells which can not be entered
+  unsigned int inaccessible_cost_;
+  //! Source cell of the field
+  unsigned int source_index_;
+  //! Neighbor moves of the map
+  GridNeighbors neighbors_;
+  //! Cost of every cell, lowered by the threads with compare and swap
+  std::unique_ptr<std::atomic<int>[]> cost_;
+  size_t cell_num_;
+  //! Cost every cell had when its light moves were relaxed last, to skip the cells queued again at the same cost
+  std::vector<int> relaxed_cost_;
+  //! Cells queued in every bucket, may hold stale entries of cells which moved to a lower bucket since
+  std::vector<std::vector<int>> buckets_;
+  //! Cells of the current bucket which are relaxed next, and every cell settled in the current bucket
+  std::vector<int> frontier_, settled_;
+  //! Cells improved by every thread in the current relaxation
+  std::vector<std::vector<int>> improved_cells_;
+};
+
+} //namespace roborts_global_planner
+
+#endif // ROBORTS_PLANNING_GLOBAL_PLANNER_COST_TO_GO_FIELD_H
@@ -0,0 +1,296 @@
+/****************************************************************************
+ *  Copyright (C) 2019 RoboMaster.
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program. If not, see <http://www.gnu.org/licenses/>.
+ ***************************************************************************/
+
+#include "d_star_lite_planner.h"
+
+namespace roborts_global_planner{
+
+using roborts_common::ErrorCode;
+using roborts_common::ErrorInfo;
+
+const int DStarLitePlanner::kInfinity;
+
+DStarLitePlanner::DStarLitePlanner(CostmapPtr costmap_ptr) :
+    GlobalPlannerBase::GlobalPlannerBase(costmap_ptr),
+    is_searching_(false),
+    sequence_(0),
+    width_(0),
+    height_(0),
+    goal_index_(-1),
+    start_index_(-1),
+    key_modifier_(0),
+    generation_(0) {
+
+  DStarLitePlannerConfig d_star_lite_planner_config;
+  std::string full_path = ros::package::getPath("roborts_planning") + "/global_planner/d_star_lite_planner/"\
+      "config/d_star_lite_planner_config.prototxt";
+
+  if (!roborts_common::ReadProtoFromTextFile(full_path.c_str(),
+                                             &d_star_lite_planner_config)) {
+    ROS_ERROR("Cannot load d star lite planner protobuf configuration file.");
+  }
+  inaccessible_cost_ = d_star_lite_planner_config.inaccessible_cost();
+  goal_search_tolerance_ = d_star_lite_planner_config.goal_search_tolerance()/
+      costmap_ptr->GetCostMap()->GetResolution();
+  max_repair_cells_ = d_star_lite_planner_config.max_repair_cells();
+}
+
+DStarLitePlanner::~DStarLitePlanner(){
+}
+
+ErrorInfo DStarLitePlanner::Plan(const geometry_msgs::PoseStamped &start,
+                                 const geometry_msgs::PoseStamped &goal,
+                                 std::vector<geometry_msgs::PoseStamped> &path) {
+
+  // plan on the latest costmap snapshot and learn which cells changed since the snapshot of the last plan
+  roborts_costmap::SnapshotChanges changes;
+  return PlanWithSearch(costmap_ptr_->GetCostMapSnapshot(sequence_, changes), start, goal, inaccessible_cost_,
+                        goal_search_tolerance_,
+                        [this, &changes](const roborts_costmap::Costmap2D &costmap, int start_index, int goal_index,
+                                         std::vector<geometry_msgs::PoseStamped> &path) {
+                          return SearchPath(costmap, changes, start_index, goal_index, path);
+                        }, path);
+}
+
+void DStarLitePlanner::Reset(const roborts_costmap::Costmap2D &costmap, int goal_index) {
+  const unsigned int width = costmap.GetSizeXCell(), height = costmap.GetSizeYCell();
+  const size_t cell_num = static_cast<size_t>(width) * height;
+  if (static_cast<int>(width) != width_ || static_cast<int>(height) != height_) {
+    width_ = width;
+    height_ = height;
+    neighbors_.Resize(width, height);
+    nodes_.assign(cell_num, Node{kInfinity, kInfinity, 0});
+    generation_ = 0;
+    open_list_.Resize(cell_num);
+  }
+  if (++generation_ == 0) {
+    // every stamp could match again after the wrap around
+    for (auto &node : nodes_) {
+      node.generation = 0;
+    }
+    generation_ = 1;
+  }
+  cost_.assign(costmap.GetCharMap(), costmap.GetCharMap() + cell_num);
+  open_list_.Clear();
+  goal_index_ = goal_index;
+  key_modifier_ = 0;
+  GetNode(goal_index).rhs = 0;
+  open_list_.Push(goal_index, GetKey(goal_index));
+  is_searching_ = true;
+}
+
+bool DStarLitePlanner::RepairChangedCells(const roborts_costmap::Costmap2D &costmap,
+                                          const roborts_costmap::SnapshotChanges &changes) {
+  const unsigned char *cost = costmap.GetCharMap();
+  changed_cells_.clear();
+  for (unsigned int y = changes.y0; y < changes.yn; ++y) {
+    for (unsigned int x = changes.x0; x < changes.xn; ++x) {
+      int index = y * width_ + x;
+      if (cost[index] != cost_[index]) {
+        if (changed_cells_.size() == max_repair_cells_) {
+          return false;
+        }
+        changed_cells_.push_back(index);
+      }
+    }
+  }
+
+  // the cost of a cell is paid by the moves into it, so only the rhs of its neighbors can change
+  const std::array<NeighborMove, GridNeighbors::kNeighborNum> &moves = neighbors_.GetMoves();
+  for (int index : changed_cells_) {
+    const unsigned char old_cost = cost_[index];
+    cost_[index] = cost[index];
+    const int g = GetNode(index).g;
+    unsigned int neighbor_mask = neighbors_.GetMask(index);
+    for (int i = 0; i < GridNeighbors::kNeighborNum; ++i) {
+      int neighbor_index = index + moves[i].offset;
+      if (!(neighbor_mask & (1u << i)) || neighbor_index == goal_index_) {
+        continue;
+      }
+      // the move back from the neighbor has the same length as move i
+      int old_move_cost = old_cost < inaccessible_cost_ ? moves[i].move_cost + old_cost : kInfinity;
+      int new_move_cost = GetMoveCost(moves[i], index);
+      Node &neighbor_node = GetNode(neighbor_index);
+      if (new_move_cost < old_move_cost) {
+        neighbor_node.rhs = std::min(neighbor_node.rhs, new_move_cost + g);
+      } else if (new_move_cost > old_move_cost && neighbor_node.rhs == old_move_cost + g) {
+        neighbor_node.rhs = GetLookahead(neighbor_index);
+      } else {
+        continue;
+      }
+      UpdateVertex(neighbor_index);
+    }
+  }
+  return true;
+}
+
+int DStarLitePlanner::GetLookahead(int index) {
+  const std::array<NeighborMove, GridNeighbors::kNeighborNum> &moves = neighbors_.GetMoves();
+  unsigned int neighbor_mask = neighbors_.GetMask(index);
+  int rhs = kInfinity;
+  for (int i = 0; i < GridNeighbors::kNeighborNum; ++i) {
+    if (!(neighbor_mask & (1u << i))) {
+      continue;
+    }
+    int neighbor_index = index + moves[i].offset;
+    int move_cost = GetMoveCost(moves[i], neighbor_index);
+    if (move_cost < kInfinity) {
+      rhs = std::min(rhs, move_cost + GetNode(neighbor_index).g);
+    }
+  }
+  return rhs;
+}
+
+void DStarLitePlanner::UpdateVertex(int index) {
+  const Node &node = GetNode(index);
+  if (node.g != node.rhs) {
+    // queues the cell, or moves it if it is already queued
+    open_list_.Push(index, GetKey(index));
+  } else if (open_list_.Contains(index)) {
+    open_list_.Remove(index);
+  }
+}
+
+int DStarLitePlanner::ComputeShortestPath() {
+  const std::array<NeighborMove, GridNeighbors::kNeighborNum> &moves = neighbors_.GetMoves();
+  int count = 0;
+  while (!open_list_.Empty()) {
+    const Node &start_node = GetNode(start_index_);
+    if (!(open_list_.TopKey() < GetKey(start_index_)) && start_node.rhs <= start_node.g) {
+      break;
+    }
+    int current_index = open_list_.Top();
+    Key new_key = GetKey(current_index);
+    if (open_list_.TopKey() < new_key) {
+      // queued before the start moved
+      open_list_.Update(current_index, new_key);
+      continue;
+    }
+    count++;
+
+    Node &current_node = GetNode(current_index);
+    unsigned int neighbor_mask = neighbors_.GetMask(current_index);
+    if (current_node.g > current_node.rhs) {
+      current_node.g = current_node.rhs;
+      open_list_.Remove(current_index);
+      for (int i = 0; i < GridNeighbors::kNeighborNum; ++i) {
+        int neighbor_index = current_index + moves[i].offset;
+        if (!(neighbor_mask & (1u << i)) || neighbor_index == goal_index_) {
+          continue;
+        }
+        Node &neighbor_node = GetNode(neighbor_index);
+        int rhs = GetMoveCost(moves[i], current_index) + current_node.g;
+        if (rhs < neighbor_node.rhs) {
+          neighbor_node.rhs = rhs;
+          UpdateVertex(neighbor_index);
+        }
+      }
+    } else {
+      // the cell got more expensive, every neighbor which went through it looks for another successor
+      const int old_g = current_node.g;
+      current_node.g = kInfinity;
+      for (int i = 0; i < GridNeighbors::kNeighborNum; ++i) {
+        int neighbor_index = current_index + moves[i].offset;
+        if (!(neighbor_mask & (1u << i)) || neighbor_index == goal_index_) {
+          continue;
+        }
+        Node &neighbor_node = GetNode(neighbor_index);
+        if (neighbor_node.rhs == GetMoveCost(moves[i], current_index) + old_g) {
+          neighbor_node.rhs = GetLookahead(neighbor_index);
+          UpdateVertex(neighbor_index);
+        }
+      }
+      UpdateVertex(current_index);
+    }
+  }
+  return count;
+}
+
+int DStarLitePlanner::GetOctileDistance(int index1, int index2) const {
+  int dx = std::abs(index1 % width_ - index2 % width_);
+  int dy = std::abs(index1 / width_ - index2 / width_);
+  return 10 * std::max(dx, dy) + 4 * std::min(dx, dy);
+}
+
+ErrorInfo DStarLitePlanner::SearchPath(const roborts_costmap::Costmap2D &costmap,
+                                       const roborts_costmap::SnapshotChanges &changes,
+                                       const int &start_index,
+                                       const int &goal_index,
+                                       std::vector<geometry_msgs::PoseStamped> &path) {
+  // the search can be repaired as long as it searches from the same goal in the same map
+  bool is_repaired = false;
+  if (is_searching_ && changes.is_bounded && goal_index == goal_index_ &&
+      static_cast<int>(costmap.GetSizeXCell()) == width_ && static_cast<int>(costmap.GetSizeYCell()) == height_) {
+    key_modifier_ += GetOctileDistance(start_index_, start_index);
+    start_index_ = start_index;
+    is_repaired = RepairChangedCells(costmap, changes);
+  }
+  if (!is_repaired) {
+    start_index_ = start_index;
+    Reset(costmap, goal_index);
+  }
+  sequence_ = changes.sequence;
+
+  int count = ComputeShortestPath();
+  expansion_num_ += count;
+  ROS_INFO("Search takes %d cycle counts", count);
+  if (GetNode(start_index_).rhs >= kInfinity) {
+    ROS_WARN("Global planner can't search the valid path!");
+    return ErrorInfo(ErrorCode::GP_PATH_SEARCH_ERROR, "Valid global path not found.");
+  }
+
+  // follow the cheapest successors from the start down to the goal
+  const std::array<NeighborMove, GridNeighbors::kNeighborNum> &moves = neighbors_.GetMoves();
+  unsigned int iter_x, iter_y;
+  geometry_msgs::PoseStamped iter_pos;
+  iter_pos.pose.orientation.w = 1;
+  iter_pos.header.frame_id = "map";
+  path.clear();
+  int iter_index = start_index_;
+  const size_t max_length = nodes_.size();
+  while (true) {
+    costmap.Index2Cells(iter_index, iter_x, iter_y);
+    costmap.Map2World(iter_x, iter_y, iter_pos.pose.position.x, iter_pos.pose.position.y);
+    path.push_back(iter_pos);
+    if (iter_index == goal_index_) {
+      break;
+    }
+    int next_index = -1, next_score = kInfinity;
+    unsigned int neighbor_mask = neighbors_.GetMask(iter_index);
+    for (int i = 0; i < GridNeighbors::kNeighborNum; ++i) {
+      if (!(neighbor_mask & (1u << i))) {
+        continue;
+      }
+      int neighbor_index = iter_index + moves[i].offset;
+      int score = GetMoveCost(moves[i], neighbor_index) + GetNode(neighbor_index).g;
+      if (score < next_score) {
+        next_score = score;
+        next_index = neighbor_index;
+      }
+    }
+    if (next_index < 0 || path.size() > max_length) {
+      ROS_WARN("Global planner can't follow the search to the goal!");
+      path.clear();
+      return ErrorInfo(ErrorCode::GP_PATH_SEARCH_ERROR, "Valid global path not found.");
+    }
+    iter_index = next_index;
+  }
+
+  return ErrorInfo(ErrorCode::OK);
+}
+
+} //namespace roborts_global_planner
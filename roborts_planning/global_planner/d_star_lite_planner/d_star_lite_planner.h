@@ -0,0 +1,189 @@
+/****************************************************************************
+ *  Copyright (C) 2019 RoboMaster.
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program. If not, see <http://www.gnu.org/licenses/>.
+ ***************************************************************************/
+#ifndef ROBORTS_PLANNING_GLOBAL_PLANNER_D_STAR_LITE_PLANNER_H
+#define ROBORTS_PLANNING_GLOBAL_PLANNER_D_STAR_LITE_PLANNER_H
+
+#include <utility>
+
+#include <ros/ros.h>
+#include <geometry_msgs/PoseStamped.h>
+
+#include "proto/d_star_lite_planner_config.pb.h"
+
+#include "alg_factory/algorithm_factory.h"
+#include "state/error_code.h"
+#include "costmap/costmap_interface.h"
+
+#include "../global_planner_base.h"
+#include "../search_arena.h"
+
+namespace roborts_global_planner{
+
+/**
+ * @brief Global planner algorithm class for D* Lite under the representation of costmap. The search runs from the
+ *        goal to the start and is kept between plans, so while the goal stays the same a plan only repairs the
+ *        part of the search affected by the cells which changed since the last plan and by the moved start.
+ *        Moves cost the same as in the A star planner.
+ */
+class DStarLitePlanner : public GlobalPlannerBase {
+
+ public:
+  /**
+   * @brief Constructor of D* Lite planner, set the costmap pointer and relevant costmap size.
+   * @param costmap_ptr The shared pointer of costmap interface
+   */
+  DStarLitePlanner(CostmapPtr costmap_ptr);
+  virtual ~DStarLitePlanner();
+  /**
+   * @brief Main Plan function(override the base-class function)
+   * @param start Start pose input
+   * @param goal Goal pose input
+   * @param path Global plan path output
+   * @return ErrorInfo which is OK if succeed
+   */
+  roborts_common::ErrorInfo Plan(const geometry_msgs::PoseStamped &start,
+                                 const geometry_msgs::PoseStamped &goal,
+                                 std::vector<geometry_msgs::PoseStamped> &path);
+
+ private:
+  //! Priority of a queued cell, compared first by the f score and then by the g score
+  typedef std::pair<int, int> Key;
+  /**
+   * @brief Search data of a cell.
+   */
+  struct Node {
+    //! Cost from this cell to the goal as of its last expansion
+    int g;
+    //! One step lookahead of g from the successors of this cell
+    int rhs;
+    //! Search the data belongs to, data of an older search reads as a cell not touched yet
+    uint32_t generation;
+  };
+
+  /**
+   * @brief Search a path between two cells, repairing the search of the last plan if the goal is the same.
+   * @param costmap costmap snapshot to search in
+   * @param changes cells which changed since the snapshot of the last plan
+   * @param start_index start pose index in the 1D costmap list
+   * @param goal_index goal pose index in the 1D costmap list
+   * @param path plan path output
+   * @return ErrorInfo which is OK if succeed
+   */
+  roborts_common::ErrorInfo SearchPath(const roborts_costmap::Costmap2D &costmap,
+                                       const roborts_costmap::SnapshotChanges &changes,
+                                       const int &start_index,
+                                       const int &goal_index,
+                                       std::vector<geometry_msgs::PoseStamped> &path);
+  /**
+   * @brief Drop the search and start a new one from the goal.
+   * @param costmap costmap snapshot to search in
+   * @param goal_index goal pose index in the 1D costmap list
+   */
+  void Reset(const roborts_costmap::Costmap2D &costmap, int goal_index);
+  /**
+   * @brief Copy the costs of the changed cells and update the cells they can be entered from.
+   * @param costmap costmap snapshot to search in
+   * @param changes cells which changed since the snapshot of the last plan
+   * @return False if too many cells changed, in which case nothing was updated
+   */
+  bool RepairChangedCells(const roborts_costmap::Costmap2D &costmap,
+                          const roborts_costmap::SnapshotChanges &changes);
+  /**
+   * @brief Expand cells until the g score of the start cell is final.
+   * @return Number of expanded cells
+   */
+  int ComputeShortestPath();
+  /**
+   * @brief Queue a cell whose g score and rhs differ, otherwise take it out of the open list.
+   */
+  void UpdateVertex(int index);
+  /**
+   * @brief Calculate the rhs of a cell from its successors.
+   */
+  int GetLookahead(int index);
+  /**
+   * @brief Get the search data of a cell, resetting it if the cell is touched first in this search.
+   */
+  inline Node &GetNode(int index) {
+    Node &node = nodes_[index];
+    if (node.generation != generation_) {
+      node.g = kInfinity;
+      node.rhs = kInfinity;
+      node.generation = generation_;
+    }
+    return node;
+  }
+  /**
+   * @brief Get the cost of moving into a cell, kInfinity if the cell is inaccessible.
+   */
+  inline int GetMoveCost(const NeighborMove &move, int index) const {
+    return cost_[index] < inaccessible_cost_ ? move.move_cost + cost_[index] : kInfinity;
+  }
+  /**
+   * @brief Calculate the key of a cell in the open list.
+   */
+  inline Key GetKey(int index) {
+    const Node &node = GetNode(index);
+    int g = std::min(node.g, node.rhs);
+    return Key(g + GetOctileDistance(start_index_, index) + key_modifier_, g);
+  }
+  /**
+   * @brief Calculate the octile distance between two cells used as the heuristic function.
+   */
+  int GetOctileDistance(int index1, int index2) const;
+
+  //! Score of a cell which can not reach the goal, low enough to add the heuristic without overflow
+  static const int kInfinity = std::numeric_limits<int>::max() / 4;
+  //! inaccessible_cost
+  unsigned int inaccessible_cost_;
+  //! goal_search_tolerance
+  unsigned int goal_search_tolerance_;
+  //! Most changed cells a plan repairs, more changes start a new search
+  unsigned int max_repair_cells_;
+  //! Whether a search is kept
+  bool is_searching_;
+  //! Sequence number of the costmap snapshot cost_ is a copy of
+  uint64_t sequence_;
+  //! Size of the map of the search
+  int width_, height_;
+  //! Goal cell of the search, where it starts from
+  int goal_index_;
+  //! Start cell of the search and the start cell when the key modifier was last updated
+  int start_index_;
+  //! Sum of the heuristic distances the start moved, added to the keys instead of queueing every cell again
+  int key_modifier_;
+  //! Costs of the snapshot the search is consistent with
+  std::vector<unsigned char> cost_;
+  //! g score and rhs of every cell, reset lazily by incrementing generation_
+  std::vector<Node> nodes_;
+  uint32_t generation_;
+  //! Neighbor moves and masks of the map
+  GridNeighbors neighbors_;
+  //! Cells whose g score and rhs differ
+  IndexedHeap<Key> open_list_;
+  //! Cells whose cost changed in the current plan
+  std::vector<int> changed_cells_;
+};
+
+roborts_common::REGISTER_ALGORITHM(GlobalPlannerBase,
+                                   "d_star_lite_planner",
+                                   DStarLitePlanner,
+                                   std::shared_ptr<roborts_costmap::CostmapInterface>);
+
+} //namespace roborts_global_planner
+
+#endif // ROBORTS_PLANNING_GLOBAL_PLANNER_D_STAR_LITE_PLANNER_H
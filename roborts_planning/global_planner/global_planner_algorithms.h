@@ -18,5 +18,9 @@
 #define ROBORTS_PLANNING_GLOBAL_PLANNER_GLOBAL_PLANNER_ALGORITHM_H
 
 #include "a_star_planner/a_star_planner.h"
+#include "jps_planner/jps_planner.h"
+#include "d_star_lite_planner/d_star_lite_planner.h"
+#include "hpa_planner/hpa_planner.h"
+#include "ara_star_planner/ara_star_planner.h"
 
 #endif // ROBORTS_PLANNING_GLOBAL_PLANNER_GLOBAL_PLANNER_ALGORITHM_H
\ No newline at end of file
@@ -17,6 +17,8 @@
 #ifndef ROBORTS_PLANNING_GLOBAL_PLANNER_GLOBAL_PLANNER_BASE_H
 #define ROBORTS_PLANNING_GLOBAL_PLANNER_GLOBAL_PLANNER_BASE_H
 
+#include <functional>
+
 #include "state/error_code.h"
 
 #include "costmap/costmap_interface.h"
@@ -28,16 +30,136 @@ class GlobalPlannerBase {
   typedef std::shared_ptr<roborts_costmap::CostmapInterface> CostmapPtr;
 
   GlobalPlannerBase(CostmapPtr costmap_ptr)
-      : costmap_ptr_(costmap_ptr) {
+      : costmap_ptr_(costmap_ptr),
+        expansion_num_(0) {
   };
   virtual ~GlobalPlannerBase() = default;
 
   virtual roborts_common::ErrorInfo Plan(const geometry_msgs::PoseStamped &start,
                                        const geometry_msgs::PoseStamped &goal,
                                        std::vector<geometry_msgs::PoseStamped> &path) = 0;
+  /**
+   * @brief Get the number of cells expanded by the searches of all plans so far, including the failed ones.
+   */
+  long GetExpansionNum() const {
+    return expansion_num_;
+  }
+  /**
+   * @brief Keep the planner from reading and writing the files it caches preprocessed maps in, so that runs on
+   *        other maps, like benchmarks, leave the caches of the robot alone.
+   */
+  virtual void DisableCache() {
+  }
 
  protected:
+  //! Search between two different accessible cells of a costmap snapshot, the path ends in the goal cell
+  typedef std::function<roborts_common::ErrorInfo(const roborts_costmap::Costmap2D &costmap,
+                                                  int start_index,
+                                                  int goal_index,
+                                                  std::vector<geometry_msgs::PoseStamped> &path)> CellSearch;
+
+  /**
+   * @brief Plan on a costmap snapshot around a cell search: resolve the start and goal cells, answer a goal in the
+   *        start cell without searching and give the last pose of a found path the goal orientation and height.
+   * @param costmap Costmap snapshot to plan in, null before the first costmap update
+   * @param start Start pose input
+   * @param goal Goal pose input
+   * @param inaccessible_cost Lowest cost of the cells which can not be passed
+   * @param goal_search_tolerance Half size of the window to look for an accessible goal cell in, in cells
+   * @param search Search between the start and goal cells
+   * @param path Global plan path output
+   * @return ErrorInfo which is OK if succeed
+   */
+  roborts_common::ErrorInfo PlanWithSearch(const std::shared_ptr<const roborts_costmap::Costmap2D> &costmap,
+                                           const geometry_msgs::PoseStamped &start,
+                                           const geometry_msgs::PoseStamped &goal,
+                                           unsigned int inaccessible_cost,
+                                           unsigned int goal_search_tolerance,
+                                           const CellSearch &search,
+                                           std::vector<geometry_msgs::PoseStamped> &path) const {
+    if (!costmap) {
+      ROS_WARN("Costmap has not been updated yet");
+      return roborts_common::ErrorInfo(roborts_common::ErrorCode::GP_INITILIZATION_ERROR,
+                                       "Costmap has not been updated yet.");
+    }
+
+    unsigned int start_index, goal_index;
+    roborts_common::ErrorInfo error_info = GetStartAndGoal(*costmap, start, goal, inaccessible_cost,
+                                                           goal_search_tolerance, start_index, goal_index);
+    if (!error_info.IsOK()) {
+      path.clear();
+    } else if (start_index == goal_index) {
+      path.clear();
+      path.push_back(start);
+      path.push_back(goal);
+    } else {
+      error_info = search(*costmap, start_index, goal_index, path);
+      if (error_info.IsOK()) {
+        path.back().pose.orientation = goal.pose.orientation;
+        path.back().pose.position.z = goal.pose.position.z;
+      }
+    }
+    return error_info;
+  }
+
+  /**
+   * @brief Get the start and goal cells of a plan, an inaccessible goal cell is moved to the nearest accessible cell
+   *        within the goal search tolerance.
+   * @param costmap Costmap snapshot to plan in
+   * @param start Start pose input
+   * @param goal Goal pose input
+   * @param inaccessible_cost Lowest cost of the cells which can not be passed
+   * @param goal_search_tolerance Half size of the window to look for an accessible goal cell in, in cells
+   * @param start_index Index of the start cell as output
+   * @param goal_index Index of the goal cell as output
+   * @return ErrorInfo which is OK if succeed
+   */
+  roborts_common::ErrorInfo GetStartAndGoal(const roborts_costmap::Costmap2D &costmap,
+                                            const geometry_msgs::PoseStamped &start,
+                                            const geometry_msgs::PoseStamped &goal,
+                                            unsigned int inaccessible_cost,
+                                            unsigned int goal_search_tolerance,
+                                            unsigned int &start_index,
+                                            unsigned int &goal_index) const {
+    unsigned int start_x, start_y, goal_x, goal_y;
+    if (!costmap.World2Map(start.pose.position.x, start.pose.position.y, start_x, start_y)) {
+      ROS_WARN("Failed to transform start pose from map frame to costmap frame");
+      return roborts_common::ErrorInfo(roborts_common::ErrorCode::GP_POSE_TRANSFORM_ERROR,
+                                       "Start pose can't be transformed to costmap frame.");
+    }
+    if (!costmap.World2Map(goal.pose.position.x, goal.pose.position.y, goal_x, goal_y)) {
+      ROS_WARN("Failed to transform goal pose from map frame to costmap frame");
+      return roborts_common::ErrorInfo(roborts_common::ErrorCode::GP_POSE_TRANSFORM_ERROR,
+                                       "Goal pose can't be transformed to costmap frame.");
+    }
+    start_index = costmap.GetIndex(start_x, start_y);
+    if (costmap.GetCost(goal_x, goal_y) < inaccessible_cost) {
+      goal_index = costmap.GetIndex(goal_x, goal_y);
+      return roborts_common::ErrorInfo::OK();
+    }
+    unsigned int shortest_dist = std::numeric_limits<unsigned int>::max();
+    unsigned int min_x = goal_x > goal_search_tolerance ? goal_x - goal_search_tolerance : 0;
+    unsigned int min_y = goal_y > goal_search_tolerance ? goal_y - goal_search_tolerance : 0;
+    unsigned int max_x = std::min(goal_x + goal_search_tolerance, costmap.GetSizeXCell() - 1);
+    unsigned int max_y = std::min(goal_y + goal_search_tolerance, costmap.GetSizeYCell() - 1);
+    for (unsigned int y = min_y; y <= max_y; ++y) {
+      for (unsigned int x = min_x; x <= max_x; ++x) {
+        unsigned int dist = (x > goal_x ? x - goal_x : goal_x - x) + (y > goal_y ? y - goal_y : goal_y - y);
+        if (costmap.GetCost(x, y) < inaccessible_cost && dist < shortest_dist) {
+          shortest_dist = dist;
+          goal_index = costmap.GetIndex(x, y);
+        }
+      }
+    }
+    if (shortest_dist == std::numeric_limits<unsigned int>::max()) {
+      return roborts_common::ErrorInfo(roborts_common::ErrorCode::GP_GOAL_INVALID_ERROR);
+    }
+    return roborts_common::ErrorInfo::OK();
+  }
+
   CostmapPtr costmap_ptr_;
+  //! Number of cells expanded by the searches so far
+  long expansion_num_;
 };
 
 } //namespace roborts_global_planner
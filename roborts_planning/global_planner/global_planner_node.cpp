@@ -57,6 +57,15 @@ ErrorInfo GlobalPlannerNode::Init() {
   max_retries_ = global_planner_config.max_retries();
   goal_distance_tolerance_ = global_planner_config.goal_distance_tolerance();
   goal_angle_tolerance_ = global_planner_config.goal_angle_tolerance();
+  if (global_planner_config.use_path_cache()) {
+    path_cache_.reset(new PathCache(global_planner_config.path_cache_max_cost_ratio(),
+                                    global_planner_config.path_cache_max_deviation(),
+                                    global_planner_config.path_cache_max_reuse()));
+  }
+  if (global_planner_config.use_path_shortcut()) {
+    path_shortcut_.reset(new PathShortcut(global_planner_config.path_shortcut_max_length(),
+                                          roborts_costmap::INSCRIBED_INFLATED_OBSTACLE));
+  }
 
   // ROS path visualize
   ros::NodeHandle viz_nh("~");
@@ -227,7 +236,6 @@ void GlobalPlannerNode::PlanThread() {
     std::chrono::steady_clock::time_point start_time = std::chrono::steady_clock::now();
 
     {
-      std::unique_lock<roborts_costmap::Costmap2D::mutex_t> lock(*(costmap_ptr_->GetCostMap()->GetMutex()));
       bool error_set = false;
       //Get the robot current pose
       while (!costmap_ptr_->GetRobotPose(current_start)) {
@@ -247,15 +255,30 @@ void GlobalPlannerNode::PlanThread() {
         SetGoal(current_goal);
       }
 
-      //Plan
-      error_info = global_planner_ptr_->Plan(current_start, current_goal, current_path);
+      //Plan, unless the last path is still valid
+      if (path_cache_ && path_cache_->Reuse(costmap_ptr_, current_start, current_goal, current_path)) {
+        ROS_INFO("Reuse the last path.");
+        error_info = ErrorInfo::OK();
+      } else {
+        error_info = global_planner_ptr_->Plan(current_start, current_goal, current_path);
+        if (path_cache_ && error_info.IsOK()) {
+          path_cache_->Store(costmap_ptr_, current_path.back(), current_path);
+        }
+      }
 
     }
 
     if (error_info.IsOK()) {
       //When planner succeed, reset the retry times
       retries = 0;
-      PathVisualization(current_path);
+      //The cache keeps the grid path, only the published path is shortcut
+      std::shared_ptr<const roborts_costmap::Costmap2D> costmap = costmap_ptr_->GetCostMapSnapshot();
+      if (path_shortcut_ && costmap) {
+        path_shortcut_->Shortcut(*costmap, current_path, waypoints_);
+        PathVisualization(waypoints_);
+      } else {
+        PathVisualization(current_path);
+      }
 
       //Set the goal to avoid the same goal from getting transformed every time
       current_goal = current_path.back();
@@ -37,6 +37,8 @@
 #include "global_planner_base.h"
 #include "proto/global_planner_config.pb.h"
 #include "global_planner_algorithms.h"
+#include "path_cache.h"
+#include "path_shortcut.h"
 
 namespace roborts_global_planner{
 
@@ -190,6 +192,12 @@ class GlobalPlannerNode {
   double goal_distance_tolerance_;
   //! Angle tolerance towards goal
   double goal_angle_tolerance_;
+  //! Last path, reused while it stays valid, null if every cycle plans
+  std::unique_ptr<PathCache> path_cache_;
+  //! Shortcut of the paths into sparse waypoints, null if the grid paths are published
+  std::unique_ptr<PathShortcut> path_shortcut_;
+  //! Waypoints of the shortcut path
+  std::vector<geometry_msgs::PoseStamped> waypoints_;
 };
 
 } //namespace roborts_global_planner
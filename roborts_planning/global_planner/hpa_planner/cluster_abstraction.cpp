@@ -0,0 +1,308 @@
+/****************************************************************************
+ *  Copyright (C) 2019 RoboMaster.
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program. If not, see <http://www.gnu.org/licenses/>.
+ ***************************************************************************/
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <limits>
+#include <unordered_map>
+
+#include <ros/ros.h>
+
+#include "costmap/map_common.h"
+
+#include "cluster_abstraction.h"
+
+namespace roborts_global_planner{
+
+namespace {
+
+const char kAbstractionMagic[8] = {'R', 'M', 'H', 'P', 'A', 'G', 'R', 'F'};
+const uint32_t kAbstractionVersion = 1;
+
+/**
+ * @brief Layout of the abstraction cache file. The header is followed by the node cells, the edge offsets of the
+ *        nodes and the edges.
+ */
+struct AbstractionHeader {
+  char magic[8];
+  uint32_t version;
+  uint32_t size_x, size_y;
+  uint32_t cluster_size;
+  uint32_t inaccessible_cost;
+  uint32_t node_num, edge_num;
+  double resolution, origin_x, origin_y;
+  uint64_t map_hash;
+};
+
+} //namespace
+
+bool BoundedSearch::Search(const roborts_costmap::Costmap2D &costmap, unsigned int inaccessible_cost,
+                           const CellBounds &bounds, int source_index, int target_index, bool reverse) {
+  const int width = costmap.GetSizeXCell(), height = costmap.GetSizeYCell();
+  const unsigned char *cost = costmap.GetCharMap();
+  arena_.NewSearch(width, height);
+  open_list_.Resize(static_cast<size_t>(width) * height);
+  open_list_.Clear();
+  // octile distance to the target, which never overestimates the move costs
+  auto heuristic = [&](int index) {
+    if (target_index < 0) {
+      return 0;
+    }
+    int dx = std::abs(index % width - target_index % width), dy = std::abs(index / width - target_index / width);
+    return 10 * std::max(dx, dy) + 4 * std::min(dx, dy);
+  };
+
+  arena_.Node(source_index).g = 0;
+  open_list_.Push(source_index, heuristic(source_index));
+  const std::array<NeighborMove, SearchArena::kNeighborNum> &moves = arena_.GetNeighbors();
+  while (!open_list_.Empty()) {
+    int current_index = open_list_.Pop();
+    SearchNode &current_node = arena_.Node(current_index);
+    current_node.state = SearchState::CLOSED;
+    ++expansion_num_;
+    if (current_index == target_index) {
+      return true;
+    }
+
+    int x = current_index % width, y = current_index / width;
+    unsigned int neighbor_mask = arena_.GetNeighborMask(current_index);
+    for (int i = 0; i < SearchArena::kNeighborNum; ++i) {
+      int neighbor_x = x + moves[i].dx, neighbor_y = y + moves[i].dy;
+      if (!(neighbor_mask & (1u << i)) || neighbor_x < bounds.x0 || neighbor_x >= bounds.xn ||
+          neighbor_y < bounds.y0 || neighbor_y >= bounds.yn) {
+        continue;
+      }
+      int neighbor_index = current_index + moves[i].offset;
+      if (cost[neighbor_index] >= inaccessible_cost) {
+        continue;
+      }
+      SearchNode &neighbor_node = arena_.Node(neighbor_index);
+      if (neighbor_node.state == SearchState::CLOSED) {
+        continue;
+      }
+      // a reverse search moves from the neighbor into the current cell
+      int g_score = current_node.g + moves[i].move_cost + (reverse ? cost[current_index] : cost[neighbor_index]);
+      if (neighbor_node.g > g_score) {
+        neighbor_node.g = g_score;
+        neighbor_node.parent = current_index;
+        open_list_.Push(neighbor_index, g_score + heuristic(neighbor_index));
+        neighbor_node.state = SearchState::OPEN;
+      }
+    }
+  }
+  return target_index < 0;
+}
+
+void BoundedSearch::AppendPath(int target_index, std::vector<int> &cells) {
+  reversed_cells_.clear();
+  for (int index = target_index; arena_.Node(index).parent >= 0; index = arena_.Node(index).parent) {
+    reversed_cells_.push_back(index);
+  }
+  cells.insert(cells.end(), reversed_cells_.rbegin(), reversed_cells_.rend());
+}
+
+void ClusterAbstraction::Build(const roborts_costmap::Costmap2D &costmap, unsigned int cluster_size,
+                               unsigned int inaccessible_cost, uint64_t map_hash, BoundedSearch &search) {
+  width_ = costmap.GetSizeXCell();
+  height_ = costmap.GetSizeYCell();
+  resolution_ = costmap.GetResolution();
+  origin_x_ = costmap.GetOriginX();
+  origin_y_ = costmap.GetOriginY();
+  cluster_size_ = std::max(cluster_size, 2u);
+  inaccessible_cost_ = inaccessible_cost;
+  map_hash_ = map_hash;
+  clusters_x_ = (width_ + cluster_size_ - 1) / cluster_size_;
+  clusters_y_ = (height_ + cluster_size_ - 1) / cluster_size_;
+  const unsigned char *cost = costmap.GetCharMap();
+
+  cells_.clear();
+  std::unordered_map<int, int> cell_nodes;
+  std::vector<std::pair<int, Edge>> edges;
+  auto add_node = [&](int index) {
+    auto node = cell_nodes.emplace(index, static_cast<int>(cells_.size()));
+    if (node.second) {
+      cells_.push_back(index);
+    }
+    return node.first->second;
+  };
+  // every run of passable cell pairs across a border is crossed at its cheapest pair, ties go to the middle of the run
+  auto add_entrances = [&](int first_index, int first_neighbor_index, int step, int length) {
+    int run_start = -1;
+    for (int i = 0; i <= length; ++i) {
+      bool is_open = i < length && cost[first_index + i * step] < inaccessible_cost_ &&
+          cost[first_neighbor_index + i * step] < inaccessible_cost_;
+      if (is_open && run_start < 0) {
+        run_start = i;
+      } else if (!is_open && run_start >= 0) {
+        int best = -1, best_cost = 0, best_offset = 0;
+        for (int j = run_start; j < i; ++j) {
+          int pair_cost = cost[first_index + j * step] + cost[first_neighbor_index + j * step];
+          int offset = std::abs(2 * j - (run_start + i - 1));
+          if (best < 0 || pair_cost < best_cost || (pair_cost == best_cost && offset < best_offset)) {
+            best = j;
+            best_cost = pair_cost;
+            best_offset = offset;
+          }
+        }
+        int index = first_index + best * step, neighbor_index = first_neighbor_index + best * step;
+        int node = add_node(index), neighbor_node = add_node(neighbor_index);
+        edges.emplace_back(node, Edge{neighbor_node, 10 + cost[neighbor_index]});
+        edges.emplace_back(neighbor_node, Edge{node, 10 + cost[index]});
+        run_start = -1;
+      }
+    }
+  };
+  for (unsigned int cluster_y = 0; cluster_y < clusters_y_; ++cluster_y) {
+    for (unsigned int cluster_x = 0; cluster_x < clusters_x_; ++cluster_x) {
+      int x0 = cluster_x * cluster_size_, y0 = cluster_y * cluster_size_;
+      if (cluster_x > 0) {
+        add_entrances(y0 * width_ + x0 - 1, y0 * width_ + x0, width_, std::min(cluster_size_, height_ - y0));
+      }
+      if (cluster_y > 0) {
+        add_entrances((y0 - 1) * width_ + x0, y0 * width_ + x0, 1, std::min(cluster_size_, width_ - x0));
+      }
+    }
+  }
+  IndexClusters();
+
+  // cheapest paths between the nodes of every cluster
+  for (unsigned int cluster = 0; cluster < clusters_x_ * clusters_y_; ++cluster) {
+    CellBounds bounds = GetClusterBounds(cluster);
+    for (const int *node = ClusterNodesBegin(cluster); node != ClusterNodesEnd(cluster); ++node) {
+      search.Search(costmap, inaccessible_cost_, bounds, cells_[*node], -1, false);
+      for (const int *other = ClusterNodesBegin(cluster); other != ClusterNodesEnd(cluster); ++other) {
+        int score = search.GetScore(cells_[*other]);
+        if (*other != *node && score < std::numeric_limits<int>::max()) {
+          edges.emplace_back(*node, Edge{*other, score});
+        }
+      }
+    }
+  }
+
+  edge_begin_.assign(cells_.size() + 1, 0);
+  for (const auto &edge : edges) {
+    ++edge_begin_[edge.first + 1];
+  }
+  for (size_t i = 1; i < edge_begin_.size(); ++i) {
+    edge_begin_[i] += edge_begin_[i - 1];
+  }
+  edges_.resize(edges.size());
+  std::vector<int> edge_end(edge_begin_.begin(), edge_begin_.end() - 1);
+  for (const auto &edge : edges) {
+    edges_[edge_end[edge.first]++] = edge.second;
+  }
+}
+
+void ClusterAbstraction::IndexClusters() {
+  const size_t cluster_num = clusters_x_ * clusters_y_;
+  cluster_begin_.assign(cluster_num + 1, 0);
+  for (int index : cells_) {
+    ++cluster_begin_[GetCluster(index) + 1];
+  }
+  for (size_t i = 1; i <= cluster_num; ++i) {
+    cluster_begin_[i] += cluster_begin_[i - 1];
+  }
+  cluster_nodes_.resize(cells_.size());
+  std::vector<int> cluster_end(cluster_begin_.begin(), cluster_begin_.end() - 1);
+  for (size_t node = 0; node < cells_.size(); ++node) {
+    cluster_nodes_[cluster_end[GetCluster(cells_[node])]++] = node;
+  }
+}
+
+CellBounds ClusterAbstraction::GetClusterBounds(int cluster) const {
+  int x0 = cluster % clusters_x_ * cluster_size_, y0 = cluster / clusters_x_ * cluster_size_;
+  return CellBounds{x0, y0, std::min<int>(x0 + cluster_size_, width_), std::min<int>(y0 + cluster_size_, height_)};
+}
+
+bool ClusterAbstraction::IsValidFor(const roborts_costmap::Costmap2D &costmap, unsigned int cluster_size,
+                                    unsigned int inaccessible_cost, uint64_t map_hash) const {
+  return IsBuilt() && map_hash == map_hash_
+      && cluster_size == cluster_size_ && inaccessible_cost == inaccessible_cost_
+      && costmap.GetSizeXCell() == width_ && costmap.GetSizeYCell() == height_
+      && std::abs(costmap.GetResolution() - resolution_) < 1e-6
+      && std::abs(costmap.GetOriginX() - origin_x_) < 0.5 * resolution_
+      && std::abs(costmap.GetOriginY() - origin_y_) < 0.5 * resolution_;
+}
+
+bool ClusterAbstraction::Save(const std::string &path) const {
+  AbstractionHeader header;
+  memcpy(header.magic, kAbstractionMagic, sizeof(kAbstractionMagic));
+  header.version = kAbstractionVersion;
+  header.size_x = width_;
+  header.size_y = height_;
+  header.cluster_size = cluster_size_;
+  header.inaccessible_cost = inaccessible_cost_;
+  header.node_num = cells_.size();
+  header.edge_num = edges_.size();
+  header.resolution = resolution_;
+  header.origin_x = origin_x_;
+  header.origin_y = origin_y_;
+  header.map_hash = map_hash_;
+
+  if (!roborts_costmap::WriteFileAtomically(path, {{&header, sizeof(header)},
+                                                  {cells_.data(), cells_.size() * sizeof(int)},
+                                                  {edge_begin_.data(), edge_begin_.size() * sizeof(int)},
+                                                  {edges_.data(), edges_.size() * sizeof(Edge)}})) {
+    ROS_WARN("Failed to write the abstraction cache %s", path.c_str());
+    return false;
+  }
+  return true;
+}
+
+bool ClusterAbstraction::Load(const std::string &path) {
+  edge_begin_.clear();
+  FILE *file = fopen(path.c_str(), "rb");
+  if (file == nullptr) {
+    return false;
+  }
+  AbstractionHeader header;
+  bool valid = fread(&header, sizeof(header), 1, file) == 1
+      && memcmp(header.magic, kAbstractionMagic, sizeof(kAbstractionMagic)) == 0
+      && header.version == kAbstractionVersion
+      && header.cluster_size >= 2;
+  if (valid) {
+    cells_.resize(header.node_num);
+    edge_begin_.resize(header.node_num + 1);
+    edges_.resize(header.edge_num);
+    valid = fread(cells_.data(), sizeof(int), cells_.size(), file) == cells_.size()
+        && fread(edge_begin_.data(), sizeof(int), edge_begin_.size(), file) == edge_begin_.size()
+        && fread(edges_.data(), sizeof(Edge), edges_.size(), file) == edges_.size()
+        && fgetc(file) == EOF
+        && edge_begin_.back() == static_cast<int>(header.edge_num);
+  }
+  fclose(file);
+  if (!valid) {
+    edge_begin_.clear();
+    return false;
+  }
+  width_ = header.size_x;
+  height_ = header.size_y;
+  cluster_size_ = header.cluster_size;
+  inaccessible_cost_ = header.inaccessible_cost;
+  resolution_ = header.resolution;
+  origin_x_ = header.origin_x;
+  origin_y_ = header.origin_y;
+  map_hash_ = header.map_hash;
+  clusters_x_ = (width_ + cluster_size_ - 1) / cluster_size_;
+  clusters_y_ = (height_ + cluster_size_ - 1) / cluster_size_;
+  IndexClusters();
+  return true;
+}
+
+} //namespace roborts_global_planner
@@ -0,0 +1,182 @@
+/****************************************************************************
+ *  Copyright (C) 2019 RoboMaster.
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program. If not, see <http://www.gnu.org/licenses/>.
+ ***************************************************************************/
+#ifndef ROBORTS_PLANNING_GLOBAL_PLANNER_HPA_PLANNER_CLUSTER_ABSTRACTION_H
+#define ROBORTS_PLANNING_GLOBAL_PLANNER_HPA_PLANNER_CLUSTER_ABSTRACTION_H
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "costmap/costmap_2d.h"
+
+#include "../search_arena.h"
+
+namespace roborts_global_planner{
+
+/**
+ * @brief Rectangle of cells [x0, xn) x [y0, yn).
+ */
+struct CellBounds {
+  int x0, y0, xn, yn;
+};
+
+/**
+ * @brief A star search over the cells inside a rectangle, with the move costs of the A star planner.
+ */
+class BoundedSearch {
+ public:
+  /**
+   * @brief Search from a source cell to a target cell, or to every cell inside the bounds if there is no target.
+   * @param costmap costmap snapshot to search in
+   * @param inaccessible_cost Lowest cost of the cells which can not be entered
+   * @param bounds Cells the search stays in, which contain the source and the target
+   * @param source_index Index of the source cell
+   * @param target_index Index of the target cell, -1 to reach every cell like Dijkstra's algorithm
+   * @param reverse Whether the scores are the costs of moving from the cells to the source instead
+   * @return True if the target was reached, or if there is no target
+   */
+  bool Search(const roborts_costmap::Costmap2D &costmap, unsigned int inaccessible_cost, const CellBounds &bounds,
+              int source_index, int target_index, bool reverse);
+  /**
+   * @brief Get the score of a cell in the last search.
+   * @return The score, std::numeric_limits<int>::max() if the cell was not reached
+   */
+  int GetScore(int index) {
+    return arena_.Node(index).g;
+  }
+  /**
+   * @brief Append the cells from the source to the target of the last search, without the source, to a path.
+   */
+  void AppendPath(int target_index, std::vector<int> &cells);
+  /**
+   * @brief Get the number of cells expanded by the searches so far.
+   */
+  long GetExpansionNum() const {
+    return expansion_num_;
+  }
+
+ private:
+  SearchArena arena_;
+  IndexedHeap<int> open_list_;
+  std::vector<int> reversed_cells_;
+  long expansion_num_ = 0;
+};
+
+/**
+ * @brief Abstract graph of a map split into square clusters for hierarchical path finding. Every maximal run of
+ *        passable cells along a border between two clusters is an entrance, crossed by one pair of transition cells,
+ *        the cheapest pair of the run. The transition cells are the nodes of the graph, linked by the move across
+ *        their entrance and by the cheapest path between every two nodes of the same cluster.
+ */
+class ClusterAbstraction {
+ public:
+  /**
+   * @brief Edge of the abstract graph.
+   */
+  struct Edge {
+    //! Node the edge leads to
+    int to;
+    //! Cost of the cell path the edge stands for
+    int cost;
+  };
+
+  /**
+   * @brief Build the graph from a costmap.
+   * @param costmap costs to build from
+   * @param cluster_size Edge length of the clusters in cells
+   * @param inaccessible_cost Lowest cost of the cells which can not be entered
+   * @param map_hash Hash of the costs, stored to check the graph against later maps
+   * @param search Search used for the paths inside the clusters
+   */
+  void Build(const roborts_costmap::Costmap2D &costmap, unsigned int cluster_size, unsigned int inaccessible_cost,
+             uint64_t map_hash, BoundedSearch &search);
+  /**
+   * @brief Write the graph to a file.
+   * @return True if the file was written
+   */
+  bool Save(const std::string &path) const;
+  /**
+   * @brief Read a graph written by Save().
+   * @return True if the file holds a valid graph
+   */
+  bool Load(const std::string &path);
+  /**
+   * @brief Check whether the graph was built with the same parameters from the costs of map_hash, for a costmap
+   *        of the same geometry.
+   */
+  bool IsValidFor(const roborts_costmap::Costmap2D &costmap, unsigned int cluster_size,
+                  unsigned int inaccessible_cost, uint64_t map_hash) const;
+  bool IsBuilt() const {
+    return !edge_begin_.empty();
+  }
+  int GetNodeNum() const {
+    return cells_.size();
+  }
+  /**
+   * @brief Get the index of the cell of a node.
+   */
+  int GetCell(int node) const {
+    return cells_[node];
+  }
+  /**
+   * @brief Get the cluster a cell is in.
+   */
+  int GetCluster(int index) const {
+    return (index % width_) / cluster_size_ + (index / width_) / cluster_size_ * clusters_x_;
+  }
+  /**
+   * @brief Get the cells of a cluster.
+   */
+  CellBounds GetClusterBounds(int cluster) const;
+  const Edge *EdgesBegin(int node) const {
+    return edges_.data() + edge_begin_[node];
+  }
+  const Edge *EdgesEnd(int node) const {
+    return edges_.data() + edge_begin_[node + 1];
+  }
+  const int *ClusterNodesBegin(int cluster) const {
+    return cluster_nodes_.data() + cluster_begin_[cluster];
+  }
+  const int *ClusterNodesEnd(int cluster) const {
+    return cluster_nodes_.data() + cluster_begin_[cluster + 1];
+  }
+
+ private:
+  /**
+   * @brief Group the nodes by cluster into cluster_nodes_.
+   */
+  void IndexClusters();
+
+  unsigned int width_ = 0, height_ = 0;
+  double resolution_ = 0, origin_x_ = 0, origin_y_ = 0;
+  unsigned int cluster_size_ = 0, inaccessible_cost_ = 0;
+  unsigned int clusters_x_ = 0, clusters_y_ = 0;
+  //! Hash of the static map the graph was built for
+  uint64_t map_hash_ = 0;
+  //! Cell index of every node
+  std::vector<int> cells_;
+  //! Edges leaving node i are edges_[edge_begin_[i]] to edges_[edge_begin_[i + 1]]
+  std::vector<int> edge_begin_;
+  std::vector<Edge> edges_;
+  //! Nodes of cluster i are cluster_nodes_[cluster_begin_[i]] to cluster_nodes_[cluster_begin_[i + 1]]
+  std::vector<int> cluster_begin_;
+  std::vector<int> cluster_nodes_;
+};
+
+} //namespace roborts_global_planner
+
+#endif // ROBORTS_PLANNING_GLOBAL_PLANNER_HPA_PLANNER_CLUSTER_ABSTRACTION_H
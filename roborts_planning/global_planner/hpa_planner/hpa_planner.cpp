@@ -0,0 +1,276 @@
+/****************************************************************************
+ *  Copyright (C) 2019 RoboMaster.
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program. If not, see <http://www.gnu.org/licenses/>.
+ ***************************************************************************/
+
+#include <algorithm>
+#include <chrono>
+#include <limits>
+
+#include "hpa_planner.h"
+
+namespace roborts_global_planner{
+
+using roborts_common::ErrorCode;
+using roborts_common::ErrorInfo;
+
+namespace {
+//! Abstract paths tried before searching the whole map, each one with the edges which failed before blocked
+const int kMaxAbstractSearchNum = 8;
+}
+
+HpaPlanner::HpaPlanner(CostmapPtr costmap_ptr) :
+    GlobalPlannerBase::GlobalPlannerBase(costmap_ptr),
+    width_(0),
+    start_index_(-1),
+    goal_index_(-1),
+    start_node_(-1),
+    goal_node_(-1) {
+
+  HpaPlannerConfig hpa_planner_config;
+  std::string package_path = ros::package::getPath("roborts_planning");
+  std::string full_path = package_path + "/global_planner/hpa_planner/config/hpa_planner_config.prototxt";
+
+  if (!roborts_common::ReadProtoFromTextFile(full_path.c_str(),
+                                             &hpa_planner_config)) {
+    ROS_ERROR("Cannot load hpa planner protobuf configuration file.");
+  }
+  inaccessible_cost_ = hpa_planner_config.inaccessible_cost();
+  goal_search_tolerance_ = hpa_planner_config.goal_search_tolerance()/costmap_ptr->GetCostMap()->GetResolution();
+  cluster_size_ = hpa_planner_config.cluster_size();
+  cache_path_ = hpa_planner_config.abstraction_cache_path();
+  if (!cache_path_.empty() && cache_path_[0] != '/') {
+    cache_path_ = package_path + "/" + cache_path_;
+  }
+}
+
+HpaPlanner::~HpaPlanner(){
+}
+
+ErrorInfo HpaPlanner::Plan(const geometry_msgs::PoseStamped &start,
+                           const geometry_msgs::PoseStamped &goal,
+                           std::vector<geometry_msgs::PoseStamped> &path) {
+
+  // plan on the latest costmap snapshot, so the costmap keeps updating while searching
+  return PlanWithSearch(costmap_ptr_->GetCostMapSnapshot(), start, goal, inaccessible_cost_, goal_search_tolerance_,
+                        [this](const roborts_costmap::Costmap2D &costmap, int start_index, int goal_index,
+                               std::vector<geometry_msgs::PoseStamped> &path) {
+                          return SearchPath(costmap, start_index, goal_index, path);
+                        }, path);
+}
+
+void HpaPlanner::DisableCache() {
+  cache_path_.clear();
+}
+
+bool HpaPlanner::PrepareAbstraction(const roborts_costmap::Costmap2D &costmap) {
+  // the graph follows the inflated static map, the live layers are left to the refinement
+  uint64_t map_hash = costmap_ptr_->GetStaticCostMapHash();
+  if (map_hash == 0) {
+    return false;
+  }
+  if (abstraction_.IsValidFor(costmap, cluster_size_, inaccessible_cost_, map_hash)) {
+    return true;
+  }
+  if (!cache_path_.empty() && abstraction_.Load(cache_path_)
+      && abstraction_.IsValidFor(costmap, cluster_size_, inaccessible_cost_, map_hash)) {
+    ROS_INFO("Loaded the abstraction cache %s with %d nodes", cache_path_.c_str(), abstraction_.GetNodeNum());
+    return true;
+  }
+
+  auto build_start = std::chrono::steady_clock::now();
+  roborts_costmap::Costmap2D static_costmap;
+  if (!costmap_ptr_->GetStaticCostMap(static_costmap)) {
+    return false;
+  }
+  abstraction_.Build(static_costmap, cluster_size_, inaccessible_cost_, map_hash, search_);
+  if (!abstraction_.IsValidFor(costmap, cluster_size_, inaccessible_cost_, map_hash)) {
+    // the static map changed since the snapshot, the next plan builds the graph again
+    return false;
+  }
+  ROS_INFO("Built the cluster abstraction with %d nodes in %.1f ms", abstraction_.GetNodeNum(),
+           std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - build_start).count());
+  if (!cache_path_.empty()) {
+    abstraction_.Save(cache_path_);
+  }
+  return true;
+}
+
+ErrorInfo HpaPlanner::SearchPath(const roborts_costmap::Costmap2D &costmap,
+                                 const int &start_index,
+                                 const int &goal_index,
+                                 std::vector<geometry_msgs::PoseStamped> &path) {
+  width_ = costmap.GetSizeXCell();
+  long expansion_num = search_.GetExpansionNum();
+  bool refined = false;
+  if (PrepareAbstraction(costmap)) {
+    InsertStartAndGoal(costmap, start_index, goal_index);
+    blocked_edges_.clear();
+    for (int i = 0; i < kMaxAbstractSearchNum && !refined; ++i) {
+      if (!SearchAbstractPath()) {
+        break;
+      }
+      refined = RefinePath(costmap);
+    }
+  }
+  if (!refined) {
+    // the abstraction misses paths through clusters which are split by live obstacles, and there is none without
+    // a static map, search the whole map instead
+    CellBounds bounds{0, 0, width_, static_cast<int>(costmap.GetSizeYCell())};
+    cells_.assign(1, start_index);
+    if (search_.Search(costmap, inaccessible_cost_, bounds, start_index, goal_index, false)) {
+      search_.AppendPath(goal_index, cells_);
+      refined = true;
+    }
+  }
+  expansion_num = search_.GetExpansionNum() - expansion_num;
+  expansion_num_ += expansion_num;
+  ROS_INFO("Search takes %ld cycle counts", expansion_num);
+  if (!refined) {
+    ROS_WARN("Global planner can't search the valid path!");
+    return ErrorInfo(ErrorCode::GP_PATH_SEARCH_ERROR, "Valid global path not found.");
+  }
+
+  geometry_msgs::PoseStamped iter_pos;
+  iter_pos.pose.orientation.w = 1;
+  iter_pos.header.frame_id = "map";
+  path.clear();
+  for (int index : cells_) {
+    costmap.Map2World(index % width_, index / width_, iter_pos.pose.position.x, iter_pos.pose.position.y);
+    path.push_back(iter_pos);
+  }
+  return ErrorInfo(ErrorCode::OK);
+}
+
+void HpaPlanner::InsertStartAndGoal(const roborts_costmap::Costmap2D &costmap, int start_index, int goal_index) {
+  start_index_ = start_index;
+  goal_index_ = goal_index;
+  start_node_ = abstraction_.GetNodeNum();
+  goal_node_ = start_node_ + 1;
+  int start_cluster = abstraction_.GetCluster(start_index), goal_cluster = abstraction_.GetCluster(goal_index);
+
+  start_edges_.clear();
+  search_.Search(costmap, inaccessible_cost_, abstraction_.GetClusterBounds(start_cluster), start_index, -1, false);
+  for (const int *node = abstraction_.ClusterNodesBegin(start_cluster);
+       node != abstraction_.ClusterNodesEnd(start_cluster); ++node) {
+    int score = search_.GetScore(abstraction_.GetCell(*node));
+    if (score < std::numeric_limits<int>::max()) {
+      start_edges_.push_back(ClusterAbstraction::Edge{*node, score});
+    }
+  }
+  if (start_cluster == goal_cluster && search_.GetScore(goal_index) < std::numeric_limits<int>::max()) {
+    start_edges_.push_back(ClusterAbstraction::Edge{goal_node_, search_.GetScore(goal_index)});
+  }
+
+  goal_edges_.clear();
+  search_.Search(costmap, inaccessible_cost_, abstraction_.GetClusterBounds(goal_cluster), goal_index, -1, true);
+  for (const int *node = abstraction_.ClusterNodesBegin(goal_cluster);
+       node != abstraction_.ClusterNodesEnd(goal_cluster); ++node) {
+    int score = search_.GetScore(abstraction_.GetCell(*node));
+    if (score < std::numeric_limits<int>::max()) {
+      goal_edges_.emplace_back(*node, score);
+    }
+  }
+}
+
+bool HpaPlanner::SearchAbstractPath() {
+  const int node_num = goal_node_ + 1;
+  abstract_g_.assign(node_num, std::numeric_limits<int>::max());
+  abstract_parent_.assign(node_num, -1);
+  abstract_open_.Resize(node_num);
+  abstract_open_.Clear();
+
+  auto relax = [&](int node, int next, int cost) {
+    if (std::find(blocked_edges_.begin(), blocked_edges_.end(), std::make_pair(node, next)) != blocked_edges_.end()) {
+      return;
+    }
+    int g_score = abstract_g_[node] + cost;
+    if (g_score < abstract_g_[next]) {
+      abstract_g_[next] = g_score;
+      abstract_parent_[next] = node;
+      abstract_open_.Push(next, g_score + GetOctileDistance(GetNodeCell(next), goal_index_));
+    }
+  };
+
+  abstract_g_[start_node_] = 0;
+  abstract_open_.Push(start_node_, GetOctileDistance(start_index_, goal_index_));
+  bool found = false;
+  while (!abstract_open_.Empty()) {
+    int node = abstract_open_.Pop();
+    if (node == goal_node_) {
+      found = true;
+      break;
+    }
+    if (node == start_node_) {
+      for (const auto &edge : start_edges_) {
+        relax(node, edge.to, edge.cost);
+      }
+      continue;
+    }
+    for (const ClusterAbstraction::Edge *edge = abstraction_.EdgesBegin(node);
+         edge != abstraction_.EdgesEnd(node); ++edge) {
+      relax(node, edge->to, edge->cost);
+    }
+    for (const auto &goal_edge : goal_edges_) {
+      if (goal_edge.first == node) {
+        relax(node, goal_node_, goal_edge.second);
+      }
+    }
+  }
+  if (!found) {
+    return false;
+  }
+
+  abstract_path_.clear();
+  for (int node = goal_node_; node >= 0; node = abstract_parent_[node]) {
+    abstract_path_.push_back(node);
+  }
+  std::reverse(abstract_path_.begin(), abstract_path_.end());
+  return true;
+}
+
+bool HpaPlanner::RefinePath(const roborts_costmap::Costmap2D &costmap) {
+  const unsigned char *cost = costmap.GetCharMap();
+  cells_.assign(1, start_index_);
+  for (size_t i = 1; i < abstract_path_.size(); ++i) {
+    int from = GetNodeCell(abstract_path_[i - 1]), to = GetNodeCell(abstract_path_[i]);
+    int cluster = abstraction_.GetCluster(from);
+    bool refined;
+    if (cluster == abstraction_.GetCluster(to)) {
+      refined = search_.Search(costmap, inaccessible_cost_, abstraction_.GetClusterBounds(cluster), from, to, false);
+      if (refined) {
+        search_.AppendPath(to, cells_);
+      }
+    } else {
+      // an edge across an entrance is a single move
+      refined = cost[to] < inaccessible_cost_;
+      if (refined) {
+        cells_.push_back(to);
+      }
+    }
+    if (!refined) {
+      blocked_edges_.emplace_back(abstract_path_[i - 1], abstract_path_[i]);
+      return false;
+    }
+  }
+  return true;
+}
+
+int HpaPlanner::GetOctileDistance(int index1, int index2) const {
+  int dx = std::abs(index1 % width_ - index2 % width_), dy = std::abs(index1 / width_ - index2 / width_);
+  return 10 * std::max(dx, dy) + 4 * std::min(dx, dy);
+}
+
+} //namespace roborts_global_planner
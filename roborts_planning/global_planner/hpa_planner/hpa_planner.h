@@ -0,0 +1,151 @@
+/****************************************************************************
+ *  Copyright (C) 2019 RoboMaster.
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program. If not, see <http://www.gnu.org/licenses/>.
+ ***************************************************************************/
+#ifndef ROBORTS_PLANNING_GLOBAL_PLANNER_HPA_PLANNER_H
+#define ROBORTS_PLANNING_GLOBAL_PLANNER_HPA_PLANNER_H
+
+#include <utility>
+
+#include <ros/ros.h>
+#include <geometry_msgs/PoseStamped.h>
+
+#include "proto/hpa_planner_config.pb.h"
+
+#include "alg_factory/algorithm_factory.h"
+#include "state/error_code.h"
+#include "costmap/costmap_interface.h"
+
+#include "../global_planner_base.h"
+#include "cluster_abstraction.h"
+
+namespace roborts_global_planner{
+
+/**
+ * @brief Global planner algorithm class for hierarchical path finding (HPA*) under the representation of costmap.
+ *        A plan searches the abstract graph of the clusters the map is split into, then refines every abstract
+ *        edge into cells with a search inside its cluster on the latest costmap, so obstacles which appeared after
+ *        the graph was built are respected. An edge they block is dropped and the abstract search repeated.
+ */
+class HpaPlanner : public GlobalPlannerBase {
+
+ public:
+  /**
+   * @brief Constructor of HPA* planner, set the costmap pointer and relevant costmap size.
+   * @param costmap_ptr The shared pointer of costmap interface
+   */
+  HpaPlanner(CostmapPtr costmap_ptr);
+  virtual ~HpaPlanner();
+  /**
+   * @brief Main Plan function(override the base-class function)
+   * @param start Start pose input
+   * @param goal Goal pose input
+   * @param path Global plan path output
+   * @return ErrorInfo which is OK if succeed
+   */
+  roborts_common::ErrorInfo Plan(const geometry_msgs::PoseStamped &start,
+                                 const geometry_msgs::PoseStamped &goal,
+                                 std::vector<geometry_msgs::PoseStamped> &path);
+  /**
+   * @brief Build the abstract graph for every new map without loading or saving the abstraction cache.
+   */
+  void DisableCache();
+
+ private:
+  /**
+   * @brief Search a path between two cells.
+   * @param costmap costmap snapshot to search in
+   * @param start_index start pose index in the 1D costmap list
+   * @param goal_index goal pose index in the 1D costmap list
+   * @param path plan path output
+   * @return ErrorInfo which is OK if succeed
+   */
+  roborts_common::ErrorInfo SearchPath(const roborts_costmap::Costmap2D &costmap,
+                                       const int &start_index,
+                                       const int &goal_index,
+                                       std::vector<geometry_msgs::PoseStamped> &path);
+  /**
+   * @brief Make sure the abstract graph matches the inflated static map of the costmap, loading it from the cache
+   *        or building it if it does not. The graph never holds the obstacles of the live layers.
+   * @param costmap costmap snapshot to search in
+   * @return False if there is no static map to build the graph from
+   */
+  bool PrepareAbstraction(const roborts_costmap::Costmap2D &costmap);
+  /**
+   * @brief Link the start and the goal cell to the nodes of their clusters on the latest costs.
+   */
+  void InsertStartAndGoal(const roborts_costmap::Costmap2D &costmap, int start_index, int goal_index);
+  /**
+   * @brief Search the abstract graph from the start to the goal, skipping the blocked edges.
+   * @return True if the goal was reached, the nodes of the path are in abstract_path_
+   */
+  bool SearchAbstractPath();
+  /**
+   * @brief Refine the abstract path into cells, blocking the first edge which can not be refined.
+   * @param costmap costmap snapshot to search in
+   * @return True if every edge was refined, the cells of the path are in cells_
+   */
+  bool RefinePath(const roborts_costmap::Costmap2D &costmap);
+  /**
+   * @brief Get the cell of an abstract node, the start and goal nodes included.
+   */
+  int GetNodeCell(int node) const {
+    return node == start_node_ ? start_index_ : (node == goal_node_ ? goal_index_ : abstraction_.GetCell(node));
+  }
+  /**
+   * @brief Calculate the octile distance between two cells used as the heuristic function.
+   */
+  int GetOctileDistance(int index1, int index2) const;
+
+  //! inaccessible_cost
+  unsigned int inaccessible_cost_;
+  //! goal_search_tolerance
+  unsigned int goal_search_tolerance_;
+  //! Edge length of the clusters in cells
+  unsigned int cluster_size_;
+  //! File caching the abstract graph, empty if the cache is disabled
+  std::string cache_path_;
+  //! Abstract graph of the inflated static map
+  ClusterAbstraction abstraction_;
+  //! Cell search inside the clusters
+  BoundedSearch search_;
+  //! Width of the map of the current plan
+  int width_;
+  //! Cells and abstract nodes of the start and the goal of the current plan, the nodes follow the graph nodes
+  int start_index_, goal_index_, start_node_, goal_node_;
+  //! Edges from the start node
+  std::vector<ClusterAbstraction::Edge> start_edges_;
+  //! Nodes of the goal cluster which reach the goal, and their cost to it
+  std::vector<std::pair<int, int>> goal_edges_;
+  //! Edges which could not be refined in the current plan
+  std::vector<std::pair<int, int>> blocked_edges_;
+  //! g score and parent of the abstract nodes
+  std::vector<int> abstract_g_, abstract_parent_;
+  //! open list of the abstract search ordered by f score
+  IndexedHeap<int> abstract_open_;
+  //! Nodes of the abstract path from the start to the goal
+  std::vector<int> abstract_path_;
+  //! Cells of the refined path
+  std::vector<int> cells_;
+};
+
+roborts_common::REGISTER_ALGORITHM(GlobalPlannerBase,
+                                   "hpa_planner",
+                                   HpaPlanner,
+                                   std::shared_ptr<roborts_costmap::CostmapInterface>);
+
+} //namespace roborts_global_planner
+
+#endif // ROBORTS_PLANNING_GLOBAL_PLANNER_HPA_PLANNER_H
@@ -0,0 +1,285 @@
+/****************************************************************************
+ *  Copyright (C) 2019 RoboMaster.
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program. If not, see <http://www.gnu.org/licenses/>.
+ ***************************************************************************/
+
+#include "jps_planner.h"
+
+namespace roborts_global_planner{
+
+using roborts_common::ErrorCode;
+using roborts_common::ErrorInfo;
+
+namespace {
+//! Direction of the start cell, which was not reached by a jump
+const unsigned char kNoDirection = SearchArena::kNeighborNum;
+}
+
+JpsPlanner::JpsPlanner(CostmapPtr costmap_ptr) :
+    GlobalPlannerBase::GlobalPlannerBase(costmap_ptr),
+    padded_width_(0),
+    padded_height_(0) {
+
+  JpsPlannerConfig jps_planner_config;
+  std::string full_path = ros::package::getPath("roborts_planning") + "/global_planner/jps_planner/"\
+      "config/jps_planner_config.prototxt";
+
+  if (!roborts_common::ReadProtoFromTextFile(full_path.c_str(),
+                                             &jps_planner_config)) {
+    ROS_ERROR("Cannot load jps planner protobuf configuration file.");
+  }
+  heuristic_factor_ = jps_planner_config.heuristic_factor();
+  inaccessible_cost_ = jps_planner_config.inaccessible_cost();
+  goal_search_tolerance_ = jps_planner_config.goal_search_tolerance()/costmap_ptr->GetCostMap()->GetResolution();
+  use_jps_plus_ = jps_planner_config.use_jps_plus();
+}
+
+JpsPlanner::~JpsPlanner(){
+}
+
+ErrorInfo JpsPlanner::Plan(const geometry_msgs::PoseStamped &start,
+                           const geometry_msgs::PoseStamped &goal,
+                           std::vector<geometry_msgs::PoseStamped> &path) {
+
+  // plan on the latest costmap snapshot, so the costmap keeps updating while searching
+  return PlanWithSearch(costmap_ptr_->GetCostMapSnapshot(), start, goal, inaccessible_cost_, goal_search_tolerance_,
+                        [this](const roborts_costmap::Costmap2D &costmap, int start_index, int goal_index,
+                               std::vector<geometry_msgs::PoseStamped> &path) {
+                          return SearchPath(costmap, start_index, goal_index, path);
+                        }, path);
+}
+
+void JpsPlanner::PrepareGrid(const roborts_costmap::Costmap2D &costmap) {
+  const int width = costmap.GetSizeXCell(), height = costmap.GetSizeYCell();
+  const unsigned char *cost = costmap.GetCharMap();
+  if (padded_width_ != width + 2 || padded_height_ != height + 2) {
+    padded_width_ = width + 2;
+    padded_height_ = height + 2;
+    // the blocked border saves the bounds checks of the jumps
+    padded_cost_.assign(padded_width_ * padded_height_, roborts_costmap::NO_INFORMATION);
+    passable_.assign(padded_width_ * padded_height_, 0);
+    jump_passable_.clear();
+    arena_.NewSearch(padded_width_, padded_height_);
+    for (int i = 0; i < SearchArena::kNeighborNum; ++i) {
+      offsets_[i] = arena_.GetNeighbors()[i].offset;
+    }
+    directions_.resize(padded_width_ * padded_height_);
+  }
+  for (int y = 0; y < height; ++y) {
+    const unsigned char *cost_row = cost + y * width;
+    int padded_index = (y + 1) * padded_width_ + 1;
+    std::copy(cost_row, cost_row + width, padded_cost_.begin() + padded_index);
+    for (int x = 0; x < width; ++x) {
+      passable_[padded_index + x] = cost_row[x] < inaccessible_cost_;
+    }
+  }
+
+  // the jump distances only depend on the blocked cells, which mostly change with the static layer only
+  if (use_jps_plus_ && passable_ != jump_passable_) {
+    if (padded_width_ > std::numeric_limits<int16_t>::max() || padded_height_ > std::numeric_limits<int16_t>::max()) {
+      ROS_WARN("Map is too large for the jump distances, jumping without them.");
+      use_jps_plus_ = false;
+      return;
+    }
+    BuildJumpDistances();
+    jump_passable_ = passable_;
+  }
+}
+
+void JpsPlanner::BuildJumpDistances() {
+  const int cell_num = padded_width_ * padded_height_;
+  jump_distances_.assign(cell_num * SearchArena::kNeighborNum, 0);
+  // straight directions first, a diagonal jump stops where a straight one finds a jump point
+  const int direction_order[SearchArena::kNeighborNum] = {0, 2, 4, 6, 1, 3, 5, 7};
+  for (int direction : direction_order) {
+    const int offset = offsets_[direction];
+    const bool diagonal = direction % 2 == 1;
+    // the next cell of a jump has to be done first
+    const int begin = offset > 0 ? cell_num - 1 : 0, end = offset > 0 ? -1 : cell_num, step = offset > 0 ? -1 : 1;
+    for (int index = begin; index != end; index += step) {
+      int next = index + offset;
+      if (!passable_[index] || next < 0 || next >= cell_num) {
+        continue;
+      }
+      int16_t &distance = jump_distances_[index * SearchArena::kNeighborNum + direction];
+      if (diagonal ? !CanMoveDiagonally(index, direction) : !passable_[next]) {
+        distance = 0;
+        continue;
+      }
+      bool jump_point = diagonal ?
+          jump_distances_[next * SearchArena::kNeighborNum + (direction + 1) % 8] > 0 ||
+              jump_distances_[next * SearchArena::kNeighborNum + (direction + 7) % 8] > 0 :
+          IsForced(next, direction);
+      if (jump_point) {
+        distance = 1;
+      } else {
+        int16_t next_distance = jump_distances_[next * SearchArena::kNeighborNum + direction];
+        distance = next_distance > 0 ? next_distance + 1 : next_distance - 1;
+      }
+    }
+  }
+}
+
+int JpsPlanner::Jump(int index, int direction, int goal_index) const {
+  if (use_jps_plus_) {
+    return JumpWithDistances(index, direction, goal_index);
+  }
+  return direction % 2 == 0 ? JumpStraight(index, direction, goal_index) : JumpDiagonal(index, direction, goal_index);
+}
+
+int JpsPlanner::JumpStraight(int index, int direction, int goal_index) const {
+  const int offset = offsets_[direction];
+  while (true) {
+    index += offset;
+    if (!passable_[index]) {
+      return -1;
+    }
+    if (index == goal_index || IsForced(index, direction)) {
+      return index;
+    }
+  }
+}
+
+int JpsPlanner::JumpDiagonal(int index, int direction, int goal_index) const {
+  const int offset = offsets_[direction];
+  while (CanMoveDiagonally(index, direction)) {
+    index += offset;
+    if (index == goal_index || JumpStraight(index, (direction + 1) % 8, goal_index) >= 0 ||
+        JumpStraight(index, (direction + 7) % 8, goal_index) >= 0) {
+      return index;
+    }
+  }
+  return -1;
+}
+
+int JpsPlanner::JumpWithDistances(int index, int direction, int goal_index) const {
+  const int distance = jump_distances_[index * SearchArena::kNeighborNum + direction];
+  // a jump reaching the row or the column of the goal stops there, so the goal can not be jumped over
+  const NeighborMove &move = arena_.GetNeighbors()[direction];
+  int x = index % padded_width_, y = index / padded_width_;
+  int goal_dx = goal_index % padded_width_ - x, goal_dy = goal_index / padded_width_ - y;
+  int reach = std::abs(distance);
+  if (direction % 2 == 0) {
+    int goal_steps = move.dx != 0 ? goal_dx * move.dx : goal_dy * move.dy;
+    bool goal_on_ray = move.dx != 0 ? goal_dy == 0 : goal_dx == 0;
+    if (goal_on_ray && goal_steps > 0 && goal_steps <= reach) {
+      return goal_index;
+    }
+  } else if (goal_dx * move.dx > 0 && goal_dy * move.dy > 0) {
+    int goal_steps = std::min(std::abs(goal_dx), std::abs(goal_dy));
+    if (goal_steps <= reach) {
+      return index + goal_steps * move.offset;
+    }
+  }
+  return distance > 0 ? index + distance * move.offset : -1;
+}
+
+int JpsPlanner::GetOctileDistance(int index1, int index2) const {
+  int dx = std::abs(index1 % padded_width_ - index2 % padded_width_);
+  int dy = std::abs(index1 / padded_width_ - index2 / padded_width_);
+  return heuristic_factor_ * (10 * std::max(dx, dy) + 4 * std::min(dx, dy));
+}
+
+ErrorInfo JpsPlanner::SearchPath(const roborts_costmap::Costmap2D &costmap,
+                                 const int &start_index,
+                                 const int &goal_index,
+                                 std::vector<geometry_msgs::PoseStamped> &path) {
+  PrepareGrid(costmap);
+  const int width = costmap.GetSizeXCell();
+  const int start = (start_index / width + 1) * padded_width_ + start_index % width + 1;
+  const int goal = (goal_index / width + 1) * padded_width_ + goal_index % width + 1;
+
+  arena_.NewSearch(padded_width_, padded_height_);
+  open_list_.Resize(padded_width_ * padded_height_);
+  open_list_.Clear();
+  arena_.Node(start).g = 0;
+  directions_[start] = kNoDirection;
+  open_list_.Push(start, GetOctileDistance(start, goal));
+
+  const std::array<NeighborMove, SearchArena::kNeighborNum> &moves = arena_.GetNeighbors();
+  int current_index = start, count = 0;
+  while (!open_list_.Empty()) {
+    current_index = open_list_.Pop();
+    SearchNode &current_node = arena_.Node(current_index);
+    current_node.state = SearchState::CLOSED;
+    if (current_index == goal) {
+      ROS_INFO("Search takes %d cycle counts", count);
+      break;
+    }
+
+    // a straight jump goes on straight or turns by up to 90 degrees, a diagonal one by up to 45 degrees
+    int arrival = directions_[current_index];
+    int first_turn = arrival == kNoDirection ? 0 : (arrival % 2 == 0 ? -2 : -1);
+    int last_turn = arrival == kNoDirection ? SearchArena::kNeighborNum - 1 : -first_turn;
+    for (int turn = first_turn; turn <= last_turn; ++turn) {
+      int direction = arrival == kNoDirection ? turn : (arrival + turn + 8) % 8;
+      int jump_index = Jump(current_index, direction, goal);
+      if (jump_index < 0) {
+        continue;
+      }
+      SearchNode &jump_node = arena_.Node(jump_index);
+      if (jump_node.state == SearchState::CLOSED) {
+        continue;
+      }
+      // every cell the jump passes costs its move and its cell cost, like a step of the A star planner
+      int g_score = current_node.g;
+      for (int index = current_index; index != jump_index;) {
+        index += moves[direction].offset;
+        g_score += moves[direction].move_cost + padded_cost_[index];
+      }
+      if (jump_node.g > g_score) {
+        jump_node.g = g_score;
+        jump_node.parent = current_index;
+        directions_[jump_index] = direction;
+        open_list_.Push(jump_index, g_score + GetOctileDistance(jump_index, goal));
+        jump_node.state = SearchState::OPEN;
+      }
+    }
+    count++;
+  }
+  expansion_num_ += count;
+
+  if (current_index != goal) {
+    ROS_WARN("Global planner can't search the valid path!");
+    return ErrorInfo(ErrorCode::GP_PATH_SEARCH_ERROR, "Valid global path not found.");
+  }
+
+  // fill in the cells between the jump points
+  geometry_msgs::PoseStamped iter_pos;
+  iter_pos.pose.orientation.w = 1;
+  iter_pos.header.frame_id = "map";
+  path.clear();
+  auto add_cell = [&](int index) {
+    costmap.Map2World(index % padded_width_ - 1, index / padded_width_ - 1,
+                      iter_pos.pose.position.x, iter_pos.pose.position.y);
+    path.push_back(iter_pos);
+  };
+  int iter_index = goal;
+  add_cell(iter_index);
+  while (iter_index != start) {
+    int parent_index = arena_.Node(iter_index).parent;
+    int offset = moves[directions_[iter_index]].offset;
+    for (int index = iter_index - offset; index != parent_index; index -= offset) {
+      add_cell(index);
+    }
+    add_cell(parent_index);
+    iter_index = parent_index;
+  }
+  std::reverse(path.begin(), path.end());
+
+  return ErrorInfo(ErrorCode::OK);
+}
+
+} //namespace roborts_global_planner
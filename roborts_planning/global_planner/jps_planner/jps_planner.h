@@ -0,0 +1,158 @@
+/****************************************************************************
+ *  Copyright (C) 2019 RoboMaster.
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program. If not, see <http://www.gnu.org/licenses/>.
+ ***************************************************************************/
+#ifndef ROBORTS_PLANNING_GLOBAL_PLANNER_JPS_PLANNER_H
+#define ROBORTS_PLANNING_GLOBAL_PLANNER_JPS_PLANNER_H
+
+#include <ros/ros.h>
+#include <geometry_msgs/PoseStamped.h>
+
+#include "proto/jps_planner_config.pb.h"
+
+#include "alg_factory/algorithm_factory.h"
+#include "state/error_code.h"
+#include "costmap/costmap_interface.h"
+
+#include "../global_planner_base.h"
+#include "../search_arena.h"
+
+namespace roborts_global_planner{
+
+/**
+ * @brief Global planner algorithm class for jump point search under the representation of costmap. Cells of at
+ *        least the inaccessible cost are blocked, the search jumps over the other cells as if they had a uniform
+ *        cost and the cost of the cells a jump passes is added to its move cost as a penalty.
+ */
+class JpsPlanner : public GlobalPlannerBase {
+
+ public:
+  /**
+   * @brief Constructor of jump point search planner, set the costmap pointer and relevant costmap size.
+   * @param costmap_ptr The shared pointer of costmap interface
+   */
+  JpsPlanner(CostmapPtr costmap_ptr);
+  virtual ~JpsPlanner();
+  /**
+   * @brief Main Plan function(override the base-class function)
+   * @param start Start pose input
+   * @param goal Goal pose input
+   * @param path Global plan path output
+   * @return ErrorInfo which is OK if succeed
+   */
+  roborts_common::ErrorInfo Plan(const geometry_msgs::PoseStamped &start,
+                                 const geometry_msgs::PoseStamped &goal,
+                                 std::vector<geometry_msgs::PoseStamped> &path);
+
+ private:
+  /**
+   * @brief Search a path between two cells.
+   * @param costmap costmap snapshot to search in
+   * @param start_index start pose index in the 1D costmap list
+   * @param goal_index goal pose index in the 1D costmap list
+   * @param path plan path output
+   * @return ErrorInfo which is OK if succeed
+   */
+  roborts_common::ErrorInfo SearchPath(const roborts_costmap::Costmap2D &costmap,
+                                       const int &start_index,
+                                       const int &goal_index,
+                                       std::vector<geometry_msgs::PoseStamped> &path);
+  /**
+   * @brief Copy the costs into the padded grid and rebuild the jump distances if the blocked cells changed.
+   * @param costmap costmap snapshot to search in
+   */
+  void PrepareGrid(const roborts_costmap::Costmap2D &costmap);
+  /**
+   * @brief Precompute the JPS+ jump distance of every cell in every direction.
+   */
+  void BuildJumpDistances();
+  /**
+   * @brief Jump from a cell in a direction.
+   * @param index Padded index of the cell to jump from
+   * @param direction Direction of the jump, the neighbor move of the search arena
+   * @param goal_index Padded index of the goal cell, where every jump stops
+   * @return Padded index of the jump point reached, -1 if the jump runs into a blocked cell
+   */
+  int Jump(int index, int direction, int goal_index) const;
+  /**
+   * @brief Jump along a row or a column, stopping at the goal or at a cell with a forced neighbor.
+   */
+  int JumpStraight(int index, int direction, int goal_index) const;
+  /**
+   * @brief Jump diagonally, stopping at the goal or at a cell a straight jump leaves from.
+   */
+  int JumpDiagonal(int index, int direction, int goal_index) const;
+  /**
+   * @brief Jump with the precomputed jump distances.
+   */
+  int JumpWithDistances(int index, int direction, int goal_index) const;
+  /**
+   * @brief Check whether a cell reached by a straight move has a neighbor which is only reached through it.
+   */
+  inline bool IsForced(int index, int direction) const {
+    int offset = offsets_[direction];
+    int side_1 = offsets_[(direction + 2) % 8], side_2 = offsets_[(direction + 6) % 8];
+    return (passable_[index + side_1] && !passable_[index + side_1 - offset]) ||
+        (passable_[index + side_2] && !passable_[index + side_2 - offset]);
+  }
+  /**
+   * @brief Check whether a diagonal move from a cell is possible without cutting a corner.
+   */
+  inline bool CanMoveDiagonally(int index, int direction) const {
+    return passable_[index + offsets_[direction]] && passable_[index + offsets_[(direction + 1) % 8]] &&
+        passable_[index + offsets_[(direction + 7) % 8]];
+  }
+  /**
+   * @brief Calculate the octile distance between two cells used as the heuristic function.
+   */
+  int GetOctileDistance(int index1, int index2) const;
+
+  //! heuristic_factor_
+  float heuristic_factor_;
+  //! inaccessible_cost
+  unsigned int inaccessible_cost_;
+  //! goal_search_tolerance
+  unsigned int goal_search_tolerance_;
+  //! Whether the jumps use the precomputed jump distances
+  bool use_jps_plus_;
+  //! Size of the map padded by one blocked cell on every side
+  int padded_width_, padded_height_;
+  //! Costs of the padded map
+  std::vector<unsigned char> padded_cost_;
+  //! Whether each cell of the padded map is passable
+  std::vector<unsigned char> passable_;
+  //! Passable cells the jump distances were computed for
+  std::vector<unsigned char> jump_passable_;
+  //! Eight jump distances of every padded cell, positive for the distance to a jump point, otherwise minus the
+  //! number of cells which can be passed before a blocked cell
+  std::vector<int16_t> jump_distances_;
+  //! Index offsets of the eight directions in the padded map
+  int offsets_[SearchArena::kNeighborNum];
+  //! g score, parent and state of every padded cell, kept between plans
+  SearchArena arena_;
+  //! Direction every jump point was reached in, only valid for the cells the search touched
+  std::vector<unsigned char> directions_;
+  //! open list ordered by f score
+  IndexedHeap<int> open_list_;
+};
+
+roborts_common::REGISTER_ALGORITHM(GlobalPlannerBase,
+                                   "jps_planner",
+                                   JpsPlanner,
+                                   std::shared_ptr<roborts_costmap::CostmapInterface>);
+
+} //namespace roborts_global_planner
+
+#endif // ROBORTS_PLANNING_GLOBAL_PLANNER_JPS_PLANNER_H
@@ -0,0 +1,91 @@
+/****************************************************************************
+ *  Copyright (C) 2019 RoboMaster.
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program. If not, see <http://www.gnu.org/licenses/>.
+ ***************************************************************************/
+
+#include <chrono>
+
+#include <ros/ros.h>
+#include <ros/package.h>
+#include <nav_msgs/OccupancyGrid.h>
+
+#include "io/io.h"
+#include "costmap/static_layer.h"
+#include "a_star_planner/proto/a_star_planner_config.pb.h"
+
+#include "landmark_table.h"
+
+using roborts_global_planner::LandmarkTable;
+
+/**
+ * @brief Build the landmark table of the A star planner from the first map received on the map topic, unless the
+ *        table on disk was already built from the same map.
+ */
+class LandmarkBuilder {
+ public:
+  LandmarkBuilder(const std::string &table_path, unsigned int landmark_num) :
+      table_path_(table_path), landmark_num_(landmark_num) {
+    ros::NodeHandle nh;
+    map_sub_ = nh.subscribe("map", 1, &LandmarkBuilder::MapCallback, this);
+  }
+
+ private:
+  void MapCallback(const nav_msgs::OccupancyGridConstPtr &map) {
+    map_sub_.shutdown();
+    LandmarkTable table;
+    if (table.Load(table_path_) && table.GetLandmarkNum() == landmark_num_ &&
+        table.GetMapHash() == roborts_costmap::StaticLayer::HashMap(*map)) {
+      ROS_INFO("Landmark table %s is up to date.", table_path_.c_str());
+      ros::shutdown();
+      return;
+    }
+    auto start = std::chrono::steady_clock::now();
+    if (!table.Build(*map, landmark_num_)) {
+      ROS_ERROR("The map has no passable cell to put landmarks on.");
+    } else if (table.Save(table_path_)) {
+      ROS_INFO("Landmark table %s built with %u landmarks in %.1f ms.", table_path_.c_str(), table.GetLandmarkNum(),
+               std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count());
+    }
+    ros::shutdown();
+  }
+
+  std::string table_path_;
+  unsigned int landmark_num_;
+  ros::Subscriber map_sub_;
+};
+
+int main(int argc, char **argv) {
+  ros::init(argc, argv, "landmark_builder");
+
+  roborts_global_planner::AStarPlannerConfig a_star_planner_config;
+  std::string full_path = ros::package::getPath("roborts_planning") + "/global_planner/a_star_planner/"\
+      "config/a_star_planner_config.prototxt";
+  if (!roborts_common::ReadProtoFromTextFile(full_path.c_str(), &a_star_planner_config)) {
+    ROS_ERROR("Cannot load a star planner protobuf configuration file.");
+    return 1;
+  }
+  std::string table_path = a_star_planner_config.landmark_table_path();
+  if (table_path.empty()) {
+    ROS_ERROR("No landmark table path is configured for the a star planner.");
+    return 1;
+  }
+  if (table_path[0] != '/') {
+    table_path = ros::package::getPath("roborts_planning") + "/" + table_path;
+  }
+
+  LandmarkBuilder landmark_builder(table_path, a_star_planner_config.landmark_num());
+  ros::spin();
+  return 0;
+}
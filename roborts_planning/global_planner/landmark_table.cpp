@@ -0,0 +1,220 @@
+/****************************************************************************
+ *  Copyright (C) 2019 RoboMaster.
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program. If not, see <http://www.gnu.org/licenses/>.
+ ***************************************************************************/
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <limits>
+
+#include <ros/ros.h>
+
+#include "costmap/map_common.h"
+#include "costmap/static_layer.h"
+
+#include "landmark_table.h"
+#include "search_arena.h"
+
+namespace roborts_global_planner{
+
+namespace {
+
+const char kLandmarkTableMagic[8] = {'R', 'M', 'L', 'N', 'D', 'M', 'R', 'K'};
+const uint32_t kLandmarkTableVersion = 1;
+//! Occupancy of the cells which are never passable, whatever the lethal threshold of the static layer is
+const int8_t kFullyOccupied = 100;
+
+/**
+ * @brief Layout of the landmark table file. The header is followed by the landmark indexes and the distances.
+ */
+struct LandmarkTableHeader {
+  char magic[8];
+  uint32_t version;
+  uint32_t size_x, size_y;
+  uint32_t landmark_num;
+  int32_t scale;
+  double resolution, origin_x, origin_y;
+  uint64_t map_hash;
+};
+
+} //namespace
+
+const uint16_t LandmarkTable::kUnreachable;
+
+bool LandmarkTable::Build(const nav_msgs::OccupancyGrid &map, unsigned int landmark_num) {
+  width_ = map.info.width;
+  height_ = map.info.height;
+  resolution_ = map.info.resolution;
+  origin_x_ = map.info.origin.position.x;
+  origin_y_ = map.info.origin.position.y;
+  map_hash_ = roborts_costmap::StaticLayer::HashMap(map);
+  landmarks_.clear();
+  distances_.clear();
+  landmark_num_ = 0;
+  goal_distances_ = nullptr;
+
+  // the search starts from the passable cell nearest to the center of the map
+  const size_t cell_num = static_cast<size_t>(width_) * height_;
+  std::vector<unsigned char> passable(cell_num, 0);
+  int center_index = -1;
+  long shortest_dist = std::numeric_limits<long>::max();
+  for (size_t i = 0; i < cell_num && i < map.data.size(); ++i) {
+    passable[i] = map.data[i] != kFullyOccupied;
+    long dx = static_cast<long>(i % width_) - width_ / 2, dy = static_cast<long>(i / width_) - height_ / 2;
+    if (passable[i] && dx * dx + dy * dy < shortest_dist) {
+      shortest_dist = dx * dx + dy * dy;
+      center_index = i;
+    }
+  }
+  if (center_index < 0) {
+    return false;
+  }
+
+  // every landmark is the cell farthest from the landmarks picked before, the first one the farthest from the center
+  const int unreachable = std::numeric_limits<int>::max();
+  std::vector<int> distances, min_distances(cell_num, unreachable);
+  std::vector<std::vector<int>> landmark_distances;
+  ComputeDistances(passable, center_index, min_distances);
+  int max_distance = 0;
+  while (landmarks_.size() < landmark_num) {
+    int farthest_index = -1, farthest_distance = 0;
+    for (size_t i = 0; i < cell_num; ++i) {
+      if (min_distances[i] != unreachable && min_distances[i] > farthest_distance) {
+        farthest_distance = min_distances[i];
+        farthest_index = i;
+      }
+    }
+    if (farthest_index < 0) {
+      // every reachable cell is a landmark already
+      break;
+    }
+    landmarks_.push_back(farthest_index);
+    ComputeDistances(passable, farthest_index, distances);
+    for (size_t i = 0; i < cell_num; ++i) {
+      if (distances[i] != unreachable) {
+        max_distance = std::max(max_distance, distances[i]);
+        min_distances[i] = landmarks_.size() == 1 ? distances[i] : std::min(min_distances[i], distances[i]);
+      }
+    }
+    landmark_distances.push_back(distances);
+  }
+
+  landmark_num_ = landmarks_.size();
+  scale_ = max_distance / (kUnreachable - 1) + 1;
+  distances_.resize(cell_num * landmark_num_);
+  for (size_t i = 0; i < cell_num; ++i) {
+    for (unsigned int j = 0; j < landmark_num_; ++j) {
+      int distance = landmark_distances[j][i];
+      distances_[i * landmark_num_ + j] = distance == unreachable ? kUnreachable : distance / scale_;
+    }
+  }
+  return landmark_num_ > 0;
+}
+
+void LandmarkTable::ComputeDistances(const std::vector<unsigned char> &passable, int source_index,
+                                     std::vector<int> &distances) const {
+  GridNeighbors neighbors;
+  neighbors.Resize(width_, height_);
+  const std::array<NeighborMove, GridNeighbors::kNeighborNum> &moves = neighbors.GetMoves();
+  IndexedHeap<int> open_list;
+  open_list.Resize(passable.size());
+  distances.assign(passable.size(), std::numeric_limits<int>::max());
+  distances[source_index] = 0;
+  open_list.Push(source_index, 0);
+  while (!open_list.Empty()) {
+    int current_index = open_list.Pop();
+    unsigned int neighbor_mask = neighbors.GetMask(current_index);
+    for (int i = 0; i < GridNeighbors::kNeighborNum; ++i) {
+      int neighbor_index = current_index + moves[i].offset;
+      if (!(neighbor_mask & (1u << i)) || !passable[neighbor_index]) {
+        continue;
+      }
+      int distance = distances[current_index] + moves[i].move_cost;
+      if (distance < distances[neighbor_index]) {
+        distances[neighbor_index] = distance;
+        open_list.Push(neighbor_index, distance);
+      }
+    }
+  }
+}
+
+bool LandmarkTable::IsValidFor(const roborts_costmap::Costmap2D &costmap, uint64_t map_hash) const {
+  return landmark_num_ > 0 && map_hash == map_hash_
+      && costmap.GetSizeXCell() == width_ && costmap.GetSizeYCell() == height_
+      && std::abs(costmap.GetResolution() - resolution_) < 1e-6
+      && std::abs(costmap.GetOriginX() - origin_x_) < 0.5 * resolution_
+      && std::abs(costmap.GetOriginY() - origin_y_) < 0.5 * resolution_;
+}
+
+bool LandmarkTable::Save(const std::string &path) const {
+  LandmarkTableHeader header;
+  memcpy(header.magic, kLandmarkTableMagic, sizeof(kLandmarkTableMagic));
+  header.version = kLandmarkTableVersion;
+  header.size_x = width_;
+  header.size_y = height_;
+  header.landmark_num = landmark_num_;
+  header.scale = scale_;
+  header.resolution = resolution_;
+  header.origin_x = origin_x_;
+  header.origin_y = origin_y_;
+  header.map_hash = map_hash_;
+
+  if (!roborts_costmap::WriteFileAtomically(path, {{&header, sizeof(header)},
+                                                  {landmarks_.data(), landmarks_.size() * sizeof(uint32_t)},
+                                                  {distances_.data(), distances_.size() * sizeof(uint16_t)}})) {
+    ROS_WARN("Failed to write the landmark table %s", path.c_str());
+    return false;
+  }
+  return true;
+}
+
+bool LandmarkTable::Load(const std::string &path) {
+  landmark_num_ = 0;
+  goal_distances_ = nullptr;
+  FILE *file = fopen(path.c_str(), "rb");
+  if (file == nullptr) {
+    return false;
+  }
+  LandmarkTableHeader header;
+  bool valid = fread(&header, sizeof(header), 1, file) == 1
+      && memcmp(header.magic, kLandmarkTableMagic, sizeof(kLandmarkTableMagic)) == 0
+      && header.version == kLandmarkTableVersion
+      && header.landmark_num > 0 && header.scale > 0;
+  if (valid) {
+    landmarks_.resize(header.landmark_num);
+    distances_.resize(static_cast<size_t>(header.size_x) * header.size_y * header.landmark_num);
+    valid = fread(landmarks_.data(), sizeof(uint32_t), landmarks_.size(), file) == landmarks_.size()
+        && fread(distances_.data(), sizeof(uint16_t), distances_.size(), file) == distances_.size()
+        && fgetc(file) == EOF;
+  }
+  fclose(file);
+  if (!valid) {
+    landmarks_.clear();
+    distances_.clear();
+    return false;
+  }
+  width_ = header.size_x;
+  height_ = header.size_y;
+  landmark_num_ = header.landmark_num;
+  scale_ = header.scale;
+  resolution_ = header.resolution;
+  origin_x_ = header.origin_x;
+  origin_y_ = header.origin_y;
+  map_hash_ = header.map_hash;
+  return true;
+}
+
+} //namespace roborts_global_planner
@@ -0,0 +1,131 @@
+/****************************************************************************
+ *  Copyright (C) 2019 RoboMaster.
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program. If not, see <http://www.gnu.org/licenses/>.
+ ***************************************************************************/
+#ifndef ROBORTS_PLANNING_GLOBAL_PLANNER_LANDMARK_TABLE_H
+#define ROBORTS_PLANNING_GLOBAL_PLANNER_LANDMARK_TABLE_H
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdlib>
+#include <string>
+#include <vector>
+
+#include <nav_msgs/OccupancyGrid.h>
+
+#include "costmap/costmap_2d.h"
+
+namespace roborts_global_planner{
+
+/**
+ * @brief Distances from a few landmark cells of the static map to every cell, for the ALT heuristic. By the
+ *        triangle inequality, |d(L, a) - d(L, b)| is a lower bound of the distance between a and b for every
+ *        landmark L.
+ *
+ * The distances count the move costs of the A star planner, 10 for a parallel move and 14 for a diagonal one,
+ * over the cells which are not fully occupied in the static map. Obstacles and inflation only add costs and block
+ * cells on top of that, so the bound stays admissible for the costmap as long as its static map is the same,
+ * which the hash of the map tells.
+ */
+class LandmarkTable {
+ public:
+  //! Stored distance of a cell which can not reach the landmark
+  static const uint16_t kUnreachable = 0xFFFF;
+
+  /**
+   * @brief Pick landmarks spread over the map, each the cell farthest from the ones picked before, and compute
+   *        their distances.
+   * @param map The static map
+   * @param landmark_num Number of landmarks
+   * @return True if the map has a passable cell
+   */
+  bool Build(const nav_msgs::OccupancyGrid &map, unsigned int landmark_num);
+  /**
+   * @brief Write the table to a file.
+   * @param path The file path
+   * @return True if the file was written
+   */
+  bool Save(const std::string &path) const;
+  /**
+   * @brief Read a table written by Save().
+   * @param path The file path
+   * @return True if the file holds a valid table
+   */
+  bool Load(const std::string &path);
+  /**
+   * @brief Check whether the table was built from the static map of a costmap.
+   * @param costmap Costmap snapshot to plan in
+   * @param map_hash Hash of the static map of the costmap
+   * @return True if the table was built from the same map, with the geometry of the costmap
+   */
+  bool IsValidFor(const roborts_costmap::Costmap2D &costmap, uint64_t map_hash) const;
+  /**
+   * @brief Set the cell the following lower bounds are computed to.
+   * @param goal_index Index of the goal cell
+   */
+  void SetGoal(int goal_index) {
+    goal_distances_ = &distances_[static_cast<size_t>(goal_index) * landmark_num_];
+  }
+  /**
+   * @brief Get the lower bound of the distance from a cell to the goal.
+   * @param index Index of the cell
+   * @return The lower bound in the move cost units
+   */
+  inline int GetLowerBound(int index) const {
+    const uint16_t *distances = &distances_[static_cast<size_t>(index) * landmark_num_];
+    int bound = 0;
+    for (unsigned int i = 0; i < landmark_num_; ++i) {
+      if (distances[i] != kUnreachable && goal_distances_[i] != kUnreachable) {
+        bound = std::max(bound, std::abs(static_cast<int>(distances[i]) - goal_distances_[i]));
+      }
+    }
+    // distances are stored divided by scale_ and rounded down, which is off by less than one scale_ each
+    return bound > 0 ? bound * scale_ - (scale_ - 1) : 0;
+  }
+  unsigned int GetLandmarkNum() const {
+    return landmark_num_;
+  }
+  uint64_t GetMapHash() const {
+    return map_hash_;
+  }
+
+ private:
+  /**
+   * @brief Compute the distance of every cell to a cell with Dijkstra's algorithm.
+   * @param passable Whether each cell can be passed
+   * @param source_index Index of the cell to compute the distances to
+   * @param distances Distance of every cell as output, -1 if unreachable
+   */
+  void ComputeDistances(const std::vector<unsigned char> &passable, int source_index,
+                        std::vector<int> &distances) const;
+
+  unsigned int width_ = 0, height_ = 0;
+  double resolution_ = 0, origin_x_ = 0, origin_y_ = 0;
+  //! Hash of the static map the table was built from
+  uint64_t map_hash_ = 0;
+  unsigned int landmark_num_ = 0;
+  //! Stored distances are the distances divided by scale_, so they fit in 16 bits
+  int scale_ = 1;
+  //! Index of every landmark cell
+  std::vector<uint32_t> landmarks_;
+  //! Distances of every cell to the landmarks, landmark_num_ consecutive ones per cell
+  std::vector<uint16_t> distances_;
+  //! Distances of the goal cell
+  const uint16_t *goal_distances_ = nullptr;
+};
+
+} //namespace roborts_global_planner
+
+#endif // ROBORTS_PLANNING_GLOBAL_PLANNER_LANDMARK_TABLE_H
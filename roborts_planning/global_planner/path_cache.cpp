@@ -0,0 +1,170 @@
+/****************************************************************************
+ *  Copyright (C) 2019 RoboMaster.
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program. If not, see <http://www.gnu.org/licenses/>.
+ ***************************************************************************/
+
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <limits>
+
+#include "path_cache.h"
+
+namespace roborts_global_planner{
+
+PathCache::PathCache(double max_cost_ratio, double max_deviation, int max_reuse_num) :
+    max_cost_ratio_(max_cost_ratio),
+    max_deviation_(max_deviation),
+    max_reuse_num_(max_reuse_num),
+    progress_index_(0),
+    reuse_num_(0),
+    sequence_(0),
+    size_x_(0),
+    size_y_(0),
+    resolution_(0),
+    origin_x_(0),
+    origin_y_(0) {
+}
+
+void PathCache::Store(const std::shared_ptr<roborts_costmap::CostmapInterface> &costmap_ptr,
+                      const geometry_msgs::PoseStamped &goal,
+                      const std::vector<geometry_msgs::PoseStamped> &path) {
+  Clear();
+  roborts_costmap::SnapshotChanges changes;
+  std::shared_ptr<const roborts_costmap::Costmap2D> costmap = costmap_ptr->GetCostMapSnapshot(0, changes);
+  if (!costmap || path.empty()) {
+    return;
+  }
+
+  const size_t pose_num = path.size();
+  cells_x_.resize(pose_num);
+  cells_y_.resize(pose_num);
+  move_costs_.resize(pose_num);
+  cell_costs_.resize(pose_num);
+  planned_costs_.resize(pose_num);
+  for (size_t i = 0; i < pose_num; ++i) {
+    if (!costmap->World2Map(path[i].pose.position.x, path[i].pose.position.y, cells_x_[i], cells_y_[i])) {
+      Clear();
+      return;
+    }
+    cell_costs_[i] = costmap->GetCost(cells_x_[i], cells_y_[i]);
+    if (i == 0) {
+      move_costs_[i] = 0;
+      planned_costs_[i] = 0;
+      continue;
+    }
+    int dx = std::abs(static_cast<int>(cells_x_[i]) - static_cast<int>(cells_x_[i - 1]));
+    int dy = std::abs(static_cast<int>(cells_y_[i]) - static_cast<int>(cells_y_[i - 1]));
+    move_costs_[i] = 10 * std::max(dx, dy) + 4 * std::min(dx, dy);
+    planned_costs_[i] = planned_costs_[i - 1] + move_costs_[i] + cell_costs_[i];
+  }
+
+  poses_ = path;
+  goal_ = goal;
+  sequence_ = changes.sequence;
+  size_x_ = costmap->GetSizeXCell();
+  size_y_ = costmap->GetSizeYCell();
+  resolution_ = costmap->GetResolution();
+  origin_x_ = costmap->GetOriginX();
+  origin_y_ = costmap->GetOriginY();
+}
+
+bool PathCache::Reuse(const std::shared_ptr<roborts_costmap::CostmapInterface> &costmap_ptr,
+                      const geometry_msgs::PoseStamped &start,
+                      const geometry_msgs::PoseStamped &goal,
+                      std::vector<geometry_msgs::PoseStamped> &path) {
+  if (poses_.empty() || reuse_num_ >= max_reuse_num_ || !IsSameGoal(goal)) {
+    Clear();
+    return false;
+  }
+  roborts_costmap::SnapshotChanges changes;
+  std::shared_ptr<const roborts_costmap::Costmap2D> costmap = costmap_ptr->GetCostMapSnapshot(sequence_, changes);
+  if (!costmap || (!changes.is_bounded && !IsSameGeometry(*costmap))) {
+    Clear();
+    return false;
+  }
+
+  // the robot only moves on along the path, so the nearest pose is searched from the last one on
+  double min_distance = std::numeric_limits<double>::max();
+  size_t nearest_index = progress_index_;
+  for (size_t i = progress_index_; i < poses_.size(); ++i) {
+    double dx = poses_[i].pose.position.x - start.pose.position.x;
+    double dy = poses_[i].pose.position.y - start.pose.position.y;
+    double distance = dx * dx + dy * dy;
+    if (distance < min_distance) {
+      min_distance = distance;
+      nearest_index = i;
+    }
+  }
+  if (std::sqrt(min_distance) > max_deviation_) {
+    Clear();
+    return false;
+  }
+  progress_index_ = nearest_index;
+
+  // only the cells inside the changed bounds can have another cost than at the last check
+  if (changes.sequence != sequence_) {
+    for (size_t i = progress_index_; i < poses_.size(); ++i) {
+      if (!changes.is_bounded || (cells_x_[i] >= changes.x0 && cells_x_[i] < changes.xn &&
+                                  cells_y_[i] >= changes.y0 && cells_y_[i] < changes.yn)) {
+        cell_costs_[i] = costmap->GetCost(cells_x_[i], cells_y_[i]);
+      }
+    }
+    sequence_ = changes.sequence;
+  }
+
+  // the robot is already on the nearest cell, so its cost does not count
+  long current_cost = 0;
+  for (size_t i = progress_index_ + 1; i < poses_.size(); ++i) {
+    if (cell_costs_[i] >= roborts_costmap::INSCRIBED_INFLATED_OBSTACLE) {
+      Clear();
+      return false;
+    }
+    current_cost += move_costs_[i] + cell_costs_[i];
+  }
+  long planned_cost = planned_costs_.back() - planned_costs_[progress_index_];
+  if (current_cost > max_cost_ratio_ * planned_cost) {
+    Clear();
+    return false;
+  }
+
+  path.assign(poses_.begin() + progress_index_, poses_.end());
+  ++reuse_num_;
+  return true;
+}
+
+void PathCache::Clear() {
+  poses_.clear();
+  progress_index_ = 0;
+  reuse_num_ = 0;
+}
+
+bool PathCache::IsSameGoal(const geometry_msgs::PoseStamped &goal) const {
+  const geometry_msgs::Quaternion &q1 = goal.pose.orientation, &q2 = goal_.pose.orientation;
+  double dot = q1.x * q2.x + q1.y * q2.y + q1.z * q2.z + q1.w * q2.w;
+  return goal.header.frame_id == goal_.header.frame_id
+      && std::abs(goal.pose.position.x - goal_.pose.position.x) < 0.5 * resolution_
+      && std::abs(goal.pose.position.y - goal_.pose.position.y) < 0.5 * resolution_
+      && std::abs(dot) > 1 - 1e-6;
+}
+
+bool PathCache::IsSameGeometry(const roborts_costmap::Costmap2D &costmap) const {
+  return costmap.GetSizeXCell() == size_x_ && costmap.GetSizeYCell() == size_y_
+      && std::abs(costmap.GetResolution() - resolution_) < 1e-6
+      && std::abs(costmap.GetOriginX() - origin_x_) < 0.5 * resolution_
+      && std::abs(costmap.GetOriginY() - origin_y_) < 0.5 * resolution_;
+}
+
+} //namespace roborts_global_planner
@@ -0,0 +1,114 @@
+/****************************************************************************
+ *  Copyright (C) 2019 RoboMaster.
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program. If not, see <http://www.gnu.org/licenses/>.
+ ***************************************************************************/
+#ifndef ROBORTS_PLANNING_GLOBAL_PLANNER_PATH_CACHE_H
+#define ROBORTS_PLANNING_GLOBAL_PLANNER_PATH_CACHE_H
+
+#include <cstdint>
+#include <vector>
+
+#include <geometry_msgs/PoseStamped.h>
+
+#include "costmap/costmap_interface.h"
+
+namespace roborts_global_planner{
+
+/**
+ * @brief The last planned path, kept to be followed again while it stays valid instead of planning every cycle.
+ *
+ * Every check trims the path to the pose nearest to the robot and reads the costs of the remaining cells again,
+ * only for the cells inside the bounds the costmap changed since the last check. The path is dropped when the robot
+ * left it, a cell became inaccessible, the remaining cost grew too much compared with the cost it was planned with,
+ * or it was reused often enough that a new plan should look for shortcuts which opened up meanwhile.
+ */
+class PathCache {
+ public:
+  /**
+   * @brief Constructor of the path cache.
+   * @param max_cost_ratio Largest ratio of the current and the planned cost of the remaining path
+   * @param max_deviation Largest distance between the robot and the path in meter
+   * @param max_reuse_num Number of cycles a path is reused before planning again
+   */
+  PathCache(double max_cost_ratio, double max_deviation, int max_reuse_num);
+  /**
+   * @brief Keep a new path planned to a goal, checking it against the latest costmap snapshot.
+   * @param costmap_ptr The costmap the path was planned in
+   * @param goal The goal the path was planned to
+   * @param path The planned path
+   */
+  void Store(const std::shared_ptr<roborts_costmap::CostmapInterface> &costmap_ptr,
+             const geometry_msgs::PoseStamped &goal,
+             const std::vector<geometry_msgs::PoseStamped> &path);
+  /**
+   * @brief Get the rest of the kept path if it is still valid for the robot pose and the goal.
+   * @param costmap_ptr The costmap to check the path in
+   * @param start The robot pose
+   * @param goal The current goal
+   * @param path The trimmed path output
+   * @return True if the path can be reused, false if a new plan is needed
+   */
+  bool Reuse(const std::shared_ptr<roborts_costmap::CostmapInterface> &costmap_ptr,
+             const geometry_msgs::PoseStamped &start,
+             const geometry_msgs::PoseStamped &goal,
+             std::vector<geometry_msgs::PoseStamped> &path);
+  /**
+   * @brief Drop the kept path.
+   */
+  void Clear();
+
+ private:
+  /**
+   * @brief Check whether two goals are the same within half a cell.
+   */
+  bool IsSameGoal(const geometry_msgs::PoseStamped &goal) const;
+  /**
+   * @brief Check whether the geometry of a costmap is the one the cells were computed in.
+   */
+  bool IsSameGeometry(const roborts_costmap::Costmap2D &costmap) const;
+
+  //! Largest ratio of the current and the planned cost of the remaining path
+  double max_cost_ratio_;
+  //! Largest distance between the robot and the path in meter
+  double max_deviation_;
+  //! Number of cycles a path is reused before planning again
+  int max_reuse_num_;
+
+  //! The kept path, empty if there is none
+  std::vector<geometry_msgs::PoseStamped> poses_;
+  //! Goal the path was planned to
+  geometry_msgs::PoseStamped goal_;
+  //! Cell coordinates of every pose
+  std::vector<unsigned int> cells_x_, cells_y_;
+  //! Move cost into every pose from the one before, 10 for a parallel move and 14 for a diagonal one
+  std::vector<int> move_costs_;
+  //! Cell cost of every pose as of the last check
+  std::vector<unsigned char> cell_costs_;
+  //! Planned cost of the path up to every pose
+  std::vector<long> planned_costs_;
+  //! Index of the pose nearest to the robot at the last check
+  size_t progress_index_;
+  //! Number of cycles the path was reused
+  int reuse_num_;
+  //! Sequence number of the costmap snapshot of the last check
+  uint64_t sequence_;
+  //! Geometry of the costmap the cells were computed in
+  unsigned int size_x_, size_y_;
+  double resolution_, origin_x_, origin_y_;
+};
+
+} //namespace roborts_global_planner
+
+#endif // ROBORTS_PLANNING_GLOBAL_PLANNER_PATH_CACHE_H
@@ -0,0 +1,109 @@
+/****************************************************************************
+ *  Copyright (C) 2019 RoboMaster.
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program. If not, see <http://www.gnu.org/licenses/>.
+ ***************************************************************************/
+
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+
+#include "path_shortcut.h"
+
+namespace roborts_global_planner{
+
+PathShortcut::PathShortcut(double max_segment_length, unsigned int inaccessible_cost) :
+    max_segment_length_(max_segment_length),
+    inaccessible_cost_(inaccessible_cost) {
+}
+
+void PathShortcut::Shortcut(const roborts_costmap::Costmap2D &costmap,
+                            const std::vector<geometry_msgs::PoseStamped> &path,
+                            std::vector<geometry_msgs::PoseStamped> &waypoints) {
+  const size_t pose_num = path.size();
+  cells_x_.resize(pose_num);
+  cells_y_.resize(pose_num);
+  path_costs_.resize(pose_num);
+  for (size_t i = 0; i < pose_num; ++i) {
+    if (!costmap.World2Map(path[i].pose.position.x, path[i].pose.position.y, cells_x_[i], cells_y_[i])) {
+      waypoints = path;
+      return;
+    }
+    if (i == 0) {
+      path_costs_[i] = 0;
+      continue;
+    }
+    int dx = std::abs(static_cast<int>(cells_x_[i]) - static_cast<int>(cells_x_[i - 1]));
+    int dy = std::abs(static_cast<int>(cells_y_[i]) - static_cast<int>(cells_y_[i - 1]));
+    path_costs_[i] = path_costs_[i - 1] + 10 * std::max(dx, dy) + 4 * std::min(dx, dy)
+        + costmap.GetCost(cells_x_[i], cells_y_[i]);
+  }
+
+  waypoints.clear();
+  if (pose_num == 0) {
+    return;
+  }
+  waypoints.push_back(path.front());
+  const double max_squared_length = max_segment_length_ * max_segment_length_;
+  size_t anchor = 0;
+  while (anchor + 1 < pose_num) {
+    // follow the path until the first pose which is out of sight, the next pose is always reachable
+    size_t next = anchor + 1;
+    for (size_t i = anchor + 2; i < pose_num; ++i) {
+      double dx = path[i].pose.position.x - path[anchor].pose.position.x;
+      double dy = path[i].pose.position.y - path[anchor].pose.position.y;
+      if (dx * dx + dy * dy > max_squared_length
+          || GetLineCost(costmap, cells_x_[anchor], cells_y_[anchor], cells_x_[i], cells_y_[i],
+                         path_costs_[i] - path_costs_[anchor]) < 0) {
+        break;
+      }
+      next = i;
+    }
+    waypoints.push_back(path[next]);
+    anchor = next;
+  }
+}
+
+long PathShortcut::GetLineCost(const roborts_costmap::Costmap2D &costmap, int x0, int y0, int x1, int y1,
+                               long max_cost) const {
+  const unsigned char *cost = costmap.GetCharMap();
+  const int width = costmap.GetSizeXCell();
+  // Bresenham walk along the major axis, a step which also moves along the minor axis is a diagonal move
+  const int abs_dx = std::abs(x1 - x0), abs_dy = std::abs(y1 - y0);
+  const bool x_major = abs_dx >= abs_dy;
+  const int major_num = x_major ? abs_dx : abs_dy, minor_num = x_major ? abs_dy : abs_dx;
+  const int step_x = x1 > x0 ? 1 : -1, step_y = (y1 > y0 ? 1 : -1) * width;
+  const int major_step = x_major ? step_x : step_y, minor_step = x_major ? step_y : step_x;
+  int index = y0 * width + x0, error = major_num / 2;
+  long line_cost = 0;
+  for (int i = 0; i < major_num; ++i) {
+    index += major_step;
+    error += minor_num;
+    bool diagonal = error >= major_num;
+    if (diagonal) {
+      index += minor_step;
+      error -= major_num;
+    }
+    if (cost[index] >= inaccessible_cost_) {
+      return -1;
+    }
+    line_cost += (diagonal ? 14 : 10) + cost[index];
+    if (line_cost > max_cost) {
+      return -1;
+    }
+  }
+  return line_cost;
+}
+
+} //namespace roborts_global_planner
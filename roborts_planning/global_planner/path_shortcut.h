@@ -0,0 +1,74 @@
+/****************************************************************************
+ *  Copyright (C) 2019 RoboMaster.
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program. If not, see <http://www.gnu.org/licenses/>.
+ ***************************************************************************/
+#ifndef ROBORTS_PLANNING_GLOBAL_PLANNER_PATH_SHORTCUT_H
+#define ROBORTS_PLANNING_GLOBAL_PLANNER_PATH_SHORTCUT_H
+
+#include <vector>
+
+#include <geometry_msgs/PoseStamped.h>
+
+#include "costmap/costmap_2d.h"
+
+namespace roborts_global_planner{
+
+/**
+ * @brief Line of sight shortcut of the grid paths of the planners into sparse waypoints.
+ *
+ * From every waypoint the path is followed as far as the straight line to a later pose crosses no inaccessible cell
+ * and costs no more than the cells of the path it replaces, with the move and cell costs of the planners, so the
+ * waypoint path is never more expensive than the grid path. A segment is also kept below a maximum length, so the
+ * local planner still gets poses spread along the path.
+ */
+class PathShortcut {
+ public:
+  /**
+   * @brief Constructor of the path shortcut.
+   * @param max_segment_length Largest distance between two waypoints in meter
+   * @param inaccessible_cost Lowest cost of the cells a segment can not cross
+   */
+  PathShortcut(double max_segment_length, unsigned int inaccessible_cost);
+  /**
+   * @brief Shortcut a grid path.
+   * @param costmap Costmap snapshot to check the segments in
+   * @param path Path of neighboring cells
+   * @param waypoints Waypoint output, the first and the last pose of the path included
+   */
+  void Shortcut(const roborts_costmap::Costmap2D &costmap,
+                const std::vector<geometry_msgs::PoseStamped> &path,
+                std::vector<geometry_msgs::PoseStamped> &waypoints);
+
+ private:
+  /**
+   * @brief Get the cost of the straight line between two cells, without the cost of the first cell.
+   * @param max_cost The walk along the line stops once its cost exceeds max_cost
+   * @return The cost, or -1 if the line crosses an inaccessible cell or costs more than max_cost
+   */
+  long GetLineCost(const roborts_costmap::Costmap2D &costmap, int x0, int y0, int x1, int y1, long max_cost) const;
+
+  //! Largest distance between two waypoints in meter
+  double max_segment_length_;
+  //! Lowest cost of the cells a segment can not cross
+  unsigned int inaccessible_cost_;
+  //! Cell coordinates of the poses of the path
+  std::vector<unsigned int> cells_x_, cells_y_;
+  //! Cost of the path up to every pose
+  std::vector<long> path_costs_;
+};
+
+} //namespace roborts_global_planner
+
+#endif // ROBORTS_PLANNING_GLOBAL_PLANNER_PATH_SHORTCUT_H
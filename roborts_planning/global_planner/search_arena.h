@@ -0,0 +1,355 @@
+/****************************************************************************
+ *  Copyright (C) 2019 RoboMaster.
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program. If not, see <http://www.gnu.org/licenses/>.
+ ***************************************************************************/
+#ifndef ROBORTS_PLANNING_GLOBAL_PLANNER_SEARCH_ARENA_H
+#define ROBORTS_PLANNING_GLOBAL_PLANNER_SEARCH_ARENA_H
+
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <limits>
+#include <vector>
+
+namespace roborts_global_planner{
+
+/**
+ * @brief State enumerate for the cell.
+ */
+enum SearchState {
+  NOT_HANDLED, /**< The cell is not handled.*/
+  OPEN, /**< The cell is in open priority queue.*/
+  CLOSED /**< The cell is in close queue.*/
+};
+
+/**
+ * @brief Search data of a cell.
+ */
+struct SearchNode {
+  //! Score from the start cell to this cell
+  int g;
+  //! Index of the parent cell, -1 if none
+  int parent;
+  //! Search the data belongs to, data of an older search reads as a cell not handled yet
+  uint32_t generation;
+  SearchState state;
+};
+
+/**
+ * @brief Move from a cell to one of its eight neighbors.
+ */
+struct NeighborMove {
+  int dx, dy;
+  //! Index offset in a map of the arena width
+  int offset;
+  //! 10 for a parallel move, 14 for a diagonal one
+  int move_cost;
+};
+
+/**
+ * @brief Eight neighbor moves of a grid, with the index offsets of its width.
+ */
+class GridNeighbors {
+ public:
+  //! Neighbor moves, in the order of the bits of GetMask()
+  static const int kNeighborNum = 8;
+  /**
+   * @brief Set the grid size the moves and masks are computed for.
+   * @param width Width of the map in cells
+   * @param height Height of the map in cells
+   */
+  void Resize(unsigned int width, unsigned int height) {
+    width_ = width;
+    height_ = height;
+    const int dx[kNeighborNum] = {0, -1, -1, -1, 0, 1, 1, 1};
+    const int dy[kNeighborNum] = {-1, -1, 0, 1, 1, 1, 0, -1};
+    for (int i = 0; i < kNeighborNum; ++i) {
+      moves_[i] = NeighborMove{dx[i], dy[i], dy[i] * static_cast<int>(width) + dx[i],
+                               dx[i] != 0 && dy[i] != 0 ? 14 : 10};
+    }
+  }
+  /**
+   * @brief Get the neighbor moves of the current map width.
+   */
+  inline const std::array<NeighborMove, kNeighborNum> &GetMoves() const {
+    return moves_;
+  }
+  /**
+   * @brief Get which neighbors of a cell are inside the map, bit i for the neighbor move i.
+   * @param index Index of the cell
+   * @return The mask of the neighbors inside the map
+   */
+  inline unsigned int GetMask(int index) const {
+    unsigned int x = index % width_, y = index / width_;
+    unsigned int mask = 0xFF;
+    if (x == 0) {
+      mask &= ~kLeftMask;
+    }
+    if (x + 1 == width_) {
+      mask &= ~kRightMask;
+    }
+    if (y == 0) {
+      mask &= ~kUpMask;
+    }
+    if (y + 1 == height_) {
+      mask &= ~kDownMask;
+    }
+    return mask;
+  }
+  unsigned int GetWidth() const {
+    return width_;
+  }
+  unsigned int GetHeight() const {
+    return height_;
+  }
+
+ private:
+  //! Neighbor moves with dx < 0, dx > 0, dy < 0 and dy > 0
+  static const unsigned int kLeftMask = 0x0E, kRightMask = 0xE0, kUpMask = 0x83, kDownMask = 0x38;
+  unsigned int width_ = 0, height_ = 0;
+  std::array<NeighborMove, kNeighborNum> moves_;
+};
+
+/**
+ * @brief Search data of every cell of a grid, kept between searches. A new search only increments the generation,
+ *        so a cell is reset the first time the search touches it and the per search setup does not depend on the
+ *        map size.
+ */
+class SearchArena {
+ public:
+  //! Neighbor moves, in the order of the bits of GetNeighborMask()
+  static const int kNeighborNum = GridNeighbors::kNeighborNum;
+  /**
+   * @brief Start a new search, resizing the arena if the map size changed.
+   * @param width Width of the map in cells
+   * @param height Height of the map in cells
+   */
+  void NewSearch(unsigned int width, unsigned int height) {
+    if (width != neighbors_.GetWidth() || height != neighbors_.GetHeight()) {
+      neighbors_.Resize(width, height);
+      nodes_.assign(static_cast<size_t>(width) * height, SearchNode{0, -1, 0, NOT_HANDLED});
+      generation_ = 0;
+    }
+    if (++generation_ == 0) {
+      // every stamp could match again after the wrap around
+      for (auto &node : nodes_) {
+        node.generation = 0;
+      }
+      generation_ = 1;
+    }
+  }
+  /**
+   * @brief Get the search data of a cell, resetting it if the cell is touched first in this search.
+   * @param index Index of the cell
+   * @return The search data
+   */
+  inline SearchNode &Node(int index) {
+    SearchNode &node = nodes_[index];
+    if (node.generation != generation_) {
+      node.g = std::numeric_limits<int>::max();
+      node.parent = -1;
+      node.generation = generation_;
+      node.state = NOT_HANDLED;
+    }
+    return node;
+  }
+  /**
+   * @brief Check whether the current search touched a cell.
+   */
+  inline bool IsTouched(int index) const {
+    return nodes_[index].generation == generation_;
+  }
+  /**
+   * @brief Get the neighbor moves of the current map width.
+   */
+  inline const std::array<NeighborMove, kNeighborNum> &GetNeighbors() const {
+    return neighbors_.GetMoves();
+  }
+  /**
+   * @brief Get which neighbors of a cell are inside the map, bit i for the neighbor move i.
+   */
+  inline unsigned int GetNeighborMask(int index) const {
+    return neighbors_.GetMask(index);
+  }
+  unsigned int GetWidth() const {
+    return neighbors_.GetWidth();
+  }
+  unsigned int GetHeight() const {
+    return neighbors_.GetHeight();
+  }
+
+ private:
+  uint32_t generation_ = 0;
+  std::vector<SearchNode> nodes_;
+  GridNeighbors neighbors_;
+};
+
+/**
+ * @brief 4-ary min heap of cell indexes which knows the position of every index, so the key of a queued index can
+ *        be changed in place instead of queueing it again.
+ * @tparam KeyType Priority of an index, ordered by operator<
+ */
+template<typename KeyType>
+class IndexedHeap {
+ public:
+  /**
+   * @brief Size the heap for the indexes [0, index_num), emptying it if the size changed.
+   */
+  void Resize(size_t index_num) {
+    if (position_.size() != index_num) {
+      position_.assign(index_num, kNotQueued);
+      heap_.clear();
+    }
+  }
+  /**
+   * @brief Remove every queued index, in time proportional to the queued indexes only.
+   */
+  void Clear() {
+    for (const auto &item : heap_) {
+      position_[item.index] = kNotQueued;
+    }
+    heap_.clear();
+  }
+  bool Empty() const {
+    return heap_.empty();
+  }
+  size_t Size() const {
+    return heap_.size();
+  }
+  inline bool Contains(int index) const {
+    return position_[index] != kNotQueued;
+  }
+  inline int Top() const {
+    return heap_.front().index;
+  }
+  inline const KeyType &TopKey() const {
+    return heap_.front().key;
+  }
+  inline const KeyType &GetKey(int index) const {
+    return heap_[position_[index]].key;
+  }
+  /**
+   * @brief Queue an index, or change its key if it is already queued.
+   */
+  inline void Push(int index, const KeyType &key) {
+    if (Contains(index)) {
+      Update(index, key);
+      return;
+    }
+    position_[index] = heap_.size();
+    heap_.push_back(Item{key, index});
+    SiftUp(heap_.size() - 1);
+  }
+  /**
+   * @brief Change the key of a queued index.
+   */
+  inline void Update(int index, const KeyType &key) {
+    size_t pos = position_[index];
+    bool decrease = key < heap_[pos].key;
+    heap_[pos].key = key;
+    if (decrease) {
+      SiftUp(pos);
+    } else {
+      SiftDown(pos);
+    }
+  }
+  /**
+   * @brief Remove the index with the smallest key.
+   * @return The removed index
+   */
+  inline int Pop() {
+    int index = heap_.front().index;
+    Remove(index);
+    return index;
+  }
+  /**
+   * @brief Remove a queued index.
+   */
+  inline void Remove(int index) {
+    size_t pos = position_[index];
+    position_[index] = kNotQueued;
+    if (pos + 1 == heap_.size()) {
+      heap_.pop_back();
+      return;
+    }
+    heap_[pos] = heap_.back();
+    heap_.pop_back();
+    position_[heap_[pos].index] = pos;
+    if (pos > 0 && heap_[pos].key < heap_[(pos - 1) / kArity].key) {
+      SiftUp(pos);
+    } else {
+      SiftDown(pos);
+    }
+  }
+
+ private:
+  struct Item {
+    KeyType key;
+    int index;
+  };
+  static const int kArity = 4;
+  static const int kNotQueued = -1;
+
+  inline void SiftUp(size_t pos) {
+    Item item = heap_[pos];
+    while (pos > 0) {
+      size_t parent = (pos - 1) / kArity;
+      if (!(item.key < heap_[parent].key)) {
+        break;
+      }
+      heap_[pos] = heap_[parent];
+      position_[heap_[pos].index] = pos;
+      pos = parent;
+    }
+    heap_[pos] = item;
+    position_[item.index] = pos;
+  }
+  inline void SiftDown(size_t pos) {
+    Item item = heap_[pos];
+    const size_t size = heap_.size();
+    while (true) {
+      size_t first_child = pos * kArity + 1;
+      if (first_child >= size) {
+        break;
+      }
+      size_t last_child = std::min(first_child + kArity, size);
+      size_t min_child = first_child;
+      for (size_t child = first_child + 1; child < last_child; ++child) {
+        if (heap_[child].key < heap_[min_child].key) {
+          min_child = child;
+        }
+      }
+      if (!(heap_[min_child].key < item.key)) {
+        break;
+      }
+      heap_[pos] = heap_[min_child];
+      position_[heap_[pos].index] = pos;
+      pos = min_child;
+    }
+    heap_[pos] = item;
+    position_[item.index] = pos;
+  }
+
+  std::vector<Item> heap_;
+  //! Position of every index in heap_, kNotQueued if not queued
+  std::vector<int> position_;
+};
+
+template<typename KeyType> const int IndexedHeap<KeyType>::kArity;
+template<typename KeyType> const int IndexedHeap<KeyType>::kNotQueued;
+
+} //namespace roborts_global_planner
+
+#endif // ROBORTS_PLANNING_GLOBAL_PLANNER_SEARCH_ARENA_H
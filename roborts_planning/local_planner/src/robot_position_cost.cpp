@@ -72,6 +72,25 @@ double RobotPositionCost::FootprintCost (const Eigen::Vector2d& position, const
     return cost;
   }
 
+  // a footprint with a free bounding box costs nothing, the costmap pyramid tells without walking the outline
+  if (costmap_.HasMaxPyramid()) {
+    unsigned int min_x = cell_x, min_y = cell_y, max_x = cell_x, max_y = cell_y, vertex_x, vertex_y;
+    bool inside = true;
+    for (const auto &vertex : footprint) {
+      if (!costmap_.World2Map(vertex.coeffRef(0), vertex.coeffRef(1), vertex_x, vertex_y)) {
+        inside = false;
+        break;
+      }
+      min_x = std::min(min_x, vertex_x);
+      min_y = std::min(min_y, vertex_y);
+      max_x = std::max(max_x, vertex_x);
+      max_y = std::max(max_y, vertex_y);
+    }
+    if (inside && !costmap_.IsRegionCostAtLeast(min_x, min_y, max_x + 1, max_y + 1, 1)) {
+      return 0.0;
+    }
+  }
+
   unsigned int x0, x1, y0, y1;
   double line_cost = 0.0;
   double footprint_cost = 0.0;
@@ -124,8 +124,8 @@ class TebLocalPlanner : public LocalPlannerBase {
 
   //! Local planner frame(local planner will do optimal in this frame), different with global planner frame
   std::string global_frame_;
-  //! Local planner costmap 2d
-  roborts_costmap::Costmap2D *costmap_;
+  //! Local planner costmap 2d, the snapshot taken at the start of the current cycle
+  std::shared_ptr<const roborts_costmap::Costmap2D> costmap_;
   //! Robot footprint cost
   std::shared_ptr<roborts_local_planner::RobotPositionCost> robot_cost_;
   //! Optimal based algorithm ptr
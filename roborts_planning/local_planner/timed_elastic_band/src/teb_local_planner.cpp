@@ -77,6 +77,15 @@ roborts_common::ErrorInfo TebLocalPlanner::ComputeVelocityCommands(roborts_msgs:
     return algorithm_init_error;
   }
 
+  // work on the latest costmap snapshot for this cycle instead of the map being updated
+  costmap_ = local_cost_.lock()->GetCostMapSnapshot();
+  if (!costmap_) {
+    roborts_common::ErrorInfo costmap_error(roborts_common::LP_PLANNING_ERROR, "local costmap is not updated yet");
+    ROS_ERROR("%s", costmap_error.error_msg().c_str());
+    return costmap_error;
+  }
+  robot_cost_ = std::make_shared<roborts_local_planner::RobotPositionCost>(*costmap_);
+
   GetPlan(temp_plan_);
 
   cmd_vel.twist.linear.x = 0;
@@ -594,10 +603,6 @@ roborts_common::ErrorInfo TebLocalPlanner::Initialize (std::shared_ptr<roborts_c
 
     visual_ = visual;
 
-    costmap_ = local_cost_.lock()->GetLayeredCostmap()->GetCostMap();
-
-    robot_cost_ = std::make_shared<roborts_local_planner::RobotPositionCost>(*costmap_);
-
     obst_vector_.reserve(200);
     RobotFootprintModelPtr robot_model = GetRobotFootprintModel(param_config_);
     optimal_ = OptimalBasePtr(new TebOptimal(param_config_, &obst_vector_, robot_model, visual_, &via_points_));